@@ -0,0 +1,107 @@
+"""Reads the synthesis traces HomerProcessor writes, with HOMER_TRACE set or HomerProcessor::startTrace().
+
+The file is three little-endian uint32s, magic, version and record size, followed by espeak_TRACE_RECORDs
+as they are in memory (see speak_lib.h). Each note starts with a start record.
+
+    notes = load('homer.trace')
+    for note in notes:
+        plt.plot(note.frames['sample'] / note.samplerate, note.frames['pitch'] / 4096)
+"""
+
+import sys
+
+import numpy as np
+
+MAGIC = 0x52544d48  # "HMTR"
+VERSION = 1
+RECORD_SIZE = 104
+PEAKS = 9
+
+START = 1
+PHONEME = 2
+FRAME = 3
+
+_header = [('type', '<i4'), ('sample', '<i4'), ('phoneme', 'S8')]
+
+
+def _record(fields):
+    """A dtype for one type of record, laid over the whole record so any of them can be viewed as it."""
+    packed = np.dtype(_header + fields)
+    return np.dtype({'names': list(packed.names),
+                     'formats': [packed.fields[name][0] for name in packed.names],
+                     'offsets': [packed.fields[name][1] for name in packed.names],
+                     'itemsize': RECORD_SIZE})
+
+
+record_dtype = _record([])
+
+start_dtype = _record([('samplerate', '<i4'), ('engine', '<i4')])
+
+frame_dtype = _record([
+    ('pitch', '<i4'),  # Hz << 12
+    ('amplitude', '<i4'),
+    ('amplitude_fmt', '<i4'),
+    ('n_peaks', '<i4'),
+    ('freq', '<f4', PEAKS),  # Hz
+    ('height', '<f4', PEAKS),  # wavegen's peak height, or klatt's parallel amplitude
+])
+
+phoneme_dtype = _record([
+    ('code', '<i4'),
+    ('phoneme_type', '<i4'),
+    ('stresslevel', '<i4'),
+    ('length', '<i4'),
+    ('pitch1', '<i4'),
+    ('pitch2', '<i4'),
+    ('amp', '<i4'),
+    ('newword', '<i4'),
+    ('synthflags', '<i4'),
+    ('std_length', '<i4'),
+    ('sourceix', '<i4'),
+    ('phflags', '<u4'),
+])
+
+
+class Note:
+    """One note's records, split by type. Samples count from the start of the note at its samplerate."""
+
+    def __init__(self, records):
+        types = records.view(record_dtype)['type']
+        start = records[types == START].view(start_dtype)
+        # when tracing started part way through the note, it's taken to be at espeak's own rate
+        self.samplerate = int(start['samplerate'][0]) if len(start) else 22050
+        self.engine = int(start['engine'][0]) if len(start) else 0
+        self.phonemes = records[types == PHONEME].view(phoneme_dtype)
+        self.frames = records[types == FRAME].view(frame_dtype)
+
+
+def load_records(path):
+    """All the records in the file, as bytes to view as record_dtype or the dtype of their type."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    magic, version, record_size = np.frombuffer(data[:12], dtype='<u4')
+    if magic != MAGIC:
+        raise ValueError(f'{path} is not a Homer trace')
+    if version != VERSION or record_size != RECORD_SIZE:
+        raise ValueError(f'{path} is version {version} with {record_size} byte records, '
+                         f'this reads version {VERSION} with {RECORD_SIZE} byte records')
+    # a record cut short by the host going away is left off
+    count = (len(data) - 12) // RECORD_SIZE
+    return np.frombuffer(data, dtype=np.dtype((np.void, RECORD_SIZE)), count=count, offset=12)
+
+
+def load(path):
+    """The notes in the file, in the order they were played."""
+    records = load_records(path)
+    starts = np.flatnonzero(records.view(record_dtype)['type'] == START)
+    if len(starts) == 0 or starts[0] != 0:
+        starts = np.concatenate(([0], starts))
+    bounds = np.concatenate((starts, [len(records)]))
+    return [Note(records[a:b].copy()) for a, b in zip(bounds[:-1], bounds[1:]) if b > a]
+
+
+if __name__ == '__main__':
+    for i, note in enumerate(load(sys.argv[1] if len(sys.argv) > 1 else 'homer.trace')):
+        names = b' '.join(note.phonemes['phoneme']).decode('utf-8', 'replace')
+        seconds = note.frames['sample'][-1] / note.samplerate if len(note.frames) else 0
+        print(f'note {i}: engine {note.engine} at {note.samplerate}Hz, {len(note.frames)} frames over {seconds:.2f}s: {names}')
@@ -1,3 +1,11 @@
+#include "dsp/HomerProcessor.h"
+#include "dsp/Resampler.h"
+#include "state/EspeakDataPath.h"
+#include "espeak-ng/speak_lib.h"
+#include "espeak-ng/espeak_ng.h"
+#include <functional>
+#include <thread>
+
 TEST_CASE ("Boot performance")
 {
     BENCHMARK_ADVANCED ("Processor constructor")
@@ -30,3 +38,513 @@ TEST_CASE ("Boot performance")
         });
     };
 }
+
+TEST_CASE ("Resampler performance")
+{
+    constexpr int blockSize = 512;
+    std::vector<float> source (blockSize * 2, 0.5f);
+    std::vector<float> destination (blockSize);
+
+    for (auto outputRate : {44100.0, 48000.0, 96000.0}) {
+        for (auto mode : {Resampler::Mode::lofi, Resampler::Mode::polyphase}) {
+            Resampler r;
+            r.prepareToPlay (outputRate);
+            r.setInputSamplerate (22050);
+            r.setMode (mode);
+
+            auto name = juce::String (mode == Resampler::Mode::polyphase ? "polyphase" : "lofi")
+                + " 22050 -> " + juce::String (outputRate);
+            BENCHMARK (name.toStdString())
+            {
+                auto numSamplesNeeded = r.getNumSamplesNeeded (blockSize);
+                r.resampleIntoBuffer (destination.data(), blockSize, source.data(), numSamplesNeeded);
+                return destination[0];
+            };
+        }
+    }
+}
+
+TEST_CASE ("Direct host rate synthesis performance")
+{
+    constexpr int blockSize = 512;
+    constexpr int blocksPerNote = 200;
+
+    for (auto hostRate : {48000.0, 96000.0}) {
+        // 22000 is close enough to the default to say the same thing, but forces the resampler path
+        for (auto clockSpeed : {22050.0f, 22000.0f}) {
+            HomerState hs;
+            HomerProcessor hp (hs);
+            hs.setLyric (0, "She sells seashells by the seashore");
+            *hs.clockSpeed = clockSpeed;
+            hp.prepareToPlay (hostRate, blockSize);
+            juce::AudioBuffer<float> buffer (1, blockSize);
+
+            auto name = juce::String (clockSpeed == 22050.0f ? "direct " : "resampled ") + juce::String (hostRate);
+            BENCHMARK (name.toStdString())
+            {
+                for (int i = 0; i < blocksPerNote; ++i) {
+                    buffer.clear();
+                    hp.processBlock (buffer, 0, blockSize, i == 0);
+                }
+                return buffer.getSample (0, 0);
+            };
+            hp.releaseResources();
+        }
+    }
+}
+
+// a take that starts a note every 600ms, going round the lyric lines, with the bends swept every block
+static double renderAutomatedTake (PluginProcessor& plugin, double seconds, double sampleRate, int blockSize)
+{
+    auto& hs = plugin.homerState;
+    for (auto line = 0; line < HomerState::numLyricLines; ++line) {
+        hs.setLyric (line, "She sells seashells by the seashore, line " + juce::String (line + 1));
+    }
+    plugin.setNonRealtime (true);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    std::vector<juce::RangedAudioParameter*> automated { hs.pitchBend, hs.vibrato, hs.vibratoRate, hs.wavetableShape,
+        hs.detuneHarmonics, hs.consonantVowelBlend, hs.amountOfAliasing, hs.phonemeStickParam,
+        hs.formantFrequencyRescaler.end, hs.formantHeightRescaler.curve };
+    juce::AudioBuffer<float> buffer (2, blockSize);
+    juce::MidiBuffer midi;
+    auto numBlocks = static_cast<int> (seconds * sampleRate / blockSize);
+    auto blocksPerNote = static_cast<int> (0.6 * sampleRate / blockSize);
+    int noteNumber = 48;
+
+    auto start = juce::Time::getMillisecondCounterHiRes();
+    for (auto block = 0; block < numBlocks; ++block) {
+        auto t = block * blockSize / sampleRate;
+        for (size_t i = 0; i < automated.size(); ++i) {
+            automated[i]->setValueNotifyingHost (0.5f + 0.5f * std::sin (static_cast<float> (t * (0.3 + 0.2 * i))));
+        }
+        midi.clear();
+        if (block % blocksPerNote == 0) {
+            auto note = block / blocksPerNote;
+            *hs.lyricSelector = note % HomerState::numLyricLines + 1;
+            midi.addEvent (juce::MidiMessage::noteOff (1, noteNumber), 0);
+            noteNumber = 48 + (note * 7) % 24;
+            midi.addEvent (juce::MidiMessage::noteOn (1, noteNumber, 0.8f), blockSize / 2);
+        }
+        buffer.clear();
+        plugin.processBlock (buffer, midi);
+    }
+    auto elapsed = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+    plugin.releaseResources();
+    return numBlocks * blockSize / sampleRate / elapsed;
+}
+
+TEST_CASE ("Offline render real time factor")
+{
+    constexpr double takeSeconds = 180;
+
+    PluginProcessor plugin;
+    auto realTimeFactor = renderAutomatedTake (plugin, takeSeconds, 48000, 512);
+    WARN ("a 3 minute automated take bounces at " << realTimeFactor << "x real time");
+
+    // takes that don't share a plugin have nothing to wait on each other for, so bounce one per core
+    auto numTakes = juce::SystemStats::getNumCpus();
+    std::vector<std::unique_ptr<PluginProcessor>> plugins;
+    for (auto i = 0; i < numTakes; ++i) {
+        plugins.push_back (std::make_unique<PluginProcessor>());
+    }
+    std::vector<std::thread> threads;
+    auto start = juce::Time::getMillisecondCounterHiRes();
+    for (auto& p : plugins) {
+        threads.emplace_back ([&p] { renderAutomatedTake (*p, takeSeconds, 48000, 512); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+    WARN (numTakes << " takes at once bounce at " << numTakes * takeSeconds / seconds << "x real time in total");
+}
+
+TEST_CASE ("Stage timings")
+{
+    // where the time goes, offline through an automated take and live with every block resampled
+    PluginProcessor plugin;
+    renderAutomatedTake (plugin, 30, 48000, 512);
+    WARN ("a 30 second automated take offline, by stage:\n" << plugin.homerState.stageTimings.toString());
+
+    constexpr int blockSize = 512;
+    HomerState hs;
+    HomerProcessor hp (hs);
+    hs.setLyric (0, "She sells seashells by the seashore");
+    *hs.clockSpeed = 22000.0f;
+    hp.prepareToPlay (48000, blockSize);
+    juce::AudioBuffer<float> buffer (1, blockSize);
+    for (int note = 0; note < 20; ++note) {
+        for (int i = 0; i < 200; ++i) {
+            buffer.clear();
+            hp.processBlock (buffer, 0, blockSize, i == 0);
+        }
+    }
+    hp.releaseResources();
+    WARN ("20 notes live at 48000, by stage:\n" << hs.stageTimings.toString());
+}
+
+static int collectSamplesCallback (short* wav, int numSamples, espeak_EVENT* events)
+{
+    if (wav == nullptr) {
+        return 1;
+    }
+    auto samples = static_cast<std::vector<short>*> (events->user_data);
+    samples->insert (samples->end(), wav, wav + numSamples);
+    return 0;
+}
+
+TEST_CASE ("Klatt parallel resonator bank")
+{
+    const char* path = espeakDataPath;
+    const char text[] = "She sells seashells by the seashore.";
+
+    // nothing is listening on the plugin buffer, so the Klatt voice just writes into the synth callback
+    for (auto floatBank : {0, 1}) {
+        auto epContext = std::make_unique<EspeakProcessorContext>();
+        memset (epContext.get(), 0, sizeof (EspeakProcessorContext));
+        initEspeakContext (epContext.get());
+        espeak_Initialize (epContext.get(), AUDIO_OUTPUT_SYNCHRONOUS, 500, path, 0);
+        REQUIRE (espeak_SetVoiceByName (epContext.get(), "en-us+klatt") == EE_OK);
+        espeak_SetSynthCallback (epContext.get(), collectSamplesCallback);
+        epContext->kt_globals.float_parallel_bank = floatBank;
+
+        std::vector<short> samples;
+        BENCHMARK (floatBank ? "float parallel bank" : "double parallel resonators")
+        {
+            samples.clear();
+            espeak_Synth (epContext.get(), text, sizeof (text), 0, POS_CHARACTER, 0, espeakCHARS_AUTO, nullptr, &samples);
+            return samples.size();
+        };
+    }
+}
+
+TEST_CASE ("Breath resonators")
+{
+    const char* path = espeakDataPath;
+    const char text[] = "She sells seashells by the seashore.";
+
+    // Demonic is the stock variant with breath formants turned on
+    for (auto floatBank : {0, 1}) {
+        auto epContext = std::make_unique<EspeakProcessorContext>();
+        memset (epContext.get(), 0, sizeof (EspeakProcessorContext));
+        initEspeakContext (epContext.get());
+        espeak_Initialize (epContext.get(), AUDIO_OUTPUT_SYNCHRONOUS, 500, path, 0);
+        REQUIRE (espeak_SetVoiceByName (epContext.get(), "en-us+Demonic") == EE_OK);
+        espeak_SetSynthCallback (epContext.get(), collectSamplesCallback);
+        epContext->float_breath_bank = floatBank;
+
+        std::vector<short> samples;
+        BENCHMARK (floatBank ? "float breath bank" : "double breath resonators")
+        {
+            samples.clear();
+            espeak_Synth (epContext.get(), text, sizeof (text), 0, POS_CHARACTER, 0, espeakCHARS_AUTO, nullptr, &samples);
+            return samples.size();
+        };
+    }
+}
+
+TEST_CASE ("Synthesis engine real time factor")
+{
+    const char* path = espeakDataPath;
+    const char text[] = "She sells seashells by the seashore.";
+
+    // the same numbering as the HomerState engine choices map to
+    for (auto engine : {0, 1, 6}) {
+        auto epContext = std::make_unique<EspeakProcessorContext>();
+        memset (epContext.get(), 0, sizeof (EspeakProcessorContext));
+        initEspeakContext (epContext.get());
+        espeak_Initialize (epContext.get(), AUDIO_OUTPUT_SYNCHRONOUS, 500, path, 0);
+        REQUIRE (espeak_SetVoiceByName (epContext.get(), "en-us") == EE_OK);
+        REQUIRE (espeak_ng_SetSynthesisEngine (epContext.get(), engine) == ENS_OK);
+        espeak_SetSynthCallback (epContext.get(), collectSamplesCallback);
+
+        auto name = juce::String (engine == 0 ? "Wavegen" : engine == 6 ? "Wavegen_KlattSP" : "Wavegen_Klatt");
+        std::vector<short> samples;
+        BENCHMARK (name.toStdString())
+        {
+            samples.clear();
+            espeak_Synth (epContext.get(), text, sizeof (text), 0, POS_CHARACTER, 0, espeakCHARS_AUTO, nullptr, &samples);
+            return samples.size();
+        };
+
+        samples.clear();
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        espeak_Synth (epContext.get(), text, sizeof (text), 0, POS_CHARACTER, 0, espeakCHARS_AUTO, nullptr, &samples);
+        auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+        REQUIRE (!samples.empty());
+        WARN (name << " renders at " << (samples.size() / (double) HomerProcessor::espeakSampleRate) / seconds << "x real time");
+    }
+}
+
+TEST_CASE ("speechPlayer wave generators")
+{
+    const char* path = espeakDataPath;
+    const char text[] = "She sells seashells by the seashore.";
+
+    // the generator is picked when the speechPlayer handle is recreated, which happens on every KlattReset
+    for (auto fast : {0, 1}) {
+        auto epContext = std::make_unique<EspeakProcessorContext>();
+        memset (epContext.get(), 0, sizeof (EspeakProcessorContext));
+        initEspeakContext (epContext.get());
+        espeak_Initialize (epContext.get(), AUDIO_OUTPUT_SYNCHRONOUS, 500, path, 0);
+        REQUIRE (espeak_SetVoiceByName (epContext.get(), "en-us") == EE_OK);
+        REQUIRE (espeak_ng_SetSynthesisEngine (epContext.get(), 6) == ENS_OK);
+        espeak_SetSynthCallback (epContext.get(), collectSamplesCallback);
+        epContext->kt_globals.fast_speech_player = fast;
+
+        std::vector<short> samples;
+        BENCHMARK (fast ? "block speechPlayer generator" : "per sample speechPlayer generator")
+        {
+            samples.clear();
+            espeak_Synth (epContext.get(), text, sizeof (text), 0, POS_CHARACTER, 0, espeakCHARS_AUTO, nullptr, &samples);
+            return samples.size();
+        };
+    }
+}
+
+static int firstBufferCallback (short* wav, int numSamples, espeak_EVENT* events)
+{
+    // stop as soon as there is something to play
+    auto samples = static_cast<std::vector<short>*> (events->user_data);
+    if (wav != nullptr) {
+        samples->insert (samples->end(), wav, wav + numSamples);
+    }
+    return 1;
+}
+
+TEST_CASE ("Note start")
+{
+    const char* path = espeakDataPath;
+    const char text[] = "She sells seashells by the seashore.";
+
+    // a 10ms output buffer, so the time is mostly what comes before the first sample
+    auto epContext = std::make_unique<EspeakProcessorContext>();
+    memset (epContext.get(), 0, sizeof (EspeakProcessorContext));
+    initEspeakContext (epContext.get());
+    espeak_Initialize (epContext.get(), AUDIO_OUTPUT_SYNCHRONOUS, 10, path, 0);
+    REQUIRE (espeak_SetVoiceByName (epContext.get(), "en-us") == EE_OK);
+    espeak_SetSynthCallback (epContext.get(), firstBufferCallback);
+
+    espeak_ng_PHONEME_CACHE phonemes = nullptr;
+    espeak_ng_COMMAND_STREAM commands = nullptr;
+    REQUIRE (espeak_ng_TranslatePhonemeCache (epContext.get(), text, espeakCHARS_AUTO, &phonemes) == ENS_OK);
+    REQUIRE (espeak_ng_RecordCommandStream (epContext.get(), phonemes, &commands) == ENS_OK);
+
+    std::vector<short> samples;
+    BENCHMARK ("first buffer from text")
+    {
+        samples.clear();
+        espeak_Synth (epContext.get(), text, sizeof (text), 0, POS_CHARACTER, 0, espeakCHARS_AUTO, nullptr, &samples);
+        return samples.size();
+    };
+    BENCHMARK ("first buffer from a phoneme cache")
+    {
+        samples.clear();
+        espeak_ng_SynthesizePhonemeCache (epContext.get(), phonemes, &samples);
+        return samples.size();
+    };
+    BENCHMARK ("first buffer from a command stream")
+    {
+        samples.clear();
+        espeak_ng_SynthesizeCommandStream (epContext.get(), commands, &samples);
+        return samples.size();
+    };
+
+    espeak_ng_FreeCommandStream (commands);
+    espeak_ng_FreePhonemeCache (phonemes);
+    espeak_Terminate (epContext.get());
+}
+
+// the same lyric, seed and settings every run, so the numbers can be held up against another commit's
+static void setUpComparableState (HomerState& hs)
+{
+    hs.setLyric (0, "She sells seashells by the seashore");
+    hs.deterministic = true;
+    hs.sessionSeed = 1;
+    hs.phonemeCache.waitForTranslation (0, hs.phonemeCache.getVersion (0), 2000);
+}
+
+// a note from its start, in as many blocks as it takes to make seconds of audio
+static float renderNote (HomerProcessor& hp, juce::AudioBuffer<float>& buffer, double seconds, double sampleRate)
+{
+    auto blockSize = buffer.getNumSamples();
+    auto numBlocks = static_cast<int> (seconds * sampleRate) / blockSize;
+    for (int i = 0; i < numBlocks; ++i) {
+        buffer.clear();
+        hp.processBlock (buffer, 0, static_cast<unsigned int> (blockSize), i == 0);
+    }
+    return buffer.getSample (0, 0);
+}
+
+TEST_CASE ("Wavegen pitch")
+{
+    const char* path = espeakDataPath;
+    const char text[] = "She sells seashells by the seashore.";
+
+    // wavegen makes each period's harmonics up to the top formant, so low notes have the most to add up
+    for (auto [name, f0] : { std::pair { "low", 55 }, std::pair { "mid", 220 }, std::pair { "high", 880 } }) {
+        auto epContext = std::make_unique<EspeakProcessorContext>();
+        memset (epContext.get(), 0, sizeof (EspeakProcessorContext));
+        initEspeakContext (epContext.get());
+        espeak_Initialize (epContext.get(), AUDIO_OUTPUT_SYNCHRONOUS, 500, path, 0);
+        REQUIRE (espeak_SetVoiceByName (epContext.get(), "en-us") == EE_OK);
+        REQUIRE (espeak_ng_SetConstF0 (epContext.get(), f0) == ENS_OK);
+        espeak_SetSynthCallback (epContext.get(), collectSamplesCallback);
+
+        std::vector<short> samples;
+        auto synthesize = [&] {
+            samples.clear();
+            espeak_ng_SetRandSeed (epContext.get(), 1);
+            espeak_Synth (epContext.get(), text, sizeof (text), 0, POS_CHARACTER, 0, espeakCHARS_AUTO, nullptr, &samples);
+            return samples.size();
+        };
+        BENCHMARK (("Wavegen at " + juce::String (f0) + " Hz").toStdString())
+        {
+            return synthesize();
+        };
+
+        auto start = juce::Time::getMillisecondCounterHiRes();
+        synthesize();
+        auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+        REQUIRE (!samples.empty());
+        WARN ("Wavegen at " << name << " pitch (" << f0 << " Hz) makes " << juce::roundToInt (samples.size() / seconds) << " samples a second");
+    }
+}
+
+TEST_CASE ("Bends at their extremes")
+{
+    constexpr double sampleRate = 48000;
+    constexpr int blockSize = 512;
+
+    // offline, so the numbers are the synthesis and not the handoff between threads
+    struct Bend
+    {
+        const char* name;
+        std::function<void (HomerState&)> set;
+    };
+    const std::vector<Bend> bends {
+        { "no bends", [] (HomerState&) {} },
+        { "detune -1", [] (HomerState& hs) { *hs.detuneHarmonics = -1.0f; } },
+        { "detune 1", [] (HomerState& hs) { *hs.detuneHarmonics = 1.0f; } },
+        { "wavetable shape 1", [] (HomerState& hs) { *hs.wavetableShape = 1.0f; } },
+        { "freeze", [] (HomerState& hs) { *hs.freezeParam = true; } },
+        { "detune, wavetable shape and freeze", [] (HomerState& hs) {
+             *hs.detuneHarmonics = 1.0f;
+             *hs.wavetableShape = 1.0f;
+             *hs.freezeParam = true;
+         } },
+    };
+    for (auto& bend : bends) {
+        HomerState hs;
+        setUpComparableState (hs);
+        bend.set (hs);
+        HomerProcessor hp (hs);
+        hp.setOffline (true);
+        hp.prepareToPlay (sampleRate, blockSize);
+        juce::AudioBuffer<float> buffer (1, blockSize);
+
+        BENCHMARK (("2 seconds with " + juce::String (bend.name)).toStdString())
+        {
+            return renderNote (hp, buffer, 2.0, sampleRate);
+        };
+        hp.releaseResources();
+    }
+}
+
+TEST_CASE ("Resampler ratios and aliasing")
+{
+    constexpr double outputRate = 48000;
+    constexpr int blockSize = 512;
+
+    // noise, so nothing about the input makes the interpolation cheaper than it would be for a voice
+    juce::Random random (1);
+    std::vector<float> source (blockSize * 4);
+    for (auto& sample : source) {
+        sample = random.nextFloat() * 2 - 1;
+    }
+    std::vector<float> destination (blockSize);
+
+    // the clock speed takes the input down from 22050, synthesizing at the host rate takes it up
+    for (auto inputRate : { 5512.5f, 11025.0f, 22050.0f, 44100.0f }) {
+        for (auto aliasing : { 0.0f, 0.5f, 1.0f }) {
+            Resampler r;
+            r.prepareToPlay (outputRate);
+            r.setInputSamplerate (inputRate);
+            r.setAliasingAmount (aliasing);
+            r.setMode (Resampler::Mode::lofi);
+
+            auto name = "lofi " + juce::String (inputRate) + " -> " + juce::String (outputRate) + ", aliasing " + juce::String (aliasing);
+            BENCHMARK (name.toStdString())
+            {
+                auto numSamplesNeeded = r.getNumSamplesNeeded (blockSize);
+                r.resampleIntoBuffer (destination.data(), blockSize, source.data(), numSamplesNeeded);
+                return destination[0];
+            };
+        }
+    }
+}
+
+TEST_CASE ("Processor block sizes")
+{
+    constexpr double sampleRate = 48000;
+
+    // the same two seconds of one note each time, so only the block size changes
+    for (auto offline : { false, true }) {
+        for (auto blockSize : { 32, 128, 1024 }) {
+            HomerState hs;
+            setUpComparableState (hs);
+            HomerProcessor hp (hs);
+            hp.setOffline (offline);
+            hp.prepareToPlay (sampleRate, blockSize);
+            juce::AudioBuffer<float> buffer (1, blockSize);
+            while (!hp.isReadyForNote()) {
+                juce::Thread::sleep (1);
+            }
+
+            auto name = juce::String (offline ? "offline" : "live") + ", 2 seconds in blocks of " + juce::String (blockSize);
+            BENCHMARK (name.toStdString())
+            {
+                return renderNote (hp, buffer, 2.0, sampleRate);
+            };
+            hp.releaseResources();
+        }
+    }
+}
+
+TEST_CASE ("First sound after note on")
+{
+    constexpr double sampleRate = 48000;
+    constexpr int blockSize = 128;
+
+    for (auto offline : { false, true }) {
+        HomerState hs;
+        setUpComparableState (hs);
+        HomerProcessor hp (hs);
+        hp.setOffline (offline);
+        hp.prepareToPlay (sampleRate, blockSize);
+        juce::AudioBuffer<float> buffer (1, blockSize);
+
+        // blocks until one has something in it, which is the time a player waits after pressing the key
+        int samplesToFirstSound = 0;
+        auto renderToFirstSound = [&] {
+            for (int i = 0; i < static_cast<int> (sampleRate) / blockSize; ++i) {
+                buffer.clear();
+                hp.processBlock (buffer, 0, blockSize, i == 0);
+                for (int sample = 0; sample < blockSize; ++sample) {
+                    if (buffer.getSample (0, sample) != 0) {
+                        samplesToFirstSound = i * blockSize + sample;
+                        return samplesToFirstSound;
+                    }
+                }
+            }
+            return -1;
+        };
+        BENCHMARK (offline ? "offline note on to first sound" : "live note on to first sound")
+        {
+            return renderToFirstSound();
+        };
+        hp.releaseResources();
+        WARN ((offline ? "offline" : "live") << ", the first sound is " << samplesToFirstSound << " samples after the note on");
+    }
+}
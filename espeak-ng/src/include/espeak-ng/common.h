@@ -286,6 +286,17 @@ typedef struct {
     double x2;
 } RESONATOR;
 
+#define N_BREATH_LANES 8 // breath formants 1 to 8
+
+typedef struct {
+    float a[N_BREATH_LANES];
+    float b[N_BREATH_LANES];
+    float c[N_BREATH_LANES];
+    float x1[N_BREATH_LANES];
+    float x2[N_BREATH_LANES];
+    float amp[N_BREATH_LANES];
+} breath_bank_t;
+
 
 typedef struct {
     char name[N_PHONEME_TAB_NAME];
@@ -331,6 +342,16 @@ typedef struct {
     double c_inc;
 } resonator_t, *resonator_ptr;
 
+#define N_PARALLEL_LANES 8 // Rnpp, R1p, R2p to R6p, and a silent lane to make up a whole number of vectors
+
+typedef struct {
+    float a[N_PARALLEL_LANES];
+    float b[N_PARALLEL_LANES];
+    float c[N_PARALLEL_LANES];
+    float p1[N_PARALLEL_LANES];
+    float p2[N_PARALLEL_LANES];
+} parallel_bank_t;
+
 /* typedef's that need to be exported */
 
 typedef long flag; // TODO: just for klatt i think, does this break anything?
@@ -369,6 +390,18 @@ typedef struct {
 	const short *natural_samples; /* pointer to an array of glottal samples */
 	long original_f0; /* original value of f0 not modified by flutter */
 
+	// state that carries from one sample or frame to the next, per context so voices don't share it
+	int flutter_time_count;
+	double noise;
+	double voice;
+	double vlast;
+	double glotlast;
+	double sourc;
+	double natural_vwave;
+	long skew;
+	double nlast;
+	long resume_ns; // where parwave() carries on after it stopped for a full buffer, 0 at the start of a frame
+
 	int fadein;
 	int fadeout;       // set to 64 to cause fadeout over 64 samples
 	int scale_wav;     // depends on the voicing source
@@ -398,6 +431,12 @@ typedef struct {
 	resonator_t rsn[N_RSN];  // internal storage for resonators
 	resonator_t rsn_next[N_RSN];
 
+	int float_parallel_bank; // run the parallel resonators as one single precision bank
+	parallel_bank_t parallel_bank;
+
+	void *speech_player; // speechPlayer_handle_t, for klatt voice 6
+	int fast_speech_player; // create it with the block based single precision generator
+
 } klatt_global_t, *klatt_global_ptr;
 
 typedef struct {
@@ -423,6 +462,10 @@ typedef struct {
     int sound_param;
 } PHONEME_LIST;
 
+typedef struct {
+    PHONEME_LIST prev_vowel;
+} WORD_PH_DATA;
+
 typedef struct { // 64 bytes
     short frflags;
     short ffreq[7];
@@ -439,6 +482,14 @@ typedef struct { // 64 bytes
     unsigned char spare;       // pad to multiple of 4 bytes
 } frame_t; // with extra Klatt parameters for parallel resonators
 
+#define N_SEQ_FRAMES  25 // max frames in a spectrum sequence (real max is ablut 8)
+
+typedef struct {
+    short length;
+    short frflags;
+    frame_t *frame;
+} frameref_t;
+
 typedef struct {
     const unsigned char *pitch_env;
     int pitch;      // pitch Hz*256
@@ -42,6 +42,10 @@ typedef enum {
 
 typedef struct espeak_ng_ERROR_CONTEXT_ *espeak_ng_ERROR_CONTEXT;
 
+typedef struct espeak_ng_PHONEME_CACHE_ *espeak_ng_PHONEME_CACHE;
+
+typedef struct espeak_ng_COMMAND_STREAM_ *espeak_ng_COMMAND_STREAM;
+
 ESPEAK_NG_API void
 espeak_ng_ClearErrorContext(espeak_ng_ERROR_CONTEXT *context);
 
@@ -89,6 +93,9 @@ espeak_ng_SetVoiceByFile(EspeakProcessorContext* epContext, const char *filename
 ESPEAK_NG_API espeak_ng_STATUS
 espeak_ng_SetVoiceByProperties(EspeakProcessorContext* epContext, espeak_VOICE *voice_selector);
 
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SetSynthesisEngine(EspeakProcessorContext* epContext, int engine);
+
 ESPEAK_NG_API espeak_ng_STATUS
 espeak_ng_Synthesize(EspeakProcessorContext* epContext, const void *text,
                      size_t size,
@@ -165,9 +172,117 @@ espeak_ng_SetOutputHooks(EspeakProcessorContext* epContext, espeak_ng_OUTPUT_HOO
 ESPEAK_NG_API espeak_ng_STATUS
 espeak_ng_SetConstF0(EspeakProcessorContext* epContext, int f0);
 
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SetSampleRate(EspeakProcessorContext* epContext, int rate);
+
+/* Seeds the context's random numbers: klatt's noise and the bends' random choices, like
+   the phoneme stick. espeak_Initialize seeds them from the time; the same seed after it
+   makes the same choices for the same text and bends. */
 ESPEAK_NG_API espeak_ng_STATUS
 espeak_ng_SetRandSeed(EspeakProcessorContext* epContext, long seed);
 
+/* Passes each event to callback as wavegen reaches it, on the synthesizing thread, with
+   its sample counted from the start of the synthesis. The synth callback only gets the
+   events when the output buffer is handed over, which with a plugin buffer may not be
+   until the end. The event is only valid during the call, and callback mustn't block. */
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SetEventCallback(EspeakProcessorContext* epContext, t_espeak_event_callback *callback);
+
+/* Records a trace of the synthesis into the context's ring: an espeakTRACE_START when it
+   starts, an espeakTRACE_PHONEME for each phoneme generated and an espeakTRACE_FRAME each
+   time wavegen or klatt moves on to new parameters. Recording only fills in a record, with
+   nothing allocated or printed, so it can be left on; when the ring is full, new records
+   are dropped and counted rather than waited for. A recorded command stream has no
+   phonemes to generate, so only its frames are traced. */
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SetTrace(EspeakProcessorContext* epContext, int enable);
+
+/* Copies up to max_records of the oldest records that haven't been read yet into records,
+   and returns how many. It can be called from a different thread to the one synthesizing,
+   as long as it's only ever one thread at a time. */
+ESPEAK_NG_API int
+espeak_ng_ReadTrace(EspeakProcessorContext* epContext, espeak_TRACE_RECORD *records, int max_records);
+
+/* The records dropped because the ring was full, since the context was initialized. */
+ESPEAK_NG_API unsigned int
+espeak_ng_GetTraceDropped(EspeakProcessorContext* epContext);
+
+/* A cheap, steadily increasing count: the time stamp counter on x86, the virtual counter on
+   ARM64 and nanoseconds elsewhere. Its rate isn't known here, so callers measure it against
+   a clock of their own. */
+ESPEAK_NG_API uint64_t
+espeak_ng_ReadCycleCounter(void);
+
+/* Copies the espeakSTAGE_COUNT totals of espeak_ng_ReadCycleCounter() counts the context
+   has spent in each espeak_STAGE since it was initialized into cycles. A stage's time is
+   added when the synthesis leaves it, so it can be called from any thread while the
+   synthesis is running. espeakSTAGE_NONE is never counted. */
+ESPEAK_NG_API void
+espeak_ng_GetStageCycles(EspeakProcessorContext* epContext, uint64_t *cycles);
+
+/* Translates text to phonemes with the current voice, the way espeak_ng_Synthesize
+   would, and keeps the result for espeak_ng_SynthesizePhonemeCache. The cache does
+   not refer to epContext afterwards, so it can be made on one context and replayed on
+   any other context loaded from the same espeak-ng-data with the same voice.
+*/
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_TranslatePhonemeCache(EspeakProcessorContext* epContext, const void *text,
+                                unsigned int flags,
+                                espeak_ng_PHONEME_CACHE *cache);
+
+/* Synthesizes a phoneme cache, starting straight at the wavegen commands with no
+   text translation. Synchronous mode only.
+*/
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SynthesizePhonemeCache(EspeakProcessorContext* epContext,
+                                 espeak_ng_PHONEME_CACHE cache,
+                                 void *user_data);
+
+ESPEAK_NG_API void
+espeak_ng_FreePhonemeCache(espeak_ng_PHONEME_CACHE cache);
+
+/* Generates the wavegen commands for a phoneme cache without synthesizing them, and
+   keeps them, with their frames copied, for espeak_ng_SynthesizeCommandStream. The
+   phoneme rotation and stick bends are left out, stick is applied again at replay.
+   Like the cache, the stream can be replayed on any context loaded from the same
+   espeak-ng-data with the same voice. Synchronous mode only.
+*/
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_RecordCommandStream(EspeakProcessorContext* epContext,
+                              espeak_ng_PHONEME_CACHE cache,
+                              espeak_ng_COMMAND_STREAM *stream);
+
+/* Synthesizes a recorded command stream, feeding it straight to wavegen. The bends
+   that act in wavegen apply as usual, and stick repeats whole recorded phonemes.
+   Returns ENS_NOT_SUPPORTED while phonemes are rotated, since the rotated phonemes'
+   frames are not in the recording, or if the sample rate or the choice between
+   wavegen and klatt has changed since recording. Synthesize the phoneme cache instead.
+*/
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SynthesizeCommandStream(EspeakProcessorContext* epContext,
+                                  espeak_ng_COMMAND_STREAM stream,
+                                  void *user_data);
+
+ESPEAK_NG_API void
+espeak_ng_FreeCommandStream(espeak_ng_COMMAND_STREAM stream);
+
+/* In pull mode espeak_ng_Synthesize, espeak_ng_SynthesizePhonemeCache and
+   espeak_ng_SynthesizeCommandStream return once the first clause is translated, and
+   the sound is then fetched on the calling thread with espeak_ng_PullSamples, with no
+   synth callback or waiting for the plugin buffer. The text, cache or stream must stay
+   valid until it has been pulled to the end. Turning pull mode off, or on again,
+   abandons anything not pulled yet. Synchronous mode only.
+*/
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SetPullMode(EspeakProcessorContext* epContext, int enable);
+
+/* Synthesizes up to n_samples into buffer, with the consonant and vowel levels
+   applied as for the plugin buffer, and returns how many were written. Fewer than
+   n_samples means the end has been reached.
+*/
+ESPEAK_NG_API int
+espeak_ng_PullSamples(EspeakProcessorContext* epContext, float *buffer, int n_samples);
+
 
 #ifdef __cplusplus
 }
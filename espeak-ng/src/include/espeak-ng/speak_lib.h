@@ -154,7 +154,7 @@ typedef struct {
 	espeak_EVENT_TYPE type;
 	unsigned int unique_identifier; // message identifier (or 0 for key or character)
 	int text_position;    // the number of characters from the start of the text
-	int length;           // word length, in characters (for espeakEVENT_WORD)
+	int length;           // word length, in characters (for espeakEVENT_WORD), or the espeak_PHONEME_CLASS (for espeakEVENT_PHONEME)
 	int audio_position;   // the time in mS within the generated speech output data
 	int sample;           // sample id (internal use)
 	void* user_data;      // pointer supplied by the calling program
@@ -164,6 +164,78 @@ typedef struct {
 		char string[8];    // used for phoneme names (UTF8). Terminated by a zero byte unless the name needs the full 8 bytes.
 	} id;
 } espeak_EVENT;
+
+// the kinds of sound a phoneme makes, in the length of its espeakEVENT_PHONEME
+typedef enum {
+	espeakPHONEME_SILENT = 0, // pauses, stresses and the like
+	espeakPHONEME_VOWEL = 1,
+	espeakPHONEME_LIQUID = 2,
+	espeakPHONEME_STOP = 3,
+	espeakPHONEME_FRICATIVE = 4,
+	espeakPHONEME_NASAL = 5
+} espeak_PHONEME_CLASS;
+
+#define espeakTRACE_RECORDS 512 // records the trace holds before it drops new ones
+#define espeakTRACE_PEAKS 9
+
+typedef enum {
+	espeakTRACE_START = 1,   // the synthesis started
+	espeakTRACE_PHONEME = 2, // a phoneme was generated, which is ahead of when it's heard
+	espeakTRACE_FRAME = 3    // wavegen or klatt moved on to the next frame's parameters
+} espeak_TRACE_TYPE;
+
+// one record of the synthesis trace. They're all the same size, with fixed-width fields and nothing
+// pointing anywhere, so a dump of them can be read back as is
+typedef struct {
+	int32_t type;          // espeak_TRACE_TYPE
+	int32_t sample;        // counted from the start of the synthesis, like espeak_EVENT's
+	char phoneme[8];       // the phoneme's mnemonic, or for frames the last espeakEVENT_PHONEME's name when phoneme events are on
+	union {
+		struct {
+			int32_t samplerate;
+			int32_t engine; // as for espeak_ng_SetSynthesisEngine
+		} start;
+		struct {
+			int32_t pitch; // Hz << 12
+			int32_t amplitude;
+			int32_t amplitude_fmt;
+			int32_t n_peaks;
+			float freq[espeakTRACE_PEAKS];   // Hz
+			float height[espeakTRACE_PEAKS]; // wavegen's peak height, or klatt's parallel amplitude
+		} frame;
+		struct {
+			int32_t code;
+			int32_t type;
+			int32_t stresslevel;
+			int32_t length;
+			int32_t pitch1;
+			int32_t pitch2;
+			int32_t amp;
+			int32_t newword;
+			int32_t synthflags;
+			int32_t std_length;
+			int32_t sourceix;
+			uint32_t phflags;
+		} phoneme;
+	} u;
+} espeak_TRACE_RECORD;
+
+// a ring the synthesizing thread writes and one other thread reads, through espeak_ng_ReadTrace
+typedef struct {
+	espeak_TRACE_RECORD records[espeakTRACE_RECORDS];
+	uint32_t written;  // only moved on by the writer
+	uint32_t read;     // only moved on by the reader
+	uint32_t dropped;  // records the ring was too full for
+} espeak_TRACE;
+
+// where the synthesizing thread's time goes, as read by espeak_ng_GetStageCycles
+typedef enum {
+	espeakSTAGE_NONE = 0,      // anything else, including waiting for the plugin to want samples
+	espeakSTAGE_TRANSLATE = 1, // translating a clause of text into phonemes, with its pitches and lengths
+	espeakSTAGE_GENERATE = 2,  // Generate(), or replaying a recorded command stream, queueing wavegen commands
+	espeakSTAGE_WAVEGEN = 3    // wavegen, klatt or speechPlayer making samples from the queue
+} espeak_STAGE;
+#define espeakSTAGE_COUNT 4
 /*
    When a message is supplied to espeak_synth, the request is buffered and espeak_synth returns. When the message is really processed, the callback function will be repetedly called.
 
@@ -264,6 +336,7 @@ ESPEAK_API int espeak_Initialize(EspeakProcessorContext* epContext, espeak_AUDIO
 */
 
 typedef int (t_espeak_callback)(short*, int, espeak_EVENT*);
+typedef void (t_espeak_event_callback)(const espeak_EVENT*);
 
 #ifdef __cplusplus
 extern "C"
@@ -731,16 +804,49 @@ ESPEAK_API const char *espeak_Info(EspeakProcessorContext* epContext, const char
    path_data  returns the path to espeak_data
 */
 
+#define BEND_RESCALER_TABLE_SIZE 1024
+
 typedef struct BendRescaler
 {
     float start;
     float end;
     float curve;
+
+    // x^(5^-curve) sampled over [0, 1], rebuilt whenever curve moves
+    int tableBuilt;
+    float tableCurve;
+    float exponent;
+    float table[BEND_RESCALER_TABLE_SIZE + 1];
 } BendRescaler;
 
+static inline void updateBendRescalerTable(BendRescaler* rescaler)
+{
+    int i;
+    if (rescaler->tableBuilt && rescaler->tableCurve == rescaler->curve)
+        return;
+    rescaler->exponent = powf(5.f, -rescaler->curve);
+    for (i = 0; i <= BEND_RESCALER_TABLE_SIZE; i++)
+        rescaler->table[i] = powf((float)i / BEND_RESCALER_TABLE_SIZE, rescaler->exponent);
+    rescaler->tableCurve = rescaler->curve;
+    rescaler->tableBuilt = 1;
+}
+
 static inline float applyBendRescaler(BendRescaler* rescaler, float x, float newMin, float newMax)
 {
-    float sloped = powf (x, powf(5.f, -rescaler->curve));
+    float sloped;
+    updateBendRescalerTable(rescaler);
+    if (rescaler->exponent == 1.f) {
+        sloped = x;
+    } else if (x >= 1.f / BEND_RESCALER_TABLE_SIZE && x < 1.f) {
+        // the curve is smooth away from 0, so interpolating the table stays within a fraction of a percent
+        float position = x * BEND_RESCALER_TABLE_SIZE;
+        int index = (int)position;
+        float fraction = position - index;
+        sloped = rescaler->table[index] + (rescaler->table[index + 1] - rescaler->table[index]) * fraction;
+    } else {
+        // the first segment is too steep to interpolate when the curve is bent towards 0
+        sloped = powf (x, rescaler->exponent);
+    }
     float rescaled = (rescaler->end - rescaler->start) * sloped + rescaler->start;
     rescaled = rescaled < 0 ? 0 : rescaled;
     rescaled = rescaled > newMax ? newMax : rescaled;
@@ -750,8 +856,8 @@ static inline float applyBendRescaler(BendRescaler* rescaler, float x, float new
 typedef struct esb
 {
     int rotatePhonemes;
+    bool rotateAcrossClasses; // rotate through all the sounding phonemes, rather than vowels to vowels and so on
     float stickChance;
-    bool debugPrintEverything;
     float fundamentalFreq;
     bool freeze;
     float wavetableShape;
@@ -762,12 +868,51 @@ typedef struct esb
 
     unsigned short vibratoWavePosition;
     float vibratoAmount;
+    float vibratoRate; // Hz, 0 for the original rate of about 10Hz
     float pitchbendMultiplier;
 
     float consonantLevel;
     float vowelLevel;
 } EspeakBends;
 
+#define REPLAY_ALL    0
+#define REPLAY_EVENTS 1 // everything but the sound, for a stuck phoneme
+#define REPLAY_SOUND  2 // only the sound, from the phoneme it stuck to
+
+// where ReplayCommandStream() is up to in a recorded command stream
+typedef struct {
+    int segment;       // next segment to start
+    int ix;            // next command to queue
+    int end;
+    int filter;
+    int sound_start;   // the commands last used for a phoneme's sound
+    int sound_end;
+    bool stuck;        // the sound of a stuck phoneme is still to queue
+    bool new_clause;   // may go on into the next clause
+} CommandStreamReplay;
+
+// where Generate() is up to in the phoneme list, kept for when it stops to wait for wavegen and resumes.
+// these were static, so contexts generating at the same time on different threads corrupted each other's
+typedef struct {
+    int ix;
+    int embedded_ix;
+    int word_count;
+    int sourceix;
+    WORD_PH_DATA worddata;
+} GenerateState;
+
+// what phonemes rotate into, built by SelectPhonemeTable() so Generate() only has to index it.
+// Class 0 is every phoneme that makes a sound, the others are the espeak_PHONEME_CLASS they're in.
+// index[] is where a phoneme code is in its class, or ROTATION_NONE for a pause, a stress or
+// anything else that shouldn't rotate or be rotated into
+#define N_ROTATION_CLASSES 6
+#define ROTATION_NONE      0xff
+typedef struct {
+    int n_codes[N_ROTATION_CLASSES];
+    unsigned char codes[N_ROTATION_CLASSES][N_PHONEME_TAB];
+    unsigned char index[N_ROTATION_CLASSES][N_PHONEME_TAB];
+} PhonemeRotation;
+
 typedef struct {
     int name; // used for detecting punctuation
     int length;
@@ -790,10 +935,17 @@ struct epc
     int pluginBufferSize;
     float* pluginBuffer;
     int pluginBufferPosition;
+    // samples written to a plugin buffer since the synthesis started, where its events are
+    long pluginSamplesWritten;
     bool readyToProcess;
     bool doneProcessing;
     bool allDone;
     bool noteEndingEarly;
+    // set by espeak_ng_SetPullMode(): the synthesis functions return after the first clause and
+    // espeak_ng_PullSamples() fills pluginBuffer on the calling thread instead of blocking in wavegen
+    bool pullMode;
+    // a pull mode synthesis has been started and not pulled to the end yet
+    bool pulling;
 
     #if defined(_WIN32) || defined(_WIN64)
     // no mutexes needed
@@ -827,6 +979,8 @@ struct epc
 
     int wave_n_samples;
     int wave_ix;// = 0;
+    int wave_frac; // fractional position in the wave data, 16.16
+    int mix_wave_frac;
     voice_t v2;
 
     bool resume;// = false;
@@ -836,6 +990,7 @@ struct epc
 
     // common.c
     uint32_t espeak_rand_state; // = 0;
+    uint32_t bend_rand_state;   // xorshift state for the bends' random choices, see espeak_bend_rand()
 
 
     // dictionary.c
@@ -877,6 +1032,7 @@ struct epc
 
     klatt_frame_t kt_frame;
     klatt_global_t kt_globals;
+    frame_t klatt_prev_fr; // SetSynth_Klatt() resets the resonators when the formants jump from this one
 
     // mbrola.h
     int mbrola_delay;
@@ -954,6 +1110,17 @@ struct epc
     espeak_ng_STATUS err; // = ENS_OK;
 
      t_espeak_callback *synth_callback; // = NULL;
+     t_espeak_event_callback *event_callback;
+
+    // espeak_ng_SetTrace
+    bool tracing;
+    char trace_phoneme[8];
+    espeak_TRACE trace;
+
+    // espeak_ng_GetStageCycles. Only stage_cycles is read by other threads
+    int stage;
+    uint64_t stage_start;
+    uint64_t stage_cycles[espeakSTAGE_COUNT];
 
     char path_home[N_PATH_HOME]; // this is the espeak-ng-data directory
 
@@ -965,9 +1132,11 @@ struct epc
     int n_phoneme_tab;
     int current_phoneme_table;
     PHONEME_TAB *phoneme_tab[N_PHONEME_TAB];
+    PhonemeRotation phoneme_rotation;
 
     unsigned short *phoneme_index;// = NULL;
     char *phondata_ptr;// = NULL;
+    int phondata_size;
     unsigned char *wavefile_data;// = NULL;
     unsigned char *phoneme_tab_data;// = NULL;
 
@@ -982,11 +1151,28 @@ struct epc
     int n_phoneme_list;// = 0;
     PHONEME_LIST phoneme_list[N_PHONEME_LIST+1];
 
+    // set while espeak_ng_SynthesizePhonemeCache() replays pre-translated clauses instead of reading text
+    const struct espeak_ng_PHONEME_CACHE_ *phoneme_cache;
+    int phoneme_cache_ix;
+
+    // set while espeak_ng_RecordCommandStream() keeps what Generate() queues
+    struct espeak_ng_COMMAND_STREAM_ *recording_stream;
+    // set while espeak_ng_SynthesizeCommandStream() queues a recording instead of calling Generate()
+    const struct espeak_ng_COMMAND_STREAM_ *command_stream;
+    CommandStreamReplay replay;
+    GenerateState generate;
+
     SPEED_FACTORS speed;
 
     int last_pitch_cmd;
     int last_amp_cmd;
     frame_t  *last_frame;
+    // temporary frames for blending to consonants, used round-robin. The queue points into
+    // them, so there's one for each entry in it
+    frame_t frame_pool[N_WCMDQ];
+    int frame_pool_ix;
+    frameref_t frames_buf[N_SEQ_FRAMES]; // the sequence LookupSpect() returns
+    int spect_wave_flag;
     int last_wcmdq;
     int pitch_length;
     int amp_length;
@@ -1063,6 +1249,8 @@ struct epc
     int formant_rate[9]; // values adjusted for actual sample rate
     int n_voices_list;// = 0;
     espeak_VOICE *voices_list[N_VOICES_LIST];
+    // what espeak_ListVoices() returns, pointing into voices_list
+    espeak_VOICE *voices_listed[N_VOICES_LIST];
 
     espeak_VOICE current_voice_selected;
 
@@ -1084,6 +1272,14 @@ struct epc
 
     int PHASE_INC_FACTOR;
     int samplerate;// = 0; // this is set by Wavegeninit()
+    int wavefile_samplerate; // rate the recorded consonants in phondata were made at
+    int wave_step; // wavefile_samplerate / samplerate, 16.16 fixed point
+
+    // Wavegen() ramps the bent phase increment across each control frame, see StartPitchRamp()
+    int pitch_ramp_inc;
+    int pitch_ramp_step;
+    int pitch_ramp_remaining;
+    int pitch_ramp_base; // the phaseinc the ramp was worked out from
 
     wavegen_peaks_t peaks[N_PEAKS];
     int peak_harmonic[N_PEAKS];
@@ -1097,8 +1293,17 @@ struct epc
 
     int voicing;
     RESONATOR rbreath[N_PEAKS];
+    int float_breath_bank; // run the breath resonators as one single precision bank
+    breath_bank_t breath_bank;
+    uint32_t breath_noise; // xorshift state for the breath bank's noise source
 
     int harm_inc[N_LOWHARM]; // only for these harmonics do we interpolate amplitude between steps
+
+    // PeaksToHarmspect() skips the work when none of its inputs have changed, pitch included
+    int ptoh_valid;
+    int ptoh_pitch;
+    int ptoh_peaks[N_PEAKS][4];
+    int ptoh_htab[MAX_HARMONIC];
     int *harmspect;
     int hswitch;// = 0;
     int hspect[2][MAX_HARMONIC]; // 2 copies, we interpolate between then
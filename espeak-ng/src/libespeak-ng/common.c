@@ -335,9 +335,27 @@ long espeak_rand(EspeakProcessorContext* epContext, long min, long max) {
 	return (res % (max-min+1))-min;
 }
 
+float espeak_bend_rand(EspeakProcessorContext* epContext) {
+	// xorshift32, uniform in [0, 1). Its own stream, so the bends' choices don't depend on
+	// how much noise klatt has drawn, and no process-wide lock like rand()'s
+	uint32_t x = epContext->bend_rand_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	epContext->bend_rand_state = x;
+	return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
 void espeak_srand(EspeakProcessorContext* epContext, long seed) {
 	epContext->espeak_rand_state = (uint32_t)(seed);
 	(void)espeak_rand(epContext, 0, 1); // Dummy flush a generator
+
+	// splitmix32, so nearby seeds start far apart, and never 0, where xorshift would stay
+	uint32_t z = (uint32_t)seed + 0x9E3779B9u;
+	z = (z ^ (z >> 16)) * 0x85EBCA6Bu;
+	z = (z ^ (z >> 13)) * 0xC2B2AE35u;
+	z ^= z >> 16;
+	epContext->bend_rand_state = z ? z : 0x9E3779B9u;
 }
 
 #pragma GCC visibility push(default)
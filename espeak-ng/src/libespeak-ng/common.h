@@ -28,6 +28,7 @@ extern ESPEAK_NG_API void strncpy0(char *to, const char *from, int size);
 
 void espeak_srand(EspeakProcessorContext* epContext, long seed);
 long espeak_rand(EspeakProcessorContext* epContext, long min, long max);
+float espeak_bend_rand(EspeakProcessorContext* epContext);
 
 int IsAlpha(unsigned int c);
 int IsBracket(int c);
@@ -2459,7 +2459,7 @@ espeak_ng_CompilePhonemeDataPath(EspeakProcessorContext* epContext, long rate,
 
 	LoadPhData(epContext, NULL, NULL);
 
-	WavegenFini();
+	WavegenFini(epContext);
 
 	fprintf(log, "Compiled phonemes: %d errors.\n", ctx->error_count);
 
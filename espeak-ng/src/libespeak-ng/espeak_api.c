@@ -127,6 +127,13 @@ initEspeakContext(EspeakProcessorContext* epContext)
     epContext->sonicSpeed = 1.0;
     #endif
 
+    // bends that leave the sound alone, for clients that never set them
+    epContext->bends.pitchbendMultiplier = 1;
+    epContext->bends.consonantLevel = 1;
+    epContext->bends.vowelLevel = 1;
+    epContext->bends.formantFrequencyRescaler.end = 1;
+    epContext->bends.formantHeightRescaler.end = 1;
+
 
   epContext->len_speeds[0] = 130;
   epContext->len_speeds[1] = 121;
@@ -145,6 +152,7 @@ initEspeakContext(EspeakProcessorContext* epContext)
   epContext->voice_samplerate = 22050;
   epContext->err = ENS_OK;
   epContext->synth_callback = NULL;
+  epContext->event_callback = NULL;
   epContext->n_soundicon_tab = 0;
 
   epContext->n_tunes = 0;
@@ -213,6 +221,7 @@ initEspeakContext(EspeakProcessorContext* epContext)
     epContext->pluginBuffer = NULL;
     epContext->pluginBufferPosition = 0;
     epContext->pluginBufferSize = 0;
+    epContext->pluginSamplesWritten = 0;
 }
 
 
@@ -25,6 +25,7 @@
 
 #include "config.h"
 
+#include <limits.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -40,6 +41,8 @@
 #include "voice.h"       // for voice_t, N_PEAKS
 #if USE_SPEECHPLAYER
 #include "sPlayer.h"
+#include "wavegen.h"     // for writeSampleOut, SungPitch, FramePitchBend
+#include "trace.h"       // for StartTraceRecord, FinishTraceRecord
 #endif
 
 #define getrandom(epcontext, min, max) espeak_rand((epcontext), (min), (max))
@@ -142,6 +145,69 @@ static double antiresonator(resonator_ptr r, double input)
 	return (double)x;
 }
 
+/*
+   function PARALLEL_BANK
+
+   The parallel branch resonators (FNP, F1 to F6) in single precision, side by
+   side. Each one sees either the voicing source or the frication source and
+   only their signed sum is used, so every lane does the same multiply-adds and
+   the loop vectorizes. The coefficients only change once per frame, so
+   parwave() copies them in at the start and the state back out at the end,
+   leaving rsn[] as the reference for resets and the double path.
+ */
+
+static const float parallel_voicing[N_PARALLEL_LANES] = { 1, 1, 0, 0, 0, 0, 0, 0 };
+static const float parallel_frication[N_PARALLEL_LANES] = { 0, 0, 1, 1, 1, 1, 1, 0 };
+static const float parallel_sign[N_PARALLEL_LANES] = { -1, -1, 1, -1, 1, -1, 1, 0 };
+
+static void parallel_bank_load(EspeakProcessorContext* epContext)
+{
+	parallel_bank_t *bank = &epContext->kt_globals.parallel_bank;
+	int lane;
+
+	for (lane = 0; lane < N_PARALLEL_LANES; lane++) {
+		if (Rparallel + lane <= R6p) {
+			resonator_ptr r = &epContext->kt_globals.rsn[Rparallel + lane];
+			bank->a[lane] = (float)r->a;
+			bank->b[lane] = (float)r->b;
+			bank->c[lane] = (float)r->c;
+			bank->p1[lane] = (float)r->p1;
+			bank->p2[lane] = (float)r->p2;
+		} else {
+			bank->a[lane] = bank->b[lane] = bank->c[lane] = 0;
+			bank->p1[lane] = bank->p2[lane] = 0;
+		}
+	}
+}
+
+static void parallel_bank_store(EspeakProcessorContext* epContext)
+{
+	parallel_bank_t *bank = &epContext->kt_globals.parallel_bank;
+	int lane;
+
+	for (lane = 0; Rparallel + lane <= R6p; lane++) {
+		epContext->kt_globals.rsn[Rparallel + lane].p1 = bank->p1[lane];
+		epContext->kt_globals.rsn[Rparallel + lane].p2 = bank->p2[lane];
+	}
+}
+
+static double parallel_bank(parallel_bank_t *bank, double voicing, double frication)
+{
+	float y[N_PARALLEL_LANES];
+	float v = (float)voicing;
+	float f = (float)frication;
+	int lane;
+
+	for (lane = 0; lane < N_PARALLEL_LANES; lane++) {
+		float x = v * parallel_voicing[lane] + f * parallel_frication[lane];
+		y[lane] = bank->a[lane] * x + bank->b[lane] * bank->p1[lane] + bank->c[lane] * bank->p2[lane];
+		bank->p2[lane] = bank->p1[lane];
+		bank->p1[lane] = y[lane];
+		y[lane] *= parallel_sign[lane];
+	}
+	return ((y[0] + y[4]) + (y[2] + y[6])) + ((y[1] + y[5]) + (y[3] + y[7]));
+}
+
 /*
    function FLUTTER
 
@@ -156,18 +222,17 @@ static double antiresonator(resonator_ptr r, double input)
 
 static void flutter(EspeakProcessorContext* epContext, klatt_frame_ptr frame)
 {
-	static int time_count;
 	double delta_f0;
 	double fla, flb, flc, fld, fle;
 
 	fla = (double)epContext->kt_globals.f0_flutter / 50;
 	flb = (double)epContext->kt_globals.original_f0 / 100;
-	flc = sin(M_PI*12.7*time_count); // because we are calling flutter() more frequently, every 2.9mS
-	fld = sin(M_PI*7.1*time_count);
-	fle = sin(M_PI*4.7*time_count);
+	flc = sin(M_PI*12.7*epContext->kt_globals.flutter_time_count); // because we are calling flutter() more frequently, every 2.9mS
+	fld = sin(M_PI*7.1*epContext->kt_globals.flutter_time_count);
+	fle = sin(M_PI*4.7*epContext->kt_globals.flutter_time_count);
 	delta_f0 =  fla * flb * (flc + fld + fle) * 10;
 	frame->F0hz10 = frame->F0hz10 + (long)delta_f0;
-	time_count++;
+	epContext->kt_globals.flutter_time_count++;
 }
 
 /*
@@ -217,6 +282,16 @@ static double sampled_source(EspeakProcessorContext* epContext, int source_num)
 	return result;
 }
 
+// parwave() keeps the source's running values in locals and leaves them in kt_globals when it returns
+static void store_source_state(EspeakProcessorContext* epContext, double noise, double voice, double vlast, double glotlast, double sourc)
+{
+	epContext->kt_globals.noise = noise;
+	epContext->kt_globals.voice = voice;
+	epContext->kt_globals.vlast = vlast;
+	epContext->kt_globals.glotlast = glotlast;
+	epContext->kt_globals.sourc = sourc;
+}
+
 /*
    function PARWAVE
 
@@ -235,18 +310,24 @@ static int parwave(EspeakProcessorContext* epContext, klatt_frame_ptr frame, WGE
 	double aspiration;
 	double casc_next_in;
 	double par_glotout;
-	static double noise;
-	static double voice;
-	static double vlast;
-	static double glotlast;
-	static double sourc;
+	double noise = epContext->kt_globals.noise;
+	double voice = epContext->kt_globals.voice;
+	double vlast = epContext->kt_globals.vlast;
+	double glotlast = epContext->kt_globals.glotlast;
+	double sourc = epContext->kt_globals.sourc;
 	int ix;
+	long resume_ns = epContext->kt_globals.resume_ns;
+
+	epContext->kt_globals.resume_ns = 0;
+	if (resume_ns == 0)
+		flutter(epContext, frame); // add f0 flutter
 
-	flutter(epContext, frame); // add f0 flutter
+	if (epContext->kt_globals.float_parallel_bank)
+		parallel_bank_load(epContext);
 
 	// MAIN LOOP, for each output sample of current frame:
 
-	for (epContext->kt_globals.ns = 0; epContext->kt_globals.ns < epContext->kt_globals.nspfr; epContext->kt_globals.ns++) {
+	for (epContext->kt_globals.ns = resume_ns; epContext->kt_globals.ns < epContext->kt_globals.nspfr; epContext->kt_globals.ns++) {
 		// Get low-passed random number for aspiration and frication noise
 		noise = gen_noise(epContext, noise);
 
@@ -341,22 +422,29 @@ static int parwave(EspeakProcessorContext* epContext, klatt_frame_ptr frame, WGE
 			out = resonator(&(epContext->kt_globals.rsn[R1c]), casc_next_in);
 		}
 
-		// Excite parallel F1 and FNP by voicing waveform
-		sourc = par_glotout; // Source is voicing plus aspiration
+		if (epContext->kt_globals.float_parallel_bank) {
+			// same sum as below: F6 - F5 + F4 - F3 + F2 - F1 - FNP - cascade
+			sourc = frics + par_glotout - glotlast;
+			out = parallel_bank(&epContext->kt_globals.parallel_bank, par_glotout, sourc) - out;
+			glotlast = par_glotout;
+		} else {
+			// Excite parallel F1 and FNP by voicing waveform
+			sourc = par_glotout; // Source is voicing plus aspiration
 
-		// Standard parallel vocal tract Formants F6,F5,F4,F3,F2,
-		// outputs added with alternating sign. Sound source for other
-		// parallel resonators is frication plus first difference of
-		// voicing waveform.
+			// Standard parallel vocal tract Formants F6,F5,F4,F3,F2,
+			// outputs added with alternating sign. Sound source for other
+			// parallel resonators is frication plus first difference of
+			// voicing waveform.
 
-		out += resonator(&(epContext->kt_globals.rsn[R1p]), sourc);
-		out += resonator(&(epContext->kt_globals.rsn[Rnpp]), sourc);
+			out += resonator(&(epContext->kt_globals.rsn[R1p]), sourc);
+			out += resonator(&(epContext->kt_globals.rsn[Rnpp]), sourc);
 
-		sourc = frics + par_glotout - glotlast;
-		glotlast = par_glotout;
+			sourc = frics + par_glotout - glotlast;
+			glotlast = par_glotout;
 
-		for (ix = R2p; ix <= R6p; ix++)
-			out = resonator(&(epContext->kt_globals.rsn[ix]), sourc) - out;
+			for (ix = R2p; ix <= R6p; ix++)
+				out = resonator(&(epContext->kt_globals.rsn[ix]), sourc) - out;
+		}
 
 		outbypas = epContext->kt_globals.amp_bypas * sourc;
 
@@ -410,17 +498,26 @@ static int parwave(EspeakProcessorContext* epContext, klatt_frame_ptr frame, WGE
 		if (value > 32767)
 			value =  32767;
 
-		*epContext->out_ptr++ = value;
-		*epContext->out_ptr++ = value >> 8;
+		writeSampleOut(epContext, value, epContext->bends.vowelLevel);
 
 		epContext->echo_buf[epContext->echo_head++] = value;
 		if (epContext->echo_head >= N_ECHO_BUF)
 			epContext->echo_head = 0;
 
-		epContext->sample_count++;
-		if (epContext->out_ptr + 2 > epContext->out_end)
+		if (!epContext->bends.freeze)
+			epContext->sample_count++;
+		if (epContext->out_ptr + 2 > epContext->out_end) {
+			if (epContext->kt_globals.float_parallel_bank)
+				parallel_bank_store(epContext);
+			store_source_state(epContext, noise, voice, vlast, glotlast, sourc);
+			if (epContext->kt_globals.ns + 1 < epContext->kt_globals.nspfr)
+				epContext->kt_globals.resume_ns = epContext->kt_globals.ns + 1;
 			return 1;
+		}
 	}
+	if (epContext->kt_globals.float_parallel_bank)
+		parallel_bank_store(epContext);
+	store_source_state(epContext, noise, voice, vlast, glotlast, sourc);
 	return 0;
 }
 
@@ -429,7 +526,7 @@ void KlattReset(EspeakProcessorContext* epContext, int control)
 	int r_ix;
 
 #if USE_SPEECHPLAYER
-	KlattResetSP();
+	KlattResetSP(epContext);
 #endif
 
 	if (control == 2) {
@@ -459,10 +556,10 @@ void KlattReset(EspeakProcessorContext* epContext, int control)
 	}
 }
 
-void KlattFini(void)
+void KlattFini(EspeakProcessorContext* epContext)
 {
 #if USE_SPEECHPLAYER
-	KlattFiniSP();
+	KlattFiniSP(epContext);
 #endif
 }
 
@@ -545,7 +642,7 @@ static void frame_init(EspeakProcessorContext* epContext, klatt_frame_ptr frame)
 static double impulsive_source(EspeakProcessorContext* epContext)
 {
 	static const double doublet[] = { 0.0, 13000000.0, -13000000.0 };
-	static double vwave;
+	double vwave;
 
 	if (epContext->kt_globals.nper < 3)
 		vwave = doublet[epContext->kt_globals.nper];
@@ -565,16 +662,15 @@ static double impulsive_source(EspeakProcessorContext* epContext)
 static double natural_source(EspeakProcessorContext* epContext)
 {
 	double lgtemp;
-	static double vwave;
 
 	if (epContext->kt_globals.nper < epContext->kt_globals.nopen) {
 		epContext->kt_globals.pulse_shape_a -= epContext->kt_globals.pulse_shape_b;
-		vwave += epContext->kt_globals.pulse_shape_a;
-		lgtemp = vwave * 0.028;
+		epContext->kt_globals.natural_vwave += epContext->kt_globals.pulse_shape_a;
+		lgtemp = epContext->kt_globals.natural_vwave * 0.028;
 
 		return lgtemp;
 	}
-	vwave = 0.0;
+	epContext->kt_globals.natural_vwave = 0.0;
 	return 0.0;
 }
 
@@ -614,7 +710,6 @@ static void pitch_synch_par_reset(EspeakProcessorContext* epContext, klatt_frame
 {
 	long temp;
 	double temp1;
-	static long skew;
 	static const short B0[224] = {
 		1200, 1142, 1088, 1038, 991, 948, 907, 869, 833, 799, 768, 738, 710, 683, 658,
 		 634,  612,  590,  570, 551, 533, 515, 499, 483, 468, 454, 440, 427, 415, 403,
@@ -686,14 +781,14 @@ static void pitch_synch_par_reset(EspeakProcessorContext* epContext, klatt_frame
 		temp = epContext->kt_globals.T0 - epContext->kt_globals.nopen;
 		if (frame->Kskew > temp)
 			frame->Kskew = temp;
-		if (skew >= 0)
-			skew = frame->Kskew;
+		if (epContext->kt_globals.skew >= 0)
+			epContext->kt_globals.skew = frame->Kskew;
 		else
-			skew = -frame->Kskew;
+			epContext->kt_globals.skew = -frame->Kskew;
 
 		// Add skewness to closed portion of voicing period
-		epContext->kt_globals.T0 = epContext->kt_globals.T0 + skew;
-		skew = -skew;
+		epContext->kt_globals.T0 = epContext->kt_globals.T0 + epContext->kt_globals.skew;
+		epContext->kt_globals.skew = -epContext->kt_globals.skew;
 	} else {
 		epContext->kt_globals.T0 = 4; // Default for f0 undefined
 		epContext->kt_globals.amp_voice = 0.0;
@@ -797,13 +892,12 @@ static void setzeroabc(EspeakProcessorContext* epContext, long int f, long int b
 static double gen_noise(EspeakProcessorContext* epContext, double noise)
 {
 	long temp;
-	static double nlast;
 
 	temp = (long)getrandom(epContext, -8191, 8191);
 	epContext->kt_globals.nrand = (long)temp;
 
-	noise = epContext->kt_globals.nrand + (0.75 * nlast);
-	nlast = noise;
+	noise = epContext->kt_globals.nrand + (0.75 * epContext->kt_globals.nlast);
+	epContext->kt_globals.nlast = noise;
 
 	return noise;
 }
@@ -846,6 +940,26 @@ static double DBtoLIN(long dB)
 	return (double)(amptable[dB]) * 0.001;
 }
 
+// The bend rescalers see formants on the same normalised range as the harmonic
+// peaks in wavegen.c (Hz << 16, up to INT_MAX * 0.8), so a curve sounds the same on every engine.
+#define KLATT_BEND_MAX_FREQ (INT_MAX * 0.8 / 65536)
+// parallel amplitudes are in dB, up to the top of the DBtoLIN table
+#define KLATT_BEND_MAX_AMP 87
+
+long BendFormantFreq(EspeakProcessorContext* epContext, long freq)
+{
+	return (long)(applyBendRescaler(&epContext->bends.formantFrequencyRescaler,
+	        freq / KLATT_BEND_MAX_FREQ, 0, KLATT_BEND_MAX_FREQ) + 0.5f);
+}
+
+static long BendFormantAmp(EspeakProcessorContext* epContext, long ap)
+{
+	if (ap <= 0)
+		return ap;
+	return (long)(applyBendRescaler(&epContext->bends.formantHeightRescaler,
+	        (float)ap / KLATT_BEND_MAX_AMP, 0, KLATT_BEND_MAX_AMP) + 0.5f);
+}
+
 int Wavegen_Klatt(EspeakProcessorContext* epContext, int length, int resume, frame_t *fr1, frame_t *fr2, WGEN_DATA *wdata, voice_t *wvoice)
 {
 #if USE_SPEECHPLAYER
@@ -860,23 +974,36 @@ int Wavegen_Klatt(EspeakProcessorContext* epContext, int length, int resume, fra
 	int x;
 	int ix;
 	int fade;
+	espeak_TRACE_RECORD *record;
 
-	if (resume == 0)
+	if (resume == 0) {
 		epContext->sample_count = 0;
+		epContext->kt_globals.resume_ns = 0;
+	}
 
 	while (epContext->sample_count < epContext->nsamples_klatt) {
-		epContext->kt_frame.F0hz10 = (wdata->pitch * 10) / 4096;
+		if (epContext->noteEndingEarly)
+			return 0;
+
+		if (epContext->kt_globals.resume_ns > 0) {
+			// finish the frame the full buffer cut short, so where the frames fall doesn't depend on the buffer size
+			if (parwave(epContext, &epContext->kt_frame, wdata) == 1)
+				return 1; // output buffer is full
+			continue;
+		}
+
+		epContext->kt_frame.F0hz10 = (long)(((SungPitch(epContext, wdata->pitch) * 10) / 4096) * FramePitchBend(epContext, STEPSIZE));
 
 		// formants F6,F7,F8 are fixed values for cascade resonators, set in KlattInit()
 		// but F6 is used for parallel resonator
 		// F0 is used for the nasal zero
 		for (ix = 0; ix < 6; ix++) {
-			epContext->kt_frame.Fhz[ix] = epContext->klatt_peaks[ix].freq;
+			epContext->kt_frame.Fhz[ix] = BendFormantFreq(epContext, epContext->klatt_peaks[ix].freq);
 			if (ix < 4)
 				epContext->kt_frame.Bhz[ix] = epContext->klatt_peaks[ix].bw;
 		}
 		for (ix = 1; ix < 7; ix++)
-			epContext->kt_frame.Ap[ix] = epContext->klatt_peaks[ix].ap;
+			epContext->kt_frame.Ap[ix] = BendFormantAmp(epContext, epContext->klatt_peaks[ix].ap);
 
 		epContext->kt_frame.AVdb = epContext->klattp[KLATT_AV];
 		epContext->kt_frame.AVpdb = epContext->klattp[KLATT_AVp];
@@ -888,42 +1015,57 @@ int Wavegen_Klatt(EspeakProcessorContext* epContext, int length, int resume, fra
 		epContext->kt_frame.TLTdb = epContext->klattp[KLATT_Tilt];
 		epContext->kt_frame.Kopen = epContext->klattp[KLATT_Kopen];
 
-		// advance formants
-		for (pk = 0; pk < N_PEAKS; pk++) {
-			epContext->klatt_peaks[pk].freq1 += epContext->klatt_peaks[pk].freq_inc;
-			epContext->klatt_peaks[pk].freq = (int)epContext->klatt_peaks[pk].freq1;
-			epContext->klatt_peaks[pk].bw1 += epContext->klatt_peaks[pk].bw_inc;
-			epContext->klatt_peaks[pk].bw = (int)epContext->klatt_peaks[pk].bw1;
-			epContext->klatt_peaks[pk].bp1 += epContext->klatt_peaks[pk].bp_inc;
-			epContext->klatt_peaks[pk].bp = (int)epContext->klatt_peaks[pk].bp1;
-			epContext->klatt_peaks[pk].ap1 += epContext->klatt_peaks[pk].ap_inc;
-			epContext->klatt_peaks[pk].ap = (int)epContext->klatt_peaks[pk].ap1;
-		}
+		// when frozen, hold the formants and pitch where they are
+		if (!epContext->bends.freeze) {
+			// advance formants
+			for (pk = 0; pk < N_PEAKS; pk++) {
+				epContext->klatt_peaks[pk].freq1 += epContext->klatt_peaks[pk].freq_inc;
+				epContext->klatt_peaks[pk].freq = (int)epContext->klatt_peaks[pk].freq1;
+				epContext->klatt_peaks[pk].bw1 += epContext->klatt_peaks[pk].bw_inc;
+				epContext->klatt_peaks[pk].bw = (int)epContext->klatt_peaks[pk].bw1;
+				epContext->klatt_peaks[pk].bp1 += epContext->klatt_peaks[pk].bp_inc;
+				epContext->klatt_peaks[pk].bp = (int)epContext->klatt_peaks[pk].bp1;
+				epContext->klatt_peaks[pk].ap1 += epContext->klatt_peaks[pk].ap_inc;
+				epContext->klatt_peaks[pk].ap = (int)epContext->klatt_peaks[pk].ap1;
+			}
 
-		// advance other parameters
-		for (ix = 0; ix < N_KLATTP; ix++) {
-			epContext->klattp1[ix] += epContext->klattp_inc[ix];
-			epContext->klattp[ix] = (int)epContext->klattp1[ix];
+			// advance other parameters
+			for (ix = 0; ix < N_KLATTP; ix++) {
+				epContext->klattp1[ix] += epContext->klattp_inc[ix];
+				epContext->klattp[ix] = (int)epContext->klattp1[ix];
+			}
+
+			// advance the pitch
+			wdata->pitch_ix += wdata->pitch_inc;
+			if ((ix = wdata->pitch_ix>>8) > 127) ix = 127;
+			x = wdata->pitch_env[ix] * wdata->pitch_range;
+			wdata->pitch = (x>>8) + wdata->pitch_base;
 		}
 
 		for (ix = 0; ix <= 6; ix++) {
-			epContext->kt_frame.Fhz_next[ix] = epContext->klatt_peaks[ix].freq;
+			epContext->kt_frame.Fhz_next[ix] = BendFormantFreq(epContext, epContext->klatt_peaks[ix].freq);
 			if (ix < 4)
 				epContext->kt_frame.Bhz_next[ix] = epContext->klatt_peaks[ix].bw;
 		}
 
-		// advance the pitch
-		wdata->pitch_ix += wdata->pitch_inc;
-		if ((ix = wdata->pitch_ix>>8) > 127) ix = 127;
-		x = wdata->pitch_env[ix] * wdata->pitch_range;
-		wdata->pitch = (x>>8) + wdata->pitch_base;
-
 		epContext->kt_globals.nspfr = (epContext->nsamples_klatt - epContext->sample_count);
 		if (epContext->kt_globals.nspfr > STEPSIZE)
 			epContext->kt_globals.nspfr = STEPSIZE;
 
 		frame_init(epContext, &epContext->kt_frame); // get parameters for next frame of speech
 
+		if ((record = StartTraceRecord(epContext, espeakTRACE_FRAME, epContext->out_ptr)) != NULL) {
+			record->u.frame.pitch = wdata->pitch;
+			record->u.frame.amplitude = wdata->amplitude;
+			record->u.frame.amplitude_fmt = wdata->amplitude_fmt;
+			record->u.frame.n_peaks = 6;
+			for (ix = 0; ix < 6; ix++) {
+				record->u.frame.freq[ix] = epContext->kt_frame.Fhz[ix];
+				record->u.frame.height[ix] = epContext->kt_frame.Ap[ix];
+			}
+			FinishTraceRecord(epContext);
+		}
+
 		if (parwave(epContext, &epContext->kt_frame, wdata) == 1)
 			return 1; // output buffer is full
 	}
@@ -950,7 +1092,7 @@ static void SetSynth_Klatt(EspeakProcessorContext* epContext, int length, frame_
 	int qix;
 	int cmd;
 	frame_t *fr3;
-	static frame_t prev_fr;
+	frame_t *prev_fr = &epContext->klatt_prev_fr;
 
 	if (wvoice != NULL) {
 		if ((wvoice->klattv[0] > 0) && (wvoice->klattv[0] <= 5 )) {
@@ -988,14 +1130,14 @@ static void SetSynth_Klatt(EspeakProcessorContext* epContext, int length, frame_
 		}
 
 		for (ix = 1; ix < 6; ix++) {
-			if (prev_fr.ffreq[ix] != fr1->ffreq[ix]) {
+			if (prev_fr->ffreq[ix] != fr1->ffreq[ix]) {
 				// Discontinuity in formants.
 				// epContext->klatt_end_wave was set in SetSynth_Klatt() to fade out the previous frame
 				KlattReset(epContext, 0);
 				break;
 			}
 		}
-		memcpy(&prev_fr, fr2, sizeof(prev_fr));
+		memcpy(prev_fr, fr2, sizeof(*prev_fr));
 	}
 
 	for (ix = 0; ix < N_KLATTP; ix++) {
@@ -1067,14 +1209,16 @@ void KlattInit(EspeakProcessorContext* epContext)
 
 	int ix;
 
+	epContext->kt_globals.fast_speech_player = 1;
 #if USE_SPEECHPLAYER
-	KlattInitSP();
+	KlattInitSP(epContext);
 #endif
 
 	epContext->sample_count = 0;
 
 	epContext->kt_globals.synthesis_model = CASCADE_PARALLEL;
-	epContext->kt_globals.samrate = 22050;
+	epContext->kt_globals.samrate = epContext->samplerate;
+	epContext->kt_globals.float_parallel_bank = 1;
 
 	epContext->kt_globals.glsource = IMPULSIVE;
 	epContext->kt_globals.scale_wav = scale_wav_tab[epContext->kt_globals.glsource];
@@ -61,9 +61,10 @@ extern "C"
 
 
 void KlattInit(EspeakProcessorContext* epContext);
-void KlattFini(void);
+void KlattFini(EspeakProcessorContext* epContext);
 void KlattReset(EspeakProcessorContext* epContext, int control);
 int Wavegen_Klatt(EspeakProcessorContext* epContext, int length, int resume, frame_t *fr1, frame_t *fr2, WGEN_DATA *wdata, voice_t *wvoice);
+long BendFormantFreq(EspeakProcessorContext* epContext, long freq);
 
 #ifdef __cplusplus
 }
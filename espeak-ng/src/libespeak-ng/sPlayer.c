@@ -1,6 +1,7 @@
 #include "sPlayer.h"
+#include "klatt.h"       // for BendFormantFreq
+#include "wavegen.h"     // for writeSampleOut, SungPitch, VibratoRate
 
-static speechPlayer_handle_t speechPlayerHandle=NULL;
 static const unsigned int minFadeLength=110;
 
 static int MIN(int a, int b) { return((a) < (b) ? a : b); }
@@ -52,21 +53,25 @@ static bool isKlattFrameFollowing(EspeakProcessorContext* epContext) {
 	return false;
 }
 
-static void fillSpeechPlayerFrame(WGEN_DATA *wdata, voice_t *wvoice, frame_t * eFrame, speechPlayer_frame_t* spFrame) {
+static void fillSpeechPlayerFrame(EspeakProcessorContext* epContext, WGEN_DATA *wdata, voice_t *wvoice, frame_t * eFrame, speechPlayer_frame_t* spFrame) {
 	// eSpeak stores pitch in 4096ths of a hz. Specifically comments in voice.h  mentions pitch<<12.
 	// SpeechPlayer deals with floating point values  of hz.
-	spFrame->voicePitch=(wdata->pitch)/4096.0;
+	spFrame->voicePitch=SungPitch(epContext, wdata->pitch)/4096.0*epContext->bends.pitchbendMultiplier;
+	// speechPlayer runs its own vibrato, match the depth (+-10%) and rate of the wavegen one.
+	// Its offset is scaled by 0.06 internally.
+	spFrame->vibratoPitchOffset=epContext->bends.vibratoAmount*0.1/0.06;
+	spFrame->vibratoSpeed=VibratoRate(epContext);
 	// eSpeak stores voicing amplitude with 64 representing 100% according to comments in voice.h.
 	// speechPlayer uses floating point value of 1 as 100%.
 	spFrame->voiceAmplitude=(wvoice->voicing)/64.0;
 	spFrame->aspirationAmplitude=(wvoice->breath[1])/64.0;
 	// All of eSpeak's relative formant frequency ratio values are stored with 256 representing 100% according to comments in voice.h. 
-	spFrame->cf1=(eFrame->ffreq[1]*wvoice->freq[1]/256.0)+wvoice->freqadd[1];
-	spFrame->cf2=(eFrame->ffreq[2]*wvoice->freq[2]/256.0)+wvoice->freqadd[2];
-	spFrame->cf3=(eFrame->ffreq[3]*wvoice->freq[3]/256.0)+wvoice->freqadd[3];
-	spFrame->cf4=(eFrame->ffreq[4]*wvoice->freq[4]/256.0)+wvoice->freqadd[4];
-	spFrame->cf5=(eFrame->ffreq[5]*wvoice->freq[5]/256.0)+wvoice->freqadd[5];
-	spFrame->cf6=(eFrame->ffreq[6]*wvoice->freq[6]/256.0)+wvoice->freqadd[6];
+	spFrame->cf1=BendFormantFreq(epContext, (eFrame->ffreq[1]*wvoice->freq[1]/256.0)+wvoice->freqadd[1]);
+	spFrame->cf2=BendFormantFreq(epContext, (eFrame->ffreq[2]*wvoice->freq[2]/256.0)+wvoice->freqadd[2]);
+	spFrame->cf3=BendFormantFreq(epContext, (eFrame->ffreq[3]*wvoice->freq[3]/256.0)+wvoice->freqadd[3]);
+	spFrame->cf4=BendFormantFreq(epContext, (eFrame->ffreq[4]*wvoice->freq[4]/256.0)+wvoice->freqadd[4]);
+	spFrame->cf5=BendFormantFreq(epContext, (eFrame->ffreq[5]*wvoice->freq[5]/256.0)+wvoice->freqadd[5]);
+	spFrame->cf6=BendFormantFreq(epContext, (eFrame->ffreq[6]*wvoice->freq[6]/256.0)+wvoice->freqadd[6]);
 	spFrame->cfNP=200;
 	spFrame->cfN0=250;
 	if(eFrame->klattp[KLATT_FNZ]>0) {
@@ -88,30 +93,35 @@ static void fillSpeechPlayerFrame(WGEN_DATA *wdata, voice_t *wvoice, frame_t * e
 	spFrame->endVoicePitch=spFrame->voicePitch;
 }
 
-void KlattInitSP(void) {
-	speechPlayerHandle=speechPlayer_initialize(22050);
+void KlattInitSP(EspeakProcessorContext* epContext) {
+	KlattFiniSP(epContext);
+	if (epContext->kt_globals.fast_speech_player)
+		epContext->kt_globals.speech_player=speechPlayer_initializeFast(22050);
+	else
+		epContext->kt_globals.speech_player=speechPlayer_initialize(22050);
 }
 
-void KlattFiniSP(void) {
-	if (speechPlayerHandle)
-		speechPlayer_terminate(speechPlayerHandle);
-	speechPlayerHandle = NULL;
+void KlattFiniSP(EspeakProcessorContext* epContext) {
+	if (epContext->kt_globals.speech_player)
+		speechPlayer_terminate(epContext->kt_globals.speech_player);
+	epContext->kt_globals.speech_player = NULL;
 }
 
-void KlattResetSP(void) {
-	KlattFiniSP();
-	KlattInitSP();
+void KlattResetSP(EspeakProcessorContext* epContext) {
+	KlattFiniSP(epContext);
+	KlattInitSP(epContext);
 }
 
 int Wavegen_KlattSP(EspeakProcessorContext* epContext, WGEN_DATA *wdata, voice_t *wvoice, int length, int resume, frame_t *fr1, frame_t *fr2){
+	speechPlayer_handle_t speechPlayerHandle=epContext->kt_globals.speech_player;
 	if(!resume) {
 		speechPlayer_frame_t spFrame1={0};
-		fillSpeechPlayerFrame(wdata, wvoice, fr1,&spFrame1);
+		fillSpeechPlayerFrame(epContext, wdata, wvoice, fr1,&spFrame1);
 		speechPlayer_frame_t spFrame2={0};
-		fillSpeechPlayerFrame(wdata, wvoice, fr2,&spFrame2);
+		fillSpeechPlayerFrame(epContext, wdata, wvoice, fr2,&spFrame2);
 		wdata->pitch_ix+=(wdata->pitch_inc*(length/STEPSIZE));
 		wdata->pitch=((wdata->pitch_env[MIN(wdata->pitch_ix>>8,127)]*wdata->pitch_range)>>8)+wdata->pitch_base;
-		spFrame2.endVoicePitch=wdata->pitch/4096;
+		spFrame2.endVoicePitch=SungPitch(epContext, wdata->pitch)/4096*epContext->bends.pitchbendMultiplier;
 		bool willMixWaveFile=needsMixWaveFile(wdata);
 		if(willMixWaveFile) {
 			spFrame1.outputGain/=5;
@@ -138,6 +148,16 @@ int Wavegen_KlattSP(EspeakProcessorContext* epContext, WGEN_DATA *wdata, voice_t
 	unsigned int maxLength=(epContext->out_end-epContext->out_ptr)/sizeof(sample);
 	unsigned int outLength=speechPlayer_synthesize(speechPlayerHandle,maxLength,(sample*)epContext->out_ptr);
 	mixWaveFile(wdata, outLength,(sample*)epContext->out_ptr);
+	if(epContext->pluginBuffer!=NULL) {
+		// the plugin takes its samples one at a time, so the output buffer is only used as scratch space.
+		// When pulling, writeSampleOut moves out_ptr along over the same samples
+		sample* samples=(sample*)epContext->out_ptr;
+		for(unsigned int i=0;i<outLength;++i) {
+			if(epContext->noteEndingEarly) return 0;
+			writeSampleOut(epContext,samples[i].value,epContext->bends.vowelLevel);
+		}
+		return outLength>=maxLength;
+	}
 	epContext->out_ptr=epContext->out_ptr+(sizeof(sample)*outLength);
 	if(epContext->out_ptr>=epContext->out_end) return 1;
 	return 0;
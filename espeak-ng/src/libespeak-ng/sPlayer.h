@@ -9,9 +9,9 @@
 extern "C" {
 #endif
 
-	void KlattInitSP(void);
-	void KlattResetSP(void);
-	void KlattFiniSP(void);
+	void KlattInitSP(EspeakProcessorContext* epContext);
+	void KlattResetSP(EspeakProcessorContext* epContext);
+	void KlattFiniSP(EspeakProcessorContext* epContext);
 	int Wavegen_KlattSP(EspeakProcessorContext* epContext, WGEN_DATA *wdata, voice_t *wvoice, int length, int resume, frame_t *fr1, frame_t *fr2);
 
 #ifdef __cplusplus
@@ -59,6 +59,7 @@
 #include "readclause.h"           // for PARAM_STACK, param_stack
 #include "synthdata.h"            // for FreePhData, LoadPhData
 #include "synthesize.h"           // for SpeakNextClause, Generate, Synthesi...
+#include "trace.h"                // for TraceStart
 #include "translate.h"            // for p_decoder, InitText, translator
 #include "voice.h"                // for FreeVoiceList, VoiceReset, current_...
 #include "wavegen.h"              // for WavegenFill, WavegenInit, WcmdqUsed
@@ -353,6 +354,7 @@ ESPEAK_NG_API espeak_ng_STATUS espeak_ng_Initialize(EspeakProcessorContext* epCo
 	if (result != ENS_OK)
 		return result;
 
+	epContext->wavefile_samplerate = srate;
 	WavegenInit(epContext, srate, 0);
 	LoadConfig(epContext);
 
@@ -376,8 +378,8 @@ ESPEAK_NG_API espeak_ng_STATUS espeak_ng_Initialize(EspeakProcessorContext* epCo
 	epContext->option_phonemes = 0;
 	epContext->option_phoneme_events = 0;
 
-	// Seed random generator
-	espeak_srand(epContext, time(NULL));
+	// Seed random generator, differently for contexts set up in the same second
+	espeak_srand(epContext, (long)(time(NULL) ^ (intptr_t)epContext));
 
 	return ENS_OK;
 }
@@ -414,6 +416,8 @@ static espeak_ng_STATUS Synthesize(EspeakProcessorContext* epContext, unsigned i
 	epContext->option_endpause = flags & espeakENDPAUSE;
 
 	epContext->count_samples = 0;
+	epContext->pluginSamplesWritten = 0;
+	TraceStart(epContext);
 
 	espeak_ng_STATUS status;
 	if (epContext->translator == NULL) {
@@ -422,15 +426,23 @@ static espeak_ng_STATUS Synthesize(EspeakProcessorContext* epContext, unsigned i
 			return status;
 	}
 
-	if (epContext->p_decoder == NULL)
-		epContext->p_decoder = create_text_decoder();
+	if ((epContext->phoneme_cache == NULL) && (epContext->command_stream == NULL)) {
+		if (epContext->p_decoder == NULL)
+			epContext->p_decoder = create_text_decoder();
 
-	status = text_decoder_decode_string_multibyte(epContext->p_decoder, text, epContext->translator->encoding, flags);
-	if (status != ENS_OK)
-		return status;
+		status = text_decoder_decode_string_multibyte(epContext->p_decoder, text, epContext->translator->encoding, flags);
+		if (status != ENS_OK)
+			return status;
+	}
 
 	SpeakNextClause(epContext, 0);
 
+	if (epContext->pullMode) {
+		// the sound is fetched with espeak_ng_PullSamples()
+		epContext->pulling = true;
+		return ENS_OK;
+	}
+
 	for (;;) {
 		epContext->out_ptr = epContext->outbuf;
 		epContext->out_end = &epContext->outbuf[epContext->outbuf_size];
@@ -454,7 +466,8 @@ static espeak_ng_STATUS Synthesize(EspeakProcessorContext* epContext, unsigned i
 			return ENS_SPEECH_STOPPED;
 		}
 
-		if (Generate(epContext, epContext->phoneme_list, &epContext->n_phoneme_list, 1) == 0) {
+		if (((epContext->command_stream != NULL) ? ReplayCommandStream(epContext)
+		                                          : Generate(epContext, epContext->phoneme_list, &epContext->n_phoneme_list, 1)) == 0) {
 			if (WcmdqUsed(epContext) == 0) {
 				// don't process the next clause until the previous clause has finished generating speech.
 				// This ensures that <audio> tag (which causes end-of-clause) is at a sound buffer boundary
@@ -481,29 +494,54 @@ static espeak_ng_STATUS Synthesize(EspeakProcessorContext* epContext, unsigned i
 	}
 }
 
+long SynthesisSample(EspeakProcessorContext* epContext, unsigned char *out_ptr)
+{
+#if !USE_MBROLA
+	static const int mbrola_delay = 0;
+#endif
+
+	// a plugin buffer blocking in wavegen doesn't hand the output buffer over, so it counts its own samples
+	if (epContext->pluginBuffer != NULL)
+		return epContext->pluginSamplesWritten;
+	if (out_ptr == NULL)
+		return epContext->count_samples;
+	return epContext->count_samples + mbrola_delay + (out_ptr - epContext->out_start)/2;
+}
+
 void MarkerEvent(EspeakProcessorContext* epContext, int type, unsigned int char_position, int value, int value2, unsigned char *out_ptr)
 {
 	// type: 1=word, 2=sentence, 3=named mark, 4=play audio, 5=end, 7=phoneme
 	espeak_EVENT *ep;
+	espeak_EVENT unlisted;
 	double time;
+	long sample;
+	size_t name_length;
+
+	if (type == espeakEVENT_PHONEME) {
+		// the frames traced from here on are this phoneme's. Whatever follows the name is left out
+		memcpy(&epContext->trace_phoneme[0], &value, 4);
+		memcpy(&epContext->trace_phoneme[4], &value2, 4);
+		name_length = strnlen(epContext->trace_phoneme, sizeof(epContext->trace_phoneme));
+		memset(&epContext->trace_phoneme[name_length], 0, sizeof(epContext->trace_phoneme) - name_length);
+	}
 
-	if ((epContext->event_list == NULL) || (epContext->event_list_ix >= (epContext->n_event_list-2)))
+	if ((epContext->event_list != NULL) && (epContext->event_list_ix < (epContext->n_event_list-2)))
+		ep = &epContext->event_list[epContext->event_list_ix++];
+	else if (epContext->event_callback != NULL)
+		ep = &unlisted; // the list only empties when the output buffer is handed over, the callback doesn't wait for that
+	else
 		return;
 
-	ep = &epContext->event_list[epContext->event_list_ix++];
 	ep->type = (espeak_EVENT_TYPE)type;
 	ep->unique_identifier = epContext->my_unique_identifier;
 	ep->user_data = epContext->my_user_data;
 	ep->text_position = char_position & 0xffffff;
 	ep->length = char_position >> 24;
 
-#if !USE_MBROLA
-	static const int mbrola_delay = 0;
-#endif
-
-	time = ((double)(epContext->count_samples + mbrola_delay + (out_ptr - epContext->out_start)/2)*1000.0)/epContext->samplerate;
+	sample = SynthesisSample(epContext, out_ptr);
+	time = ((double)sample*1000.0)/epContext->samplerate;
 	ep->audio_position = (int)time;
-	ep->sample = (epContext->count_samples + mbrola_delay + (out_ptr - epContext->out_start)/2);
+	ep->sample = sample;
 
 	if ((type == espeakEVENT_MARK) || (type == espeakEVENT_PLAY))
 		ep->id.name = &epContext->namedata[value];
@@ -514,6 +552,9 @@ void MarkerEvent(EspeakProcessorContext* epContext, int type, unsigned int char_
 		p[1] = value2;
 	} else
 		ep->id.number = value;
+
+	if (epContext->event_callback != NULL)
+		epContext->event_callback(ep);
 }
 
 espeak_ng_STATUS sync_espeak_Synth(EspeakProcessorContext* epContext,
@@ -630,6 +671,12 @@ ESPEAK_API void espeak_SetSynthCallback(EspeakProcessorContext* epContext, t_esp
 #endif
 }
 
+ESPEAK_NG_API espeak_ng_STATUS espeak_ng_SetEventCallback(EspeakProcessorContext* epContext, t_espeak_event_callback *callback)
+{
+	epContext->event_callback = callback;
+	return ENS_OK;
+}
+
 ESPEAK_NG_API espeak_ng_STATUS
 espeak_ng_Synthesize(EspeakProcessorContext* epContext, const void *text, size_t size,
                      unsigned int position,
@@ -727,6 +774,180 @@ espeak_ng_SynthesizeMark(EspeakProcessorContext* epContext, const void *text,
 #endif
 }
 
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_TranslatePhonemeCache(EspeakProcessorContext* epContext, const void *text,
+                                unsigned int flags,
+                                espeak_ng_PHONEME_CACHE *cache)
+{
+	espeak_ng_STATUS status;
+
+	if (text == NULL || cache == NULL)
+		return EINVAL;
+	*cache = NULL;
+
+	if (epContext->translator == NULL) {
+		status = espeak_ng_SetVoiceByName(epContext, ESPEAKNG_DEFAULT_VOICE);
+		if (status != ENS_OK)
+			return status;
+	}
+
+	// the same setup as sync_espeak_Synth() and Synthesize(), from the start of the text
+	InitText(epContext, flags);
+	epContext->option_ssml = flags & espeakSSML;
+	epContext->option_phoneme_input = flags & espeakPHONEMES;
+	epContext->option_endpause = flags & espeakENDPAUSE;
+
+	if (epContext->p_decoder == NULL)
+		epContext->p_decoder = create_text_decoder();
+
+	status = text_decoder_decode_string_multibyte(epContext->p_decoder, text, epContext->translator->encoding, flags);
+	if (status != ENS_OK)
+		return status;
+
+	return TranslatePhonemeCache(epContext, cache);
+}
+
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SynthesizePhonemeCache(EspeakProcessorContext* epContext,
+                                 espeak_ng_PHONEME_CACHE cache,
+                                 void *user_data)
+{
+	espeak_ng_STATUS status;
+
+	if (cache == NULL)
+		return EINVAL;
+	if (!(epContext->my_mode & ENOUTPUT_MODE_SYNCHRONOUS))
+		return ENS_NOT_SUPPORTED;
+
+	epContext->phoneme_cache = cache;
+	epContext->phoneme_cache_ix = 0;
+	status = sync_espeak_Synth(epContext, 0, NULL, 0, POS_CHARACTER, 0, espeakCHARS_AUTO, user_data);
+	if (!epContext->pulling)
+		epContext->phoneme_cache = NULL;
+	return status;
+}
+
+ESPEAK_NG_API void
+espeak_ng_FreePhonemeCache(espeak_ng_PHONEME_CACHE cache)
+{
+	FreePhonemeCache(cache);
+}
+
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_RecordCommandStream(EspeakProcessorContext* epContext,
+                              espeak_ng_PHONEME_CACHE cache,
+                              espeak_ng_COMMAND_STREAM *stream)
+{
+	espeak_ng_STATUS status;
+
+	if ((cache == NULL) || (stream == NULL))
+		return EINVAL;
+	if (!(epContext->my_mode & ENOUTPUT_MODE_SYNCHRONOUS))
+		return ENS_NOT_SUPPORTED;
+
+	if (epContext->translator == NULL) {
+		status = espeak_ng_SetVoiceByName(epContext, ESPEAKNG_DEFAULT_VOICE);
+		if (status != ENS_OK)
+			return status;
+	}
+
+	InitText(epContext, 0);
+	epContext->phoneme_cache = cache;
+	epContext->phoneme_cache_ix = 0;
+	status = RecordCommandStream(epContext, stream);
+	epContext->phoneme_cache = NULL;
+	return status;
+}
+
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SynthesizeCommandStream(EspeakProcessorContext* epContext,
+                                  espeak_ng_COMMAND_STREAM stream,
+                                  void *user_data)
+{
+	espeak_ng_STATUS status;
+
+	if (stream == NULL)
+		return EINVAL;
+	if (!(epContext->my_mode & ENOUTPUT_MODE_SYNCHRONOUS))
+		return ENS_NOT_SUPPORTED;
+	if (epContext->bends.rotatePhonemes != 0)
+		return ENS_NOT_SUPPORTED;
+	if ((epContext->samplerate != stream->samplerate) || (epContext->voice == NULL) ||
+	    ((epContext->voice->klattv[0] != 0) != stream->klatt))
+		return ENS_NOT_SUPPORTED; // recorded for a different rate or engine
+
+	memset(&epContext->replay, 0, sizeof(epContext->replay));
+	epContext->command_stream = stream;
+	status = sync_espeak_Synth(epContext, 0, NULL, 0, POS_CHARACTER, 0, espeakCHARS_AUTO, user_data);
+	if (!epContext->pulling)
+		epContext->command_stream = NULL;
+	return status;
+}
+
+ESPEAK_NG_API void
+espeak_ng_FreeCommandStream(espeak_ng_COMMAND_STREAM stream)
+{
+	FreeCommandStream(stream);
+}
+
+static void StopPulling(EspeakProcessorContext* epContext)
+{
+	epContext->pulling = false;
+	epContext->phoneme_cache = NULL;
+	epContext->command_stream = NULL;
+}
+
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SetPullMode(EspeakProcessorContext* epContext, int enable)
+{
+	if (!(epContext->my_mode & ENOUTPUT_MODE_SYNCHRONOUS))
+		return ENS_NOT_SUPPORTED;
+
+	if (epContext->pulling) {
+		// abandon whatever hadn't been pulled yet
+		SpeakNextClause(epContext, 2);
+		StopPulling(epContext);
+	}
+	epContext->pullMode = enable != 0;
+	return ENS_OK;
+}
+
+ESPEAK_NG_API int
+espeak_ng_PullSamples(EspeakProcessorContext* epContext, float *buffer, int n_samples)
+{
+	// the loop in Synthesize(), with the buffer ending where the caller's does
+	int max_bytes;
+
+	if (!epContext->pullMode || !epContext->pulling || (buffer == NULL))
+		return 0;
+
+	epContext->pluginBuffer = buffer;
+	epContext->pluginBufferSize = n_samples;
+	epContext->pluginBufferPosition = 0;
+
+	while (epContext->pluginBufferPosition < n_samples) {
+		max_bytes = (n_samples - epContext->pluginBufferPosition) * 2;
+		if (max_bytes > epContext->outbuf_size)
+			max_bytes = epContext->outbuf_size;
+		epContext->out_ptr = epContext->outbuf;
+		epContext->out_end = &epContext->outbuf[max_bytes];
+		epContext->event_list_ix = 0;
+		WavegenFill(epContext);
+		epContext->count_samples += (epContext->out_ptr - epContext->outbuf)/2;
+
+		if (((epContext->command_stream != NULL) ? ReplayCommandStream(epContext)
+		                                          : Generate(epContext, epContext->phoneme_list, &epContext->n_phoneme_list, 1)) == 0) {
+			if ((WcmdqUsed(epContext) == 0) && (SpeakNextClause(epContext, 1) == 0)) {
+				StopPulling(epContext);
+				break;
+			}
+		}
+	}
+
+	epContext->pluginBuffer = NULL;
+	return epContext->pluginBufferPosition;
+}
+
 ESPEAK_NG_API espeak_ng_STATUS espeak_ng_SpeakKeyName(EspeakProcessorContext* epContext, const char *key_name)
 {
 	// symbolic name, symbolicname_character  - is there a system resource of symbolicnames per language
@@ -928,7 +1149,7 @@ ESPEAK_NG_API espeak_ng_STATUS espeak_ng_Terminate(EspeakProcessorContext* epCon
 		epContext->p_decoder = NULL;
 	}
 
-	WavegenFini();
+	WavegenFini(epContext);
 
 	return ENS_OK;
 }
@@ -102,7 +102,7 @@ espeak_ng_STATUS LoadPhData(EspeakProcessorContext* epContext, int *srate, espea
 		return status;
 	if ((status = ReadPhFile(epContext, (void **)&epContext->phoneme_index, "phonindex", NULL, context)) != ENS_OK)
 		return status;
-	if ((status = ReadPhFile(epContext, (void **)&epContext->phondata_ptr, "phondata", NULL, context)) != ENS_OK)
+	if ((status = ReadPhFile(epContext, (void **)&epContext->phondata_ptr, "phondata", &epContext->phondata_size, context)) != ENS_OK)
 		return status;
 	if ((status = ReadPhFile(epContext, (void **)&epContext->tunes, "intonations", &length, context)) != ENS_OK)
 		return status;
@@ -155,6 +155,7 @@ void FreePhData(EspeakProcessorContext* epContext)
 	epContext->phoneme_tab_data = NULL;
 	epContext->phoneme_index = NULL;
 	epContext->phondata_ptr = NULL;
+	epContext->phondata_size = 0;
 	epContext->tunes = NULL;
 	epContext->current_phoneme_table = -1;
 }
@@ -199,9 +200,9 @@ frameref_t *LookupSpect(EspeakProcessorContext* epContext, PHONEME_TAB *this_ph,
 	SPECT_SEQ *seq, *seq2;
 	SPECT_SEQK *seqk, *seqk2;
 	frame_t *frame;
-	static frameref_t frames_buf[N_SEQ_FRAMES];
+	frameref_t *frames_buf = epContext->frames_buf;
 
-	MAKE_MEM_UNDEFINED(&frames_buf, sizeof(frames_buf));
+	MAKE_MEM_UNDEFINED(frames_buf, sizeof(epContext->frames_buf));
 
 	seq = (SPECT_SEQ *)(&epContext->phondata_ptr[fmt_params->fmt_addr]);
 	seqk = (SPECT_SEQK *)seq;
@@ -344,6 +345,49 @@ static void SetUpPhonemeTable(EspeakProcessorContext* epContext, int number)
 	}
 }
 
+espeak_PHONEME_CLASS PhonemeClass(const PHONEME_TAB *ph)
+{
+	switch (ph->type)
+	{
+	case phVOWEL:
+		return espeakPHONEME_VOWEL;
+	case phLIQUID:
+		return espeakPHONEME_LIQUID;
+	case phSTOP:
+	case phVSTOP:
+		return espeakPHONEME_STOP;
+	case phFRICATIVE:
+	case phVFRICATIVE:
+		return espeakPHONEME_FRICATIVE;
+	case phNASAL:
+		return espeakPHONEME_NASAL;
+	default:
+		return espeakPHONEME_SILENT; // pauses, stresses, virtual and deleted phonemes
+	}
+}
+
+static void SetUpPhonemeRotation(EspeakProcessorContext* epContext)
+{
+	PhonemeRotation *rotation = &epContext->phoneme_rotation;
+	int code;
+
+	memset(rotation->n_codes, 0, sizeof(rotation->n_codes));
+	memset(rotation->index, ROTATION_NONE, sizeof(rotation->index));
+
+	for (code = 0; code < epContext->n_phoneme_tab; code++) {
+		PHONEME_TAB *ph = epContext->phoneme_tab[code];
+		int rclass;
+
+		// only phonemes with a program to make their sound, and which are where their code says
+		if (ph == NULL || ph->code != code || ph->program == 0 || (rclass = PhonemeClass(ph)) == espeakPHONEME_SILENT)
+			continue;
+		rotation->index[0][code] = rotation->n_codes[0];
+		rotation->codes[0][rotation->n_codes[0]++] = code;
+		rotation->index[rclass][code] = rotation->n_codes[rclass];
+		rotation->codes[rclass][rotation->n_codes[rclass]++] = code;
+	}
+}
+
 void SelectPhonemeTable(EspeakProcessorContext* epContext, int number)
 {
 	if (epContext->current_phoneme_table == number) return;
@@ -352,6 +396,28 @@ void SelectPhonemeTable(EspeakProcessorContext* epContext, int number)
 	SetUpPhonemeTable(epContext, number); // recursively for included phoneme tables
 	epContext->n_phoneme_tab++;
 	epContext->current_phoneme_table = number;
+	SetUpPhonemeRotation(epContext);
+}
+
+PHONEME_TAB *RotatePhoneme(EspeakProcessorContext* epContext, PHONEME_TAB *ph, int amount)
+{
+	const PhonemeRotation *rotation = &epContext->phoneme_rotation;
+	int rclass;
+	int n;
+
+	// a phoneme from another table than the one selected has nowhere in this map to go
+	if (amount == 0 || ph == NULL || ph->code >= epContext->n_phoneme_tab || epContext->phoneme_tab[ph->code] != ph)
+		return ph;
+
+	rclass = epContext->bends.rotateAcrossClasses ? 0 : PhonemeClass(ph);
+	n = rotation->n_codes[rclass];
+	if (n == 0 || rotation->index[rclass][ph->code] == ROTATION_NONE)
+		return ph;
+
+	amount %= n;
+	if (amount < 0)
+		amount += n;
+	return epContext->phoneme_tab[rotation->codes[rclass][(rotation->index[rclass][ph->code] + amount) % n]];
 }
 
 int LookupPhonemeTable(EspeakProcessorContext* epContext, const char *name)
@@ -55,6 +55,8 @@ frameref_t *LookupSpect(EspeakProcessorContext* epContext, PHONEME_TAB *this_ph,
 int PhonemeCode(EspeakProcessorContext* epContext, unsigned int mnem);
 void SelectPhonemeTable(EspeakProcessorContext* epContext, int number);
 int  SelectPhonemeTableName(EspeakProcessorContext* epContext, const char *name);
+espeak_PHONEME_CLASS PhonemeClass(const PHONEME_TAB *ph);
+PHONEME_TAB *RotatePhoneme(EspeakProcessorContext* epContext, PHONEME_TAB *ph, int amount);
 
 #ifdef __cplusplus
 }
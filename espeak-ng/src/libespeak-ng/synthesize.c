@@ -34,12 +34,14 @@
 #include <espeak-ng/encoding.h>
 
 #include "synthesize.h"
+#include "common.h"               // for strncpy0
 #include "dictionary.h"           // for WritePhMnemonic, GetTranslatedPhone...
 #include "intonation.h"           // for CalcPitches
 #include "mbrola.h"               // for MbrolaGenerate, mbrola_name
 #include "phoneme.h"              // for PHONEME_TAB, phVOWEL, phLIQUID, phN...
 #include "setlengths.h"           // for CalcLengths
 #include "soundicon.h"            // for soundicon_tab, n_soundicon
+#include "trace.h"                // for StartTraceRecord, FinishTraceRecord, EnterStage
 #include "synthdata.h"            // for InterpretPhoneme, GetEnvelope, Inte...
 #include "translate.h"            // for translator, LANGUAGE_OPTIONS, Trans...
 #include "voice.h"                // for voice_t, voice, LoadVoiceVariant
@@ -354,22 +356,19 @@ int DoSample3(EspeakProcessorContext* epContext, PHONEME_DATA *phdata, int lengt
 	return len;
 }
 
-static frame_t *AllocFrame(void)
+static frame_t *AllocFrame(EspeakProcessorContext* epContext)
 {
 	// Allocate a temporary spectrum frame for the wavegen queue. Use a pool which is big
 	// enough to use a round-robin without checks.
 	// Only needed for modifying spectra for blending to consonants
 
-	#define N_FRAME_POOL N_WCMDQ
-	static int ix = 0;
-	static frame_t frame_pool[N_FRAME_POOL];
-
-	ix++;
-	if (ix >= N_FRAME_POOL)
+	int ix = epContext->frame_pool_ix + 1;
+	if (ix >= N_WCMDQ)
 		ix = 0;
+	epContext->frame_pool_ix = ix;
 
-	MAKE_MEM_UNDEFINED(&frame_pool[ix], sizeof(frame_pool[ix]));
-	return &frame_pool[ix];
+	MAKE_MEM_UNDEFINED(&epContext->frame_pool[ix], sizeof(epContext->frame_pool[ix]));
+	return &epContext->frame_pool[ix];
 }
 
 static void set_frame_rms(EspeakProcessorContext* epContext, frame_t *fr, int new_rms)
@@ -428,7 +427,7 @@ static void formants_reduce_hf(EspeakProcessorContext* epContext, frame_t *fr, i
 	}
 }
 
-static frame_t *CopyFrame(frame_t *frame1, int copy)
+static frame_t *CopyFrame(EspeakProcessorContext* epContext, frame_t *frame1, int copy)
 {
 	// create a copy of the specified frame in temporary buffer
 
@@ -439,7 +438,7 @@ static frame_t *CopyFrame(frame_t *frame1, int copy)
 		return frame1;
 	}
 
-	frame2 = AllocFrame();
+	frame2 = AllocFrame(epContext);
 	if (frame2 != NULL) {
 		memcpy(frame2, frame1, sizeof(frame_t));
 		frame2->length = 0;
@@ -448,12 +447,12 @@ static frame_t *CopyFrame(frame_t *frame1, int copy)
 	return frame2;
 }
 
-static frame_t *DuplicateLastFrame(frameref_t *seq, int n_frames, int length)
+static frame_t *DuplicateLastFrame(EspeakProcessorContext* epContext, frameref_t *seq, int n_frames, int length)
 {
 	frame_t *fr;
 
 	seq[n_frames-1].length = length;
-	fr = CopyFrame(seq[n_frames-1].frame, 1);
+	fr = CopyFrame(epContext, seq[n_frames-1].frame, 1);
 	seq[n_frames].frame = fr;
 	seq[n_frames].length = 0;
 	return fr;
@@ -555,7 +554,7 @@ int FormantTransition2(EspeakProcessorContext* epContext, frameref_t *seq, int *
 
 	if (which == 1) {
 		// entry to vowel
-		fr = CopyFrame(seq[0].frame, 0);
+		fr = CopyFrame(epContext, seq[0].frame, 0);
 		seq[0].frame = fr;
 		seq[0].length = VOWEL_FRONT_LENGTH;
 		if (len > 0)
@@ -589,14 +588,14 @@ int FormantTransition2(EspeakProcessorContext* epContext, frameref_t *seq, int *
 		if ((f2 != 0) || (flags != 0)) {
 
 			if (flags & 8) {
-				fr = CopyFrame(seq[*n_frames-1].frame, 0);
+				fr = CopyFrame(epContext, seq[*n_frames-1].frame, 0);
 				seq[*n_frames-1].frame = fr;
 				rms = RMS_GLOTTAL1;
 
 				// degree of glottal-stop effect depends on closeness of vowel (indicated by f1 freq)
 				epContext->modn_flags = 0x400 + (VowelCloseness(fr) << 8);
 			} else {
-				fr = DuplicateLastFrame(seq, (*n_frames)++, len);
+				fr = DuplicateLastFrame(epContext, seq, (*n_frames)++, len);
 				if (len > 36)
 					epContext->seq_len_adjust += (len - 36);
 
@@ -608,7 +607,7 @@ int FormantTransition2(EspeakProcessorContext* epContext, frameref_t *seq, int *
 
 			if ((vcolour > 0) && (vcolour <= N_VCOLOUR)) {
 				for (int ix = 0; ix < *n_frames; ix++) {
-					fr = CopyFrame(seq[ix].frame, 0);
+					fr = CopyFrame(epContext, seq[ix].frame, 0);
 					seq[ix].frame = fr;
 
 					for (int formant = 1; formant <= 5; formant++) {
@@ -714,14 +713,14 @@ static void SmoothSpect(EspeakProcessorContext* epContext)
 
 				if (diff > allowed) {
 					if (modified == false) {
-						frame2 = CopyFrame(frame, 0);
+						frame2 = CopyFrame(epContext, frame, 0);
 						modified = true;
 					}
 					frame2->ffreq[pk] = frame1->ffreq[pk] + allowed;
 					q[2] = (intptr_t)frame2;
 				} else if (diff < -allowed) {
 					if (modified == false) {
-						frame2 = CopyFrame(frame, 0);
+						frame2 = CopyFrame(epContext, frame, 0);
 						modified = true;
 					}
 					frame2->ffreq[pk] = frame1->ffreq[pk] - allowed;
@@ -781,14 +780,14 @@ static void SmoothSpect(EspeakProcessorContext* epContext)
 
 				if (diff > allowed) {
 					if (modified == false) {
-						frame2 = CopyFrame(frame, 0);
+						frame2 = CopyFrame(epContext, frame, 0);
 						modified = true;
 					}
 					frame2->ffreq[pk] = frame1->ffreq[pk] + allowed;
 					q[3] = (intptr_t)frame2;
 				} else if (diff < -allowed) {
 					if (modified == false) {
-						frame2 = CopyFrame(frame, 0);
+						frame2 = CopyFrame(epContext, frame, 0);
 						modified = true;
 					}
 					frame2->ffreq[pk] = frame1->ffreq[pk] - allowed;
@@ -830,7 +829,6 @@ int DoSpect2(EspeakProcessorContext* epContext, PHONEME_TAB *this_ph, int which,
 	int length_sum;
 	int length_min;
 	int total_len = 0;
-	static int wave_flag = 0;
 	int wcmd_spect = WCMD_SPECT;
 	int frame_lengths[N_SEQ_FRAMES];
 
@@ -872,12 +870,12 @@ int DoSpect2(EspeakProcessorContext* epContext, PHONEME_TAB *this_ph, int which,
 		wcmd_spect = WCMD_KLATT;
 
 	if (fmt_params->wav_addr == 0) {
-		if (wave_flag) {
+		if (epContext->spect_wave_flag) {
 			// cancel any wavefile that was playing previously
 			wcmd_spect = WCMD_SPECT2;
 			if (epContext->voice->klattv[0])
 				wcmd_spect = WCMD_KLATT2;
-			wave_flag = 0;
+			epContext->spect_wave_flag = 0;
 		} else {
 			wcmd_spect = WCMD_SPECT;
 			if (epContext->voice->klattv[0])
@@ -894,7 +892,7 @@ int DoSpect2(EspeakProcessorContext* epContext, PHONEME_TAB *this_ph, int which,
 			if (epContext->last_frame->frflags & FRFLAG_BREAK_LF) {
 				// but flag indicates keep HF peaks in last segment
 				frame_t *fr;
-				fr = CopyFrame(frame1, 1);
+				fr = CopyFrame(epContext, frame1, 1);
 				for (int ix = 3; ix < 8; ix++) {
 					if (ix < 7)
 						fr->ffreq[ix] = epContext->last_frame->ffreq[ix];
@@ -947,7 +945,7 @@ int DoSpect2(EspeakProcessorContext* epContext, PHONEME_TAB *this_ph, int which,
 				wavefile_amp = (fmt_params->wav_amp * 32)/100;
 
 			DoSample2(epContext, fmt_params->wav_addr, which+0x100, 0, fmt_params->fmt_control, 0, wavefile_amp);
-			wave_flag = 1;
+			epContext->spect_wave_flag = 1;
 			fmt_params->wav_addr = 0;
 		}
 
@@ -1094,11 +1092,49 @@ void DoEmbedded(EspeakProcessorContext* epContext, int *embix, int sourceix)
 	} while ((word & 0x80) == 0);
 }
 
-int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int *n_ph, bool resume)
+static void *GrowArray(void *array, int n_needed, int *n_allocated, size_t size)
+{
+	// make room for n_needed elements, doubling the allocation as it goes
+	void *grown;
+	int n_new = *n_allocated ? *n_allocated : 64;
+
+	if (n_needed <= *n_allocated)
+		return array;
+	while (n_new < n_needed)
+		n_new *= 2;
+	if ((grown = realloc(array, n_new * size)) == NULL)
+		return NULL;
+	*n_allocated = n_new;
+	return grown;
+}
+
+static int QueueDistance(int from, int to)
+{
+	int distance = to - from;
+	if (distance < 0)
+		distance += N_WCMDQ;
+	return distance;
+}
+
+static void MarkCommandStream(EspeakProcessorContext* epContext, int flags)
+{
+	// start a segment with the next command Generate() queues
+	struct espeak_ng_COMMAND_STREAM_ *stream = epContext->recording_stream;
+	COMMAND_STREAM_SEGMENT *segments;
+
+	if ((segments = GrowArray(stream->segments, stream->n_segments + 1, &stream->n_allocated_segments, sizeof(*segments))) == NULL) {
+		stream->status = ENOMEM;
+		return;
+	}
+	stream->segments = segments;
+	segments[stream->n_segments].start = stream->n_commands + QueueDistance(epContext->wcmdq_head, epContext->wcmdq_tail);
+	segments[stream->n_segments].flags = flags;
+	stream->n_segments++;
+}
+
+static int Generate2(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int *n_ph, bool resume)
 {
-	static int ix;
-	static int embedded_ix;
-	static int word_count;
+	GenerateState *g = &epContext->generate;
 	PHONEME_LIST *p;
 	bool released;
 	int stress;
@@ -1112,14 +1148,15 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 	int use_ipa = 0;
 	int vowelstart_prev;
 	char phoneme_name[16];
-	static int sourceix = 0;
+	espeak_TRACE_RECORD *record;
+	int ix;
 
 	PHONEME_DATA phdata;
 	PHONEME_DATA phdata_prev;
 	PHONEME_DATA phdata_next;
 	PHONEME_DATA phdata_tone;
 	FMT_PARAMS fmtp;
-	static WORD_PH_DATA worddata;
+	WORD_PH_DATA *worddata = &g->worddata;
 
 	if (epContext->option_phoneme_events & espeakINITIALIZE_PHONEME_IPA)
 		use_ipa = 1;
@@ -1130,9 +1167,9 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 #endif
 
 	if (resume == false) {
-		ix = 1;
-		embedded_ix = 0;
-		word_count = 0;
+		g->ix = 1;
+		g->embedded_ix = 0;
+		g->word_count = 0;
 		epContext->pitch_length = 0;
 		epContext->amp_length = 0;
 		epContext->last_frame = NULL;
@@ -1141,19 +1178,30 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 		epContext->syllable_end = epContext->wcmdq_tail;
 		epContext->syllable_centre = -1;
 		epContext->last_pitch_cmd = -1;
-		memset(&worddata, 0, sizeof(worddata));
+		memset(worddata, 0, sizeof(*worddata));
+		if (epContext->recording_stream != NULL)
+			MarkCommandStream(epContext, STREAM_CLAUSE);
 		DoPause(epContext, 0, 0); // isolate from the previous clause
 	}
 
-    srand (time(NULL) ^ (long long)epContext);
+	while ((g->ix < (*n_ph)) && (g->ix < N_PHONEME_LIST-2)) {
+		p = &phoneme_list[g->ix];
+
+		if (p->type == phPAUSE)
+			free_min = 10;
+		else if (p->type != phVOWEL)
+			free_min = 15; // we need less Q space for non-vowels, and we need to generate phonemes after a vowel so that the epContext->pitch_length is filled in
+		else
+			free_min = MIN_WCMDQ;
 
-	while ((ix < (*n_ph)) && (ix < N_PHONEME_LIST-2)) {
-		p = &phoneme_list[ix];
+		if (WcmdqFree(epContext) <= free_min)
+			return 1; // wait
 
-	    p->ph = p->ph + (epContext->bends.rotatePhonemes); // BEND TODO: actually rotate. what if we go over the end?
-	    if (ix > 0 && epContext->bends.stickChance * RAND_MAX > (float)rand())
+		// after the wait, which comes back to this phoneme, so it's only bent once
+	    p->ph = RotatePhoneme(epContext, p->ph, epContext->bends.rotatePhonemes);
+	    if (g->ix > 0 && espeak_bend_rand(epContext) < epContext->bends.stickChance)
 	    {
-	        p->ph = phoneme_list[ix-1].ph;
+	        p->ph = phoneme_list[g->ix-1].ph;
 	    }
 	    if(epContext->output_hooks && epContext->output_hooks->outputPhoSymbol)
 		{
@@ -1165,26 +1213,19 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 			DoPhonemeAlignment(epContext, strdup(buf),p->type);
 		}
 
-		if (p->type == phPAUSE)
-			free_min = 10;
-		else if (p->type != phVOWEL)
-			free_min = 15; // we need less Q space for non-vowels, and we need to generate phonemes after a vowel so that the epContext->pitch_length is filled in
-		else
-			free_min = MIN_WCMDQ;
-
-		if (WcmdqFree(epContext) <= free_min)
-			return 1; // wait
+		if (epContext->recording_stream != NULL)
+			MarkCommandStream(epContext, STREAM_PHONEME);
 
 		PHONEME_LIST *prev;
 		PHONEME_LIST *next;
 		PHONEME_LIST *next2;
 
-		prev = &phoneme_list[ix-1];
-		next = &phoneme_list[ix+1];
-		next2 = &phoneme_list[ix+2];
+		prev = &phoneme_list[g->ix-1];
+		next = &phoneme_list[g->ix+1];
+		next2 = &phoneme_list[g->ix+2];
 
 		if (p->synthflags & SFLAG_EMBEDDED)
-			DoEmbedded(epContext, &embedded_ix, p->sourceix);
+			DoEmbedded(epContext, &g->embedded_ix, p->sourceix);
 
 		if (p->newword) {
 			if (((p->type == phVOWEL) && (epContext->translator->langopts.param[LOPT_WORD_MERGE] & 1)) ||
@@ -1192,13 +1233,13 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 			} else
 				epContext->last_frame = NULL;
 
-			sourceix = (p->sourceix & 0x7ff) + epContext->clause_start_char;
+			g->sourceix = (p->sourceix & 0x7ff) + epContext->clause_start_char;
 
 			if (p->newword & PHLIST_START_OF_SENTENCE)
-				DoMarker(epContext, espeakEVENT_SENTENCE, sourceix, 0, epContext->count_sentences); // start of sentence
+				DoMarker(epContext, espeakEVENT_SENTENCE, g->sourceix, 0, epContext->count_sentences); // start of sentence
 
 			if (p->newword & PHLIST_START_OF_WORD)
-				DoMarker(epContext, espeakEVENT_WORD, sourceix, p->sourceix >> 11, epContext->clause_start_word + word_count++); // NOTE, this count doesn't include multiple-word pronunciations in *_list. eg (of a)
+				DoMarker(epContext, espeakEVENT_WORD, g->sourceix, p->sourceix >> 11, epContext->clause_start_word + g->word_count++); // NOTE, this count doesn't include multiple-word pronunciations in *_list. eg (of a)
 		}
 
 		EndAmplitude(epContext);
@@ -1214,7 +1255,7 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 				//WritePhMnemonic(phoneme_name, p->ph, p, use_ipa, NULL);
 				WritePhMnemonicWithStress(epContext, phoneme_name, p->ph, p, use_ipa, NULL);
 
-				DoPhonemeMarker(epContext, espeakEVENT_PHONEME, sourceix, 0, phoneme_name);
+				DoPhonemeMarker(epContext, espeakEVENT_PHONEME, g->sourceix, PhonemeClass(p->ph), phoneme_name);
 				done_phoneme_marker = true;
 			}
 		}
@@ -1241,7 +1282,7 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 			if (ph->phflags & phPREVOICE) {
 				// a period of voicing before the release
 				memset(&fmtp, 0, sizeof(fmtp));
-				InterpretPhoneme(epContext, NULL, 0x01, p, phoneme_list, &phdata, &worddata);
+				InterpretPhoneme(epContext, NULL, 0x01, p, phoneme_list, &phdata, worddata);
 				fmtp.fmt_addr = phdata.sound_addr[pd_FMT];
 				fmtp.fmt_amp = phdata.sound_param[pd_FMT];
 
@@ -1253,12 +1294,12 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 				DoSpect2(epContext, ph, 0, &fmtp, p, 0);
 			}
 
-			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, &worddata);
+			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, worddata);
 			phdata.pd_control |= pd_DONTLENGTHEN;
 			DoSample3(epContext, &phdata, 0, 0);
 			break;
 		case phFRICATIVE:
-			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, &worddata);
+			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, worddata);
 
 			if (p->synthflags & SFLAG_LENGTHEN)
 				DoSample3(epContext, &phdata, p->length, 0); // play it twice for [s:] etc.
@@ -1287,7 +1328,7 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 
 			if ((prev->type == phVOWEL) || (ph->phflags & phPREVOICE)) {
 				// a period of voicing before the release
-				InterpretPhoneme(epContext, NULL, 0x01, p, phoneme_list, &phdata, &worddata);
+				InterpretPhoneme(epContext, NULL, 0x01, p, phoneme_list, &phdata, worddata);
 				fmtp.fmt_addr = phdata.sound_addr[pd_FMT];
 				fmtp.fmt_amp = phdata.sound_param[pd_FMT];
 
@@ -1306,7 +1347,7 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 				StartSyllable(epContext);
 			} else
 				p->synthflags |= SFLAG_NEXT_PAUSE;
-			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, &worddata);
+			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, worddata);
 			fmtp.fmt_addr = phdata.sound_addr[pd_FMT];
 			fmtp.fmt_amp = phdata.sound_param[pd_FMT];
 			fmtp.wav_addr = phdata.sound_addr[pd_ADDWAV];
@@ -1338,7 +1379,7 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 				StartSyllable(epContext);
 			else
 				p->synthflags |= SFLAG_NEXT_PAUSE;
-			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, &worddata);
+			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, worddata);
 			memset(&fmtp, 0, sizeof(fmtp));
 			fmtp.std_length = phdata.pd_param[i_SET_LENGTH]*2;
 			fmtp.fmt_addr = phdata.sound_addr[pd_FMT];
@@ -1360,7 +1401,7 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 			if (prev->type == phNASAL)
 				epContext->last_frame = NULL;
 
-			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, &worddata);
+			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, worddata);
 			fmtp.std_length = phdata.pd_param[i_SET_LENGTH]*2;
 			fmtp.fmt_addr = phdata.sound_addr[pd_FMT];
 			fmtp.fmt_amp = phdata.sound_param[pd_FMT];
@@ -1393,7 +1434,7 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 
 			if (next->type == phVOWEL)
 				StartSyllable(epContext);
-			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, &worddata);
+			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, worddata);
 
 			if ((value = (phdata.pd_param[i_PAUSE_BEFORE] - p->prepause)) > 0)
 				DoPause(epContext, value, 1);
@@ -1410,7 +1451,7 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 
 			memset(&fmtp, 0, sizeof(fmtp));
 
-			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, &worddata);
+			InterpretPhoneme(epContext, NULL, 0, p, phoneme_list, &phdata, worddata);
 			fmtp.std_length = phdata.pd_param[i_SET_LENGTH] * 2;
 			vowelstart_prev = 0;
 
@@ -1482,7 +1523,7 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 				//WritePhMnemonic(phoneme_name, p->ph, p, use_ipa, NULL);
 				WritePhMnemonicWithStress(epContext, phoneme_name, p->ph, p, use_ipa, NULL);
 
-				DoPhonemeMarker(epContext, espeakEVENT_PHONEME, sourceix, 0, phoneme_name);
+				DoPhonemeMarker(epContext, espeakEVENT_PHONEME, g->sourceix, PhonemeClass(p->ph), phoneme_name);
 			}
 
 			fmtp.fmt_addr = phdata.sound_addr[pd_FMT];
@@ -1508,14 +1549,25 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 			break;
 		}
 
-	    if (epContext->bends.debugPrintEverything)
-	    {
-	        printf("p: %i %i %i %i %i %i %i %i %i %i %i %i %i %i %i %i %i | %u %u %u %u %u %u %u %u %u\n",
-                p->synthflags, p->phcode, p->stresslevel, p->sourceix, p->wordstress, p->tone_ph, p->length, p->env, p->type, p->prepause, p->amp, p->newword, p->pitch1, p->pitch2, p->std_length, p->phontab_addr, p->sound_param,
-                p->ph->mnemonic, p->ph->phflags, p->ph->program, p->ph->code, p->ph->type, p->ph->start_type, p->ph->end_type, p->ph->std_length, p->ph->length_mod);
-	    }
+		if ((record = StartTraceRecord(epContext, espeakTRACE_PHONEME, NULL)) != NULL) {
+			for (ix = 0; ix < 4; ix++)
+				record->phoneme[ix] = (p->ph->mnemonic >> (ix * 8)) & 0xff;
+			record->u.phoneme.code = p->phcode;
+			record->u.phoneme.type = p->type;
+			record->u.phoneme.stresslevel = p->stresslevel;
+			record->u.phoneme.length = p->length;
+			record->u.phoneme.pitch1 = p->pitch1;
+			record->u.phoneme.pitch2 = p->pitch2;
+			record->u.phoneme.amp = p->amp;
+			record->u.phoneme.newword = p->newword;
+			record->u.phoneme.synthflags = p->synthflags;
+			record->u.phoneme.std_length = p->std_length;
+			record->u.phoneme.sourceix = p->sourceix;
+			record->u.phoneme.phflags = p->ph->phflags;
+			FinishTraceRecord(epContext);
+		}
 
-		ix++;
+		g->ix++;
 	}
 	EndPitch(epContext, 1);
 	if (*n_ph > 0) {
@@ -1526,6 +1578,39 @@ int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int
 	return 0; // finished the phoneme list
 }
 
+// Call Generate2, counting its time as espeakSTAGE_GENERATE.
+int Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int *n_ph, bool resume)
+{
+	int stage = EnterStage(epContext, espeakSTAGE_GENERATE);
+	int result = Generate2(epContext, phoneme_list, n_ph, resume);
+	EnterStage(epContext, stage);
+	return result;
+}
+
+// Generate() looks up to two phonemes past the end of the list
+#define N_CACHED_PHONEMES(n) (((n) + 2 < N_PHONEME_LIST + 1) ? (n) + 2 : N_PHONEME_LIST + 1)
+
+static char *LoadCachedClause(EspeakProcessorContext* epContext, const PHONEME_CACHE_CLAUSE *clause)
+{
+	// copy a pre-translated clause into the phoneme list, pointing its phonemes back
+	// into this context's tables, and return its voice change as TranslateClause() would
+	int ix;
+
+	memcpy(epContext->phoneme_list, clause->phoneme_list, N_CACHED_PHONEMES(clause->n_phoneme_list) * sizeof(PHONEME_LIST));
+	for (ix = 0; ix < N_CACHED_PHONEMES(clause->n_phoneme_list); ix++) {
+		if (clause->ph_offset[ix] < 0)
+			epContext->phoneme_list[ix].ph = NULL;
+		else
+			epContext->phoneme_list[ix].ph = (PHONEME_TAB *)(epContext->phoneme_tab_data + clause->ph_offset[ix]);
+	}
+	epContext->n_phoneme_list = clause->n_phoneme_list;
+	memcpy(epContext->embedded_list, clause->embedded_list, sizeof(epContext->embedded_list));
+
+	if (clause->voice_change[0] == 0)
+		return NULL;
+	return (char *)clause->voice_change;
+}
+
 int SpeakNextClause(EspeakProcessorContext* epContext, int control)
 {
 	// Speak text from memory (text_in)
@@ -1538,6 +1623,7 @@ int SpeakNextClause(EspeakProcessorContext* epContext, int control)
 
 	int clause_tone;
 	char *voice_change;
+	int stage;
 
 	if (control == 2) {
 		// stop speaking
@@ -1547,32 +1633,52 @@ int SpeakNextClause(EspeakProcessorContext* epContext, int control)
 		return 0;
 	}
 
-	if (text_decoder_eof(epContext->p_decoder)) {
-		epContext->skipping_text = false;
-		return 0;
+	if (epContext->command_stream != NULL) {
+		// replaying what Generate() queued for these clauses, ReplayCommandStream() takes its place
+		if (epContext->replay.segment >= epContext->command_stream->n_segments)
+			return 0;
+		epContext->replay.new_clause = true;
+		ReplayCommandStream(epContext);
+		return 1;
 	}
 
-	SelectPhonemeTable(epContext, epContext->voice->phoneme_tab_ix);
+	if (epContext->phoneme_cache != NULL) {
+		// replaying clauses that TranslatePhonemeCache() has already been through
+		if (epContext->phoneme_cache_ix >= epContext->phoneme_cache->n_clauses)
+			return 0;
 
-	// read the next clause from the input text file, translate it, and generate
-	// entries in the wavegen command queue
-	TranslateClause(epContext, epContext->translator, &clause_tone, &voice_change);
+		SelectPhonemeTable(epContext, epContext->voice->phoneme_tab_ix);
+		voice_change = LoadCachedClause(epContext, &epContext->phoneme_cache->clauses[epContext->phoneme_cache_ix++]);
+	} else {
+		if (text_decoder_eof(epContext->p_decoder)) {
+			epContext->skipping_text = false;
+			return 0;
+		}
 
-	CalcPitches(epContext, epContext->translator, clause_tone);
-	CalcLengths(epContext, epContext->translator);
+		SelectPhonemeTable(epContext, epContext->voice->phoneme_tab_ix);
 
-	if ((epContext->option_phonemes & 0xf) || (phoneme_callback != NULL)) {
-		const char *phon_out;
-		phon_out = GetTranslatedPhonemeString(epContext, epContext->option_phonemes);
-		if (epContext->option_phonemes & 0xf)
-			fprintf(epContext->f_trans, "%s\n", phon_out);
-		if (phoneme_callback != NULL)
-			phoneme_callback(phon_out);
-	}
+		// read the next clause from the input text file, translate it, and generate
+		// entries in the wavegen command queue
+		stage = EnterStage(epContext, espeakSTAGE_TRANSLATE);
+		TranslateClause(epContext, epContext->translator, &clause_tone, &voice_change);
 
-	if (epContext->skipping_text) {
-		epContext->n_phoneme_list = 0;
-		return 1;
+		CalcPitches(epContext, epContext->translator, clause_tone);
+		CalcLengths(epContext, epContext->translator);
+		EnterStage(epContext, stage);
+
+		if ((epContext->option_phonemes & 0xf) || (phoneme_callback != NULL)) {
+			const char *phon_out;
+			phon_out = GetTranslatedPhonemeString(epContext, epContext->option_phonemes);
+			if (epContext->option_phonemes & 0xf)
+				fprintf(epContext->f_trans, "%s\n", phon_out);
+			if (phoneme_callback != NULL)
+				phoneme_callback(phon_out);
+		}
+
+		if (epContext->skipping_text) {
+			epContext->n_phoneme_list = 0;
+			return 1;
+		}
 	}
 
 	Generate(epContext, epContext->phoneme_list, &epContext->n_phoneme_list, 0);
@@ -1592,6 +1698,365 @@ int SpeakNextClause(EspeakProcessorContext* epContext, int control)
 	return 1;
 }
 
+espeak_ng_STATUS TranslatePhonemeCache(EspeakProcessorContext* epContext, espeak_ng_PHONEME_CACHE *cache)
+{
+	// Translate all the text in p_decoder, clause by clause, as far as SpeakNextClause()
+	// goes before it calls Generate(), and keep each phoneme list.
+	int clause_tone;
+	char *voice_change;
+	int ix;
+	int n_cached;
+	int n_allocated = 0;
+	PHONEME_CACHE_CLAUSE *clause;
+	espeak_ng_PHONEME_CACHE result;
+
+	if ((result = (espeak_ng_PHONEME_CACHE)calloc(1, sizeof(*result))) == NULL)
+		return ENOMEM;
+
+	while (!text_decoder_eof(epContext->p_decoder)) {
+		SelectPhonemeTable(epContext, epContext->voice->phoneme_tab_ix);
+		TranslateClause(epContext, epContext->translator, &clause_tone, &voice_change);
+		CalcPitches(epContext, epContext->translator, clause_tone);
+		CalcLengths(epContext, epContext->translator);
+
+		if (result->n_clauses == n_allocated) {
+			PHONEME_CACHE_CLAUSE *clauses;
+			n_allocated = n_allocated ? n_allocated * 2 : 4;
+			if ((clauses = (PHONEME_CACHE_CLAUSE *)realloc(result->clauses, n_allocated * sizeof(PHONEME_CACHE_CLAUSE))) == NULL) {
+				FreePhonemeCache(result);
+				return ENOMEM;
+			}
+			result->clauses = clauses;
+		}
+
+		clause = &result->clauses[result->n_clauses];
+		memset(clause, 0, sizeof(*clause));
+		n_cached = N_CACHED_PHONEMES(epContext->n_phoneme_list);
+		clause->phoneme_list = (PHONEME_LIST *)malloc(n_cached * sizeof(PHONEME_LIST));
+		clause->ph_offset = (int *)malloc(n_cached * sizeof(int));
+		if (clause->phoneme_list == NULL || clause->ph_offset == NULL) {
+			free(clause->phoneme_list);
+			free(clause->ph_offset);
+			FreePhonemeCache(result);
+			return ENOMEM;
+		}
+		result->n_clauses++;
+
+		memcpy(clause->phoneme_list, epContext->phoneme_list, n_cached * sizeof(PHONEME_LIST));
+		for (ix = 0; ix < n_cached; ix++) {
+			const PHONEME_TAB *ph = epContext->phoneme_list[ix].ph;
+			clause->ph_offset[ix] = (ph == NULL) ? -1 : (int)((const unsigned char *)ph - epContext->phoneme_tab_data);
+		}
+		clause->n_phoneme_list = epContext->n_phoneme_list;
+		memcpy(clause->embedded_list, epContext->embedded_list, sizeof(clause->embedded_list));
+
+		if (voice_change != NULL) {
+			// the rest of the text is translated in the new voice, replay switches to it at the same point
+			strncpy0(clause->voice_change, voice_change, sizeof(clause->voice_change));
+			LoadVoiceVariant(epContext, voice_change, 0);
+		}
+		epContext->new_voice = NULL;
+	}
+
+	*cache = result;
+	return ENS_OK;
+}
+
+void FreePhonemeCache(espeak_ng_PHONEME_CACHE cache)
+{
+	int ix;
+
+	if (cache == NULL)
+		return;
+	for (ix = 0; ix < cache->n_clauses; ix++) {
+		free(cache->clauses[ix].phoneme_list);
+		free(cache->clauses[ix].ph_offset);
+	}
+	free(cache->clauses);
+	free(cache);
+}
+
+static void RecordCommand(EspeakProcessorContext* epContext, const intptr_t *q)
+{
+	// copy a command out of the queue, with what its pointers point to
+	struct espeak_ng_COMMAND_STREAM_ *stream = epContext->recording_stream;
+	RECORDED_WCMD *cmd;
+	RECORDED_WCMD *commands;
+	frame_t *frames;
+	voice_t *voices;
+	int ix;
+	int type = q[0] & 0xff;
+
+	if ((commands = GrowArray(stream->commands, stream->n_commands + 1, &stream->n_allocated_commands, sizeof(*commands))) == NULL) {
+		stream->status = ENOMEM;
+		if (type == WCMD_VOICE)
+			free((voice_t *)q[2]);
+		else if (type == WCMD_PHONEME_ALIGNMENT)
+			free((char *)q[1]);
+		return;
+	}
+	stream->commands = commands;
+	cmd = &commands[stream->n_commands++];
+	memcpy(cmd->q, q, sizeof(cmd->q));
+	cmd->fixup = STREAM_FIXUP_NONE;
+
+	switch (type)
+	{
+	case WCMD_SPECT:
+	case WCMD_SPECT2:
+	case WCMD_KLATT:
+	case WCMD_KLATT2:
+		// the frames may be in the frame pool, which Generate() reuses
+		if ((frames = GrowArray(stream->frames, stream->n_frames + 2, &stream->n_allocated_frames, sizeof(*frames))) == NULL) {
+			stream->status = ENOMEM;
+			stream->n_commands--;
+			return;
+		}
+		stream->frames = frames;
+		for (ix = 2; ix < 4; ix++) {
+			memcpy(&frames[stream->n_frames], (const frame_t *)q[ix], sizeof(frame_t));
+			cmd->q[ix] = stream->n_frames++;
+		}
+		cmd->fixup = STREAM_FIXUP_FRAMES;
+		break;
+	case WCMD_WAVE:
+	case WCMD_WAVE2:
+	case WCMD_PITCH:
+	case WCMD_AMPLITUDE:
+		// samples and envelopes from phondata, the built in envelopes are the same in every context
+		if ((q[2] >= (intptr_t)epContext->phondata_ptr) && (q[2] < (intptr_t)epContext->phondata_ptr + epContext->phondata_size)) {
+			cmd->q[2] = q[2] - (intptr_t)epContext->phondata_ptr;
+			cmd->fixup = STREAM_FIXUP_PHONDATA;
+		}
+		break;
+	case WCMD_VOICE:
+		if ((voices = GrowArray(stream->voices, stream->n_voices + 1, &stream->n_allocated_voices, sizeof(*voices))) == NULL) {
+			stream->status = ENOMEM;
+			stream->n_commands--;
+			free((voice_t *)q[2]);
+			return;
+		}
+		stream->voices = voices;
+		memcpy(&voices[stream->n_voices], (const voice_t *)q[2], sizeof(voice_t));
+		free((voice_t *)q[2]);
+		cmd->q[2] = stream->n_voices++;
+		cmd->fixup = STREAM_FIXUP_VOICE;
+		break;
+	case WCMD_PHONEME_ALIGNMENT:
+		// the stream keeps the string wavegen would have freed
+		cmd->fixup = STREAM_FIXUP_STRING;
+		break;
+	}
+}
+
+static void RecordCommands(EspeakProcessorContext* epContext, bool keep_unfinished)
+{
+	// Move commands from the queue into the recording, the way wavegen would take them.
+	// Generate() can still go back and change the commands from the start of the current
+	// syllable, and its last pitch, amplitude and spectrum commands, so unless the clause
+	// is finished those stay queued until it has moved on.
+	int n = WcmdqUsed(epContext);
+	int unfinished[4];
+	int ix;
+
+	if (keep_unfinished) {
+		unfinished[0] = epContext->syllable_start;
+		unfinished[1] = epContext->last_pitch_cmd;
+		unfinished[2] = epContext->last_amp_cmd;
+		unfinished[3] = epContext->last_wcmdq;
+		for (ix = 0; ix < 4; ix++) {
+			if ((unfinished[ix] >= 0) && (QueueDistance(epContext->wcmdq_head, unfinished[ix]) < n))
+				n = QueueDistance(epContext->wcmdq_head, unfinished[ix]);
+		}
+		if (n == 0)
+			n = WcmdqUsed(epContext); // Generate() is waiting on a full queue, take it all as wavegen would
+	}
+
+	while (n-- > 0) {
+		RecordCommand(epContext, epContext->wcmdq[epContext->wcmdq_head]);
+		if (++epContext->wcmdq_head >= N_WCMDQ)
+			epContext->wcmdq_head = 0;
+	}
+}
+
+espeak_ng_STATUS RecordCommandStream(EspeakProcessorContext* epContext, espeak_ng_COMMAND_STREAM *stream)
+{
+	// Run the clauses in epContext->phoneme_cache through Generate() the way Synthesize()
+	// does, with the recording standing in for wavegen.
+	struct espeak_ng_COMMAND_STREAM_ *result;
+	espeak_ng_STATUS status;
+	int rotate_phonemes = epContext->bends.rotatePhonemes;
+	float stick_chance = epContext->bends.stickChance;
+
+	if ((result = (struct espeak_ng_COMMAND_STREAM_ *)calloc(1, sizeof(*result))) == NULL)
+		return ENOMEM;
+	result->status = ENS_OK;
+	result->samplerate = epContext->samplerate;
+	result->klatt = epContext->voice->klattv[0] != 0;
+
+	epContext->bends.rotatePhonemes = 0;
+	epContext->bends.stickChance = 0;
+	epContext->recording_stream = result;
+
+	// anything already queued, such as the voice from espeak_SetVoiceByName(), comes before
+	// the first segment and isn't replayed
+
+	if (SpeakNextClause(epContext, 0) != 0) {
+		for (;;) {
+			if (Generate(epContext, epContext->phoneme_list, &epContext->n_phoneme_list, 1) != 0)
+				RecordCommands(epContext, true);
+			else {
+				RecordCommands(epContext, false);
+				if (SpeakNextClause(epContext, 1) == 0)
+					break;
+			}
+		}
+	}
+
+	epContext->recording_stream = NULL;
+	epContext->bends.rotatePhonemes = rotate_phonemes;
+	epContext->bends.stickChance = stick_chance;
+
+	if ((status = result->status) != ENS_OK) {
+		FreeCommandStream(result);
+		return status;
+	}
+	*stream = result;
+	return ENS_OK;
+}
+
+static bool IsSoundCommand(intptr_t type)
+{
+	switch (type & 0xff)
+	{
+	case WCMD_KLATT:
+	case WCMD_KLATT2:
+	case WCMD_SPECT:
+	case WCMD_SPECT2:
+	case WCMD_PAUSE:
+	case WCMD_WAVE:
+	case WCMD_WAVE2:
+	case WCMD_AMPLITUDE:
+	case WCMD_PITCH:
+	case WCMD_MBROLA_DATA:
+	case WCMD_FMT_AMPLITUDE:
+		return true;
+	}
+	return false;
+}
+
+static void QueueRecordedCommand(EspeakProcessorContext* epContext, const RECORDED_WCMD *cmd)
+{
+	// put a recorded command back in the queue, with its pointers into this context and the stream
+	const struct espeak_ng_COMMAND_STREAM_ *stream = epContext->command_stream;
+	intptr_t *q = epContext->wcmdq[epContext->wcmdq_tail];
+	voice_t *v;
+
+	memcpy(q, cmd->q, sizeof(cmd->q));
+	switch (cmd->fixup)
+	{
+	case STREAM_FIXUP_FRAMES:
+		q[2] = (intptr_t)&stream->frames[cmd->q[2]];
+		q[3] = (intptr_t)&stream->frames[cmd->q[3]];
+		break;
+	case STREAM_FIXUP_PHONDATA:
+		q[2] = (intptr_t)&epContext->phondata_ptr[cmd->q[2]];
+		break;
+	case STREAM_FIXUP_VOICE:
+		if ((v = (voice_t *)malloc(sizeof(voice_t))) == NULL)
+			return;
+		memcpy(v, &stream->voices[cmd->q[2]], sizeof(voice_t));
+		q[2] = (intptr_t)v;
+		break;
+	case STREAM_FIXUP_STRING:
+		if ((q[1] = (intptr_t)strdup((const char *)cmd->q[1])) == 0)
+			return;
+		break;
+	}
+	WcmdqInc(epContext);
+}
+
+static int ReplayCommandStream2(EspeakProcessorContext* epContext)
+{
+	// Queue as much of the current clause of epContext->command_stream as there is room for.
+	// Returns 0 once the whole clause is queued, as Generate() does.
+	const struct espeak_ng_COMMAND_STREAM_ *stream = epContext->command_stream;
+	CommandStreamReplay *replay = &epContext->replay;
+	const COMMAND_STREAM_SEGMENT *segment;
+	const RECORDED_WCMD *cmd;
+
+	for (;;) {
+		while (replay->ix < replay->end) {
+			if (WcmdqFree(epContext) <= 1)
+				return 1; // wait
+			cmd = &stream->commands[replay->ix++];
+			if ((replay->filter == REPLAY_EVENTS) && IsSoundCommand(cmd->q[0]))
+				continue;
+			if ((replay->filter == REPLAY_SOUND) && !IsSoundCommand(cmd->q[0]))
+				continue;
+			QueueRecordedCommand(epContext, cmd);
+		}
+
+		if (replay->stuck) {
+			// a stuck phoneme's events are done, now the sound of the phoneme it stuck to
+			replay->stuck = false;
+			replay->filter = REPLAY_SOUND;
+			replay->ix = replay->sound_start;
+			replay->end = replay->sound_end;
+			continue;
+		}
+
+		if (replay->segment >= stream->n_segments)
+			return 0;
+		segment = &stream->segments[replay->segment];
+		if (segment->flags & STREAM_CLAUSE) {
+			if (!replay->new_clause)
+				return 0; // the rest is for the next SpeakNextClause()
+			replay->new_clause = false;
+		}
+
+		replay->ix = segment->start;
+		replay->end = (replay->segment + 1 < stream->n_segments) ? segment[1].start : stream->n_commands;
+		replay->filter = REPLAY_ALL;
+		if ((segment->flags & STREAM_PHONEME) && (replay->segment > 0) && (segment[-1].flags & STREAM_PHONEME) &&
+		    (espeak_bend_rand(epContext) < epContext->bends.stickChance)) {
+			// the stick bend from Generate(), at the level of whole recorded phonemes
+			replay->filter = REPLAY_EVENTS;
+			replay->stuck = true;
+		} else {
+			replay->sound_start = replay->ix;
+			replay->sound_end = replay->end;
+		}
+		replay->segment++;
+	}
+}
+
+// Call ReplayCommandStream2, which stands in for Generate(), counting its time as espeakSTAGE_GENERATE.
+int ReplayCommandStream(EspeakProcessorContext* epContext)
+{
+	int stage = EnterStage(epContext, espeakSTAGE_GENERATE);
+	int result = ReplayCommandStream2(epContext);
+	EnterStage(epContext, stage);
+	return result;
+}
+
+void FreeCommandStream(espeak_ng_COMMAND_STREAM stream)
+{
+	int ix;
+
+	if (stream == NULL)
+		return;
+	for (ix = 0; ix < stream->n_commands; ix++) {
+		if (stream->commands[ix].fixup == STREAM_FIXUP_STRING)
+			free((char *)stream->commands[ix].q[1]);
+	}
+	free(stream->commands);
+	free(stream->frames);
+	free(stream->voices);
+	free(stream->segments);
+	free(stream);
+}
+
 #pragma GCC visibility push(default)
 ESPEAK_API void espeak_SetPhonemeCallback(EspeakProcessorContext* epContext, int (*PhonemeCallback)(const char *))
 {
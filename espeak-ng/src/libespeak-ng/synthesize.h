@@ -34,7 +34,6 @@ extern "C"
 #define espeakINITIALIZE_PHONEME_IPA 0x0002 // move this to speak_lib.h, after eSpeak version 1.46.02
 
 
-#define N_SEQ_FRAMES  25 // max frames in a spectrum sequence (real max is ablut 8)
 #define STEPSIZE      64 // 2.9mS at 22 kHz sample rate
 
 // flags set for frames within a spectrum sequence
@@ -118,12 +117,6 @@ typedef struct {
 	frame_t frame[N_SEQ_FRAMES]; // max. frames in a spectrum sequence
 } SPECT_SEQK; // sequence of klatt formants frames
 
-typedef struct {
-	short length;
-	short frflags;
-	frame_t *frame;
-} frameref_t;
-
 
 #define PHLIST_START_OF_WORD     1
 #define PHLIST_END_OF_CLAUSE     2
@@ -173,10 +166,6 @@ typedef struct {
 	int std_length;
 } FMT_PARAMS;
 
-typedef struct {
-	PHONEME_LIST prev_vowel;
-} WORD_PH_DATA;
-
 // instructions
 
 #define INSTN_RETURN         0x0001
@@ -274,12 +263,76 @@ extern const unsigned char env_fall[128];
 
 #define MIN_WCMDQ  25   // need this many free entries before adding new phoneme
 
+// one clause of an espeak_ng_PHONEME_CACHE, as SpeakNextClause() passes it to Generate()
+typedef struct {
+	int n_phoneme_list;
+	PHONEME_LIST *phoneme_list; // ph is only valid in the context it was translated in, see ph_offset
+	int *ph_offset;             // offset of each ph into phoneme_tab_data, or -1 for none
+	unsigned int embedded_list[N_EMBEDDED_LIST];
+	char voice_change[40];      // empty unless the clause ended with a change of voice
+} PHONEME_CACHE_CLAUSE;
+
+struct espeak_ng_PHONEME_CACHE_ {
+	int n_clauses;
+	PHONEME_CACHE_CLAUSE *clauses;
+};
+
+// how a recorded command's pointers were stored, so they can be put back for wavegen
+#define STREAM_FIXUP_NONE     0
+#define STREAM_FIXUP_FRAMES   1 // q[2] and q[3] index frames
+#define STREAM_FIXUP_PHONDATA 2 // q[2] is an offset into phondata
+#define STREAM_FIXUP_VOICE    3 // q[2] indexes voices, wavegen frees the copy it is given
+#define STREAM_FIXUP_STRING   4 // q[1] is a string, wavegen frees the copy it is given
+
+// a segment starts each clause (the pause from Generate) and each phoneme
+#define STREAM_CLAUSE  1
+#define STREAM_PHONEME 2
+
+typedef struct {
+	int start;  // first command
+	int flags;
+} COMMAND_STREAM_SEGMENT;
+
+typedef struct {
+	intptr_t q[4];
+	int fixup;
+} RECORDED_WCMD;
+
+// the wavegen commands Generate() queued for an espeak_ng_PHONEME_CACHE, once it had finished changing them
+struct espeak_ng_COMMAND_STREAM_ {
+	int n_commands;
+	RECORDED_WCMD *commands;
+	int n_frames;
+	frame_t *frames;
+	int n_voices;
+	voice_t *voices;
+	int n_segments;
+	COMMAND_STREAM_SEGMENT *segments;
+	int samplerate;  // frame lengths are in samples
+	bool klatt;      // spectrum commands are WCMD_KLATT rather than WCMD_SPECT
+
+	// only used while recording
+	int n_allocated_commands;
+	int n_allocated_frames;
+	int n_allocated_voices;
+	int n_allocated_segments;
+	espeak_ng_STATUS status;
+};
+
+// where out_ptr is in the synthesis, in samples from its start, the way events count them.
+// NULL is for between WavegenFill() calls, when everything in the output buffer has been counted
+long SynthesisSample(EspeakProcessorContext* epContext, unsigned char *out_ptr);
 void MarkerEvent(EspeakProcessorContext* epContext, int type, unsigned int char_position, int value, int value2, unsigned char *out_ptr);
 
 
 void SynthesizeInit(EspeakProcessorContext* epContext);
 int  Generate(EspeakProcessorContext* epContext, PHONEME_LIST *phoneme_list, int *n_ph, bool resume);
 int  SpeakNextClause(EspeakProcessorContext* epContext, int control);
+espeak_ng_STATUS TranslatePhonemeCache(EspeakProcessorContext* epContext, espeak_ng_PHONEME_CACHE *cache);
+void FreePhonemeCache(espeak_ng_PHONEME_CACHE cache);
+espeak_ng_STATUS RecordCommandStream(EspeakProcessorContext* epContext, espeak_ng_COMMAND_STREAM *stream);
+int  ReplayCommandStream(EspeakProcessorContext* epContext);
+void FreeCommandStream(espeak_ng_COMMAND_STREAM stream);
 void SetSpeed(EspeakProcessorContext* epContext, int control);
 void SetEmbedded(EspeakProcessorContext* epContext, int control, int value);
 int FormantTransition2(EspeakProcessorContext* epContext, frameref_t *seq, int *n_frames, unsigned int data1, unsigned int data2, PHONEME_TAB *other_ph, int which);
@@ -0,0 +1,197 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see: <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#elif !defined(__aarch64__)
+#include <time.h>
+#endif
+
+#include <espeak-ng/espeak_ng.h>
+#include <espeak-ng/speak_lib.h>
+
+#include "trace.h"
+#include "synthesize.h"           // for SynthesisSample
+#include "voice.h"                // for voice_t
+
+// the ring's two positions are each moved on by one thread and looked at by the other, so the
+// records have to be in place before the writer's position says so, and read before the reader's does
+#if defined(_MSC_VER)
+static uint32_t LoadPosition(uint32_t *position)
+{
+	return (uint32_t)_InterlockedOr((volatile long *)position, 0);
+}
+
+static void StorePosition(uint32_t *position, uint32_t value)
+{
+	_InterlockedExchange((volatile long *)position, (long)value);
+}
+#else
+static uint32_t LoadPosition(uint32_t *position)
+{
+	return __atomic_load_n(position, __ATOMIC_ACQUIRE);
+}
+
+static void StorePosition(uint32_t *position, uint32_t value)
+{
+	__atomic_store_n(position, value, __ATOMIC_RELEASE);
+}
+#endif
+
+espeak_TRACE_RECORD *StartTraceRecord(EspeakProcessorContext *epContext, int type, unsigned char *out_ptr)
+{
+	espeak_TRACE *trace = &epContext->trace;
+	espeak_TRACE_RECORD *record;
+
+	if (!epContext->tracing)
+		return NULL;
+
+	// the positions only ever count up, so the difference is right even once they wrap
+	if (trace->written - LoadPosition(&trace->read) >= espeakTRACE_RECORDS) {
+		StorePosition(&trace->dropped, trace->dropped + 1);
+		return NULL;
+	}
+
+	record = &trace->records[trace->written % espeakTRACE_RECORDS];
+	memset(record, 0, sizeof(*record));
+	record->type = type;
+	record->sample = (int32_t)SynthesisSample(epContext, out_ptr);
+	if (type == espeakTRACE_FRAME)
+		memcpy(record->phoneme, epContext->trace_phoneme, sizeof(record->phoneme));
+	return record;
+}
+
+void FinishTraceRecord(EspeakProcessorContext *epContext)
+{
+	StorePosition(&epContext->trace.written, epContext->trace.written + 1);
+}
+
+void TraceStart(EspeakProcessorContext *epContext)
+{
+	espeak_TRACE_RECORD *record;
+
+	memset(epContext->trace_phoneme, 0, sizeof(epContext->trace_phoneme));
+	if ((record = StartTraceRecord(epContext, espeakTRACE_START, NULL)) != NULL) {
+		record->u.start.samplerate = epContext->samplerate;
+		record->u.start.engine = (epContext->voice != NULL) ? epContext->voice->klattv[0] : 0;
+		FinishTraceRecord(epContext);
+	}
+}
+
+// the stage totals are only added to by the synthesizing thread, so they just need to be read whole
+#if defined(_MSC_VER)
+static uint64_t LoadCycles(uint64_t *cycles)
+{
+	return (uint64_t)_InterlockedCompareExchange64((volatile __int64 *)cycles, 0, 0);
+}
+
+static void StoreCycles(uint64_t *cycles, uint64_t value)
+{
+	__int64 old = (__int64)*cycles;
+	__int64 seen;
+	while ((seen = _InterlockedCompareExchange64((volatile __int64 *)cycles, (__int64)value, old)) != old)
+		old = seen;
+}
+#else
+static uint64_t LoadCycles(uint64_t *cycles)
+{
+	return __atomic_load_n(cycles, __ATOMIC_RELAXED);
+}
+
+static void StoreCycles(uint64_t *cycles, uint64_t value)
+{
+	__atomic_store_n(cycles, value, __ATOMIC_RELAXED);
+}
+#endif
+
+int EnterStage(EspeakProcessorContext *epContext, int stage)
+{
+	int previous = epContext->stage;
+	uint64_t now;
+
+	if (stage == previous)
+		return previous;
+
+	now = espeak_ng_ReadCycleCounter();
+	if (previous != espeakSTAGE_NONE)
+		StoreCycles(&epContext->stage_cycles[previous], epContext->stage_cycles[previous] + (now - epContext->stage_start));
+	epContext->stage = stage;
+	epContext->stage_start = now;
+	return previous;
+}
+
+#pragma GCC visibility push(default)
+
+ESPEAK_NG_API espeak_ng_STATUS espeak_ng_SetTrace(EspeakProcessorContext *epContext, int enable)
+{
+	epContext->tracing = enable != 0;
+	return ENS_OK;
+}
+
+ESPEAK_NG_API int espeak_ng_ReadTrace(EspeakProcessorContext *epContext, espeak_TRACE_RECORD *records, int max_records)
+{
+	espeak_TRACE *trace = &epContext->trace;
+	uint32_t read = trace->read;
+	uint32_t available = LoadPosition(&trace->written) - read;
+	int n;
+
+	if (max_records <= 0)
+		return 0;
+	n = (available < (uint32_t)max_records) ? (int)available : max_records;
+	for (int ix = 0; ix < n; ix++)
+		records[ix] = trace->records[(read + ix) % espeakTRACE_RECORDS];
+	StorePosition(&trace->read, read + n);
+	return n;
+}
+
+ESPEAK_NG_API unsigned int espeak_ng_GetTraceDropped(EspeakProcessorContext *epContext)
+{
+	return LoadPosition(&epContext->trace.dropped);
+}
+
+ESPEAK_NG_API uint64_t espeak_ng_ReadCycleCounter(void)
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+	return __rdtsc();
+#elif defined(_MSC_VER) && defined(_M_ARM64)
+	return (uint64_t)_ReadStatusReg(ARM64_CNTVCT);
+#elif defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#elif defined(__aarch64__)
+	uint64_t count;
+	__asm__ __volatile__("mrs %0, cntvct_el0" : "=r"(count));
+	return count;
+#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+#endif
+}
+
+ESPEAK_NG_API void espeak_ng_GetStageCycles(EspeakProcessorContext *epContext, uint64_t *cycles)
+{
+	for (int ix = 0; ix < espeakSTAGE_COUNT; ix++)
+		cycles[ix] = LoadCycles(&epContext->stage_cycles[ix]);
+	cycles[espeakSTAGE_NONE] = 0;
+}
+
+#pragma GCC visibility pop
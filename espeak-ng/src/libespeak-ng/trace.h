@@ -0,0 +1,42 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, see: <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ESPEAK_NG_TRACE_H
+#define ESPEAK_NG_TRACE_H
+
+#include <espeak-ng/speak_lib.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+// the next record to fill in, with its type, sample and phoneme set, or NULL when tracing is off
+// or the ring is full. out_ptr is where wavegen is up to, as for SynthesisSample(). FinishTraceRecord()
+// hands the record to the reader
+espeak_TRACE_RECORD *StartTraceRecord(EspeakProcessorContext *epContext, int type, unsigned char *out_ptr);
+void FinishTraceRecord(EspeakProcessorContext *epContext);
+
+void TraceStart(EspeakProcessorContext *epContext);
+
+// adds the time since the last switch to the stage the synthesis was in, unless that was
+// espeakSTAGE_NONE, and moves it to stage. Returns the stage it was in, to go back to after
+int EnterStage(EspeakProcessorContext *epContext, int stage);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -33,6 +33,7 @@
 #include <windows.h>
 #else
 #include <dirent.h>
+#include <pthread.h>
 #endif
 
 #include <espeak-ng/espeak_ng.h>
@@ -1348,6 +1349,33 @@ ESPEAK_NG_API espeak_ng_STATUS espeak_ng_SetVoiceByProperties(EspeakProcessorCon
 	return ENS_OK;
 }
 
+ESPEAK_NG_API espeak_ng_STATUS espeak_ng_SetSynthesisEngine(EspeakProcessorContext* epContext, int engine)
+{
+	// engine is numbered like the voice file "klatt" attribute: 0 is the harmonic wavegen,
+	// 1 to 5 are the klatt glottal sources and 6 is speechPlayer.
+	// Call after selecting a voice, it replaces whatever the voice and its variant asked for.
+	if ((engine < 0) || (engine > 6) || (epContext->voice == NULL))
+		return EINVAL;
+#if !USE_KLATT
+	if (engine != 0)
+		return ENS_NOT_SUPPORTED;
+#endif
+#if !USE_SPEECHPLAYER
+	if (engine == 6)
+		return ENS_NOT_SUPPORTED;
+#endif
+
+	if (epContext->voice->klattv[0] == engine)
+		return ENS_OK;
+
+	if ((epContext->voice->klattv[0] == 0) && (engine != 0)) {
+		// the same open quotient a "klatt" line with no parameters gives
+		epContext->voice->klattv[KLATT_Kopen] = -40;
+	}
+	epContext->voice->klattv[0] = engine;
+	return DoVoiceChange(epContext, epContext->voice);
+}
+
 #pragma GCC visibility pop
 
 void FreeVoiceList(EspeakProcessorContext* epContext)
@@ -1362,17 +1390,63 @@ void FreeVoiceList(EspeakProcessorContext* epContext)
 	epContext->n_voices_list = 0;
 }
 
-#pragma GCC visibility push(default)
+// Reading every voice file costs more than loading the rest of espeak-ng-data, so the first
+// context to list the voices keeps a copy for any other context using the same data path.
+// The copies are handed out rather than the list itself, since SetVoiceScores() writes to them.
+#if defined(_WIN32) || defined(_WIN64)
+static SRWLOCK voice_list_cache_lock = SRWLOCK_INIT;
+#define LockVoiceListCache() AcquireSRWLockExclusive(&voice_list_cache_lock)
+#define UnlockVoiceListCache() ReleaseSRWLockExclusive(&voice_list_cache_lock)
+#else
+static pthread_mutex_t voice_list_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define LockVoiceListCache() pthread_mutex_lock(&voice_list_cache_lock)
+#define UnlockVoiceListCache() pthread_mutex_unlock(&voice_list_cache_lock)
+#endif
+static char voice_list_cache_path[N_PATH_HOME];
+static int n_voice_list_cache = -1;
+static espeak_VOICE *voice_list_cache[N_VOICES_LIST];
 
-ESPEAK_API const espeak_VOICE **espeak_ListVoices(EspeakProcessorContext* epContext, espeak_VOICE *voice_spec)
+static espeak_VOICE *CopyVoiceData(const espeak_VOICE *voice)
 {
-	char path_voices[sizeof(epContext->path_home)+12];
+	// ReadVoiceFile() allocates each voice in one block, with its strings after the struct
+	const char *base = (const char *)voice;
+	const char *end = voice->identifier + strlen(voice->identifier) + 1;
+	if (voice->name + strlen(voice->name) + 1 > end)
+		end = voice->name + strlen(voice->name) + 1;
+
+	char *p = (char *)malloc(end - base);
+	if (p == NULL)
+		return NULL;
+	memcpy(p, base, end - base);
 
-	espeak_VOICE *v;
-	static espeak_VOICE **voices = NULL;
+	espeak_VOICE *copy = (espeak_VOICE *)p;
+	copy->languages = p + (voice->languages - base);
+	copy->identifier = p + (voice->identifier - base);
+	copy->name = p + (voice->name - base);
+	return copy;
+}
 
-	// free previous voice list data
-	FreeVoiceList(epContext);
+static int CopyVoiceList(espeak_VOICE **to, espeak_VOICE *const *from, int n_voices)
+{
+	int ix;
+	for (ix = 0; ix < n_voices; ix++) {
+		if ((to[ix] = CopyVoiceData(from[ix])) == NULL)
+			return ix;
+	}
+	return n_voices;
+}
+
+static void ReadVoiceList(EspeakProcessorContext* epContext)
+{
+	char path_voices[sizeof(epContext->path_home)+12];
+
+	LockVoiceListCache();
+	if ((n_voice_list_cache >= 0) && (strcmp(voice_list_cache_path, epContext->path_home) == 0)) {
+		epContext->n_voices_list = CopyVoiceList(epContext->voices_list, voice_list_cache, n_voice_list_cache);
+		UnlockVoiceListCache();
+		return;
+	}
+	UnlockVoiceListCache();
 
 	sprintf(path_voices, "%s%cvoices", epContext->path_home, PATHSEP);
 	GetVoices(epContext, path_voices, strlen(path_voices)+1, 0);
@@ -1380,11 +1454,26 @@ ESPEAK_API const espeak_VOICE **espeak_ListVoices(EspeakProcessorContext* epCont
 	sprintf(path_voices, "%s%clang", epContext->path_home, PATHSEP);
 	GetVoices(epContext, path_voices, strlen(path_voices)+1, 1);
 
+	LockVoiceListCache();
+	if (n_voice_list_cache < 0) {
+		strcpy(voice_list_cache_path, epContext->path_home);
+		n_voice_list_cache = CopyVoiceList(voice_list_cache, epContext->voices_list, epContext->n_voices_list);
+	}
+	UnlockVoiceListCache();
+}
+
+#pragma GCC visibility push(default)
+
+ESPEAK_API const espeak_VOICE **espeak_ListVoices(EspeakProcessorContext* epContext, espeak_VOICE *voice_spec)
+{
+	espeak_VOICE *v;
+	espeak_VOICE **voices = epContext->voices_listed;
+
+	// free previous voice list data
+	FreeVoiceList(epContext);
+	ReadVoiceList(epContext);
+
 	epContext->voices_list[epContext->n_voices_list] = NULL; // voices list terminator
-	espeak_VOICE **new_voices = (espeak_VOICE **)realloc(voices, sizeof(espeak_VOICE *)*(epContext->n_voices_list+1));
-	if (new_voices == NULL)
-		return (const espeak_VOICE **)voices;
-	voices = new_voices;
 
 	// sort the voices list
 	qsort(epContext->voices_list, epContext->n_voices_list, sizeof(espeak_VOICE *),
@@ -22,6 +22,7 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -47,6 +48,7 @@
 
 #include "sintab.h"
 #include "speech.h"
+#include "trace.h"
 
 #if defined(_WIN32) || defined(_WIN64)
 
@@ -80,6 +82,9 @@ static const unsigned char modulation_tab[N_ROUGHNESS][8] = {
 	{ 0, 0x29, 0x29, 0x29, 0, 0x34, 0xf2, 0x28 },
 };
 
+// vibrato and pitch bend are worked out once per this many samples
+#define PITCH_RAMP_SAMPLES STEPSIZE
+
 // Flutter table, to add natural variations to the pitch
 #define N_FLUTTER  0x170
 
@@ -157,30 +162,45 @@ static const unsigned char pitch_adjust_tab[MAX_PITCH_VALUE+1] = {
 
 void writeSampleOut(EspeakProcessorContext* epContext, int z, float level)
 {
-    // if (!epContext->bends.freeze) {
-    if (false) {
+    // without a plugin buffer this is a plain espeak client, so fill the output buffer for the synth callback.
+    // When pulling, out_ptr still counts the samples so the generators stop at out_end like they do for a client
+    if (epContext->pluginBuffer == NULL || epContext->pullMode) {
         *epContext->out_ptr++ = z;
         *epContext->out_ptr++ = z >> 8;
     }
 
+    if (epContext->pluginBuffer != NULL && epContext->pullMode) {
+        float sample = (float)z / (float)(1<<16);
+        epContext->pluginBuffer[epContext->pluginBufferPosition++] = sample * level;
+        epContext->pluginSamplesWritten++;
+        return;
+    }
+
     if (epContext->pluginBuffer != NULL && epContext->noteEndingEarly == false)
     {
         bool notReady = false;
-        while (epContext->readyToProcess == notReady)
+        if (epContext->readyToProcess == notReady)
         {
-            #if defined(_WIN32) || defined(_WIN64)
-            WaitOnAddress (&epContext->readyToProcess, &notReady, sizeof(bool), INFINITE);
-            #else
-            pthread_mutex_lock(&epContext->espeak_wait_lock);
-            pthread_cond_wait(&epContext->espeak_wait_condition, &epContext->espeak_wait_lock);
-            pthread_mutex_unlock (&epContext->espeak_wait_lock);
-            #endif defined(_WIN32) || defined(_WIN64)
-
+            // the wait for the next block isn't wavegen's time
+            int stage = EnterStage(epContext, espeakSTAGE_NONE);
+            while (epContext->readyToProcess == notReady)
+            {
+                #if defined(_WIN32) || defined(_WIN64)
+                WaitOnAddress (&epContext->readyToProcess, &notReady, sizeof(bool), INFINITE);
+                #else
+                pthread_mutex_lock(&epContext->espeak_wait_lock);
+                pthread_cond_wait(&epContext->espeak_wait_condition, &epContext->espeak_wait_lock);
+                pthread_mutex_unlock (&epContext->espeak_wait_lock);
+                #endif defined(_WIN32) || defined(_WIN64)
+
+            }
+            EnterStage(epContext, stage);
         }
         float sample = (float)z / (float)(1<<16);
         epContext->pluginBuffer[epContext->pluginBufferPosition] = sample * level;
 
         epContext->pluginBufferPosition++;
+        epContext->pluginSamplesWritten++;
 
         if (epContext->pluginBufferPosition >= epContext->pluginBufferSize)
         {
@@ -198,6 +218,63 @@ void writeSampleOut(EspeakProcessorContext* epContext, int z, float level)
     }
 }
 
+int SungPitch(EspeakProcessorContext* epContext, int pitch)
+{
+	// a fixed pitch (Hz << 12) from espeak_ng_SetConstF0 or the fundamentalFreq bend replaces the intonation
+	if(epContext->const_f0)
+		pitch = (epContext->const_f0<<12);
+    if (epContext->bends.fundamentalFreq > 0) {
+        pitch = (int)(epContext->bends.fundamentalFreq * (1<<12));
+    }
+	return pitch;
+}
+
+float VibratoRate(EspeakProcessorContext* epContext)
+{
+	// Hz, the original vibrato ran at 30 steps of the 65536 step table per sample at 22050Hz
+	if (epContext->bends.vibratoRate > 0)
+		return epContext->bends.vibratoRate;
+	return (30.f * 22050) / 65536;
+}
+
+static float PitchBendAt(EspeakProcessorContext* epContext, unsigned short vibratoPosition)
+{
+	return epContext->bends.pitchbendMultiplier *
+	    (1 + epContext->bends.vibratoAmount * (float)sin_tab[vibratoPosition >> 5] / (10 * 8191.f));
+}
+
+float FramePitchBend(EspeakProcessorContext* epContext, int nsamples)
+{
+	// pitch multiplier from the pitch bend and vibrato, for the klatt engines which
+	// only set their pitch once per frame of nsamples
+	epContext->bends.vibratoWavePosition += (int)(VibratoRate(epContext) * 65536 * nsamples / epContext->samplerate + 0.5f);
+	return PitchBendAt(epContext, epContext->bends.vibratoWavePosition);
+}
+
+static void StartPitchRamp(EspeakProcessorContext* epContext)
+{
+	// The vibrato and pitch bend are only evaluated at control rate, at the start and
+	// end of each PITCH_RAMP_SAMPLES frame, and the bent phase increment is ramped
+	// linearly between them so the per-sample path stays integer only.
+	// A new phaseinc from the intonation restarts the ramp from where the vibrato is.
+	int consumed = PITCH_RAMP_SAMPLES - epContext->pitch_ramp_remaining;
+	int frameStep = (int)(VibratoRate(epContext) * 65536 * PITCH_RAMP_SAMPLES / epContext->samplerate + 0.5f);
+	unsigned short start;
+	int startInc;
+	int endInc;
+
+	epContext->bends.vibratoWavePosition += frameStep * consumed / PITCH_RAMP_SAMPLES;
+	start = epContext->bends.vibratoWavePosition;
+
+	startInc = (int)(epContext->phaseinc * PitchBendAt(epContext, start));
+	endInc = (int)(epContext->phaseinc * PitchBendAt(epContext, (unsigned short)(start + frameStep)));
+
+	epContext->pitch_ramp_inc = startInc;
+	epContext->pitch_ramp_step = (endInc - startInc) / PITCH_RAMP_SAMPLES;
+	epContext->pitch_ramp_remaining = PITCH_RAMP_SAMPLES;
+	epContext->pitch_ramp_base = epContext->phaseinc;
+}
+
 short int fetchSineFromTable(EspeakProcessorContext* epContext, int theta)
 {
     const short int amp = 8191;
@@ -308,7 +385,7 @@ static const unsigned char pk_shape2[PEAKSHAPEW+1] = {
 	  0
 };
 
-void WavegenInit(EspeakProcessorContext* epContext, int rate, int wavemult_fact)
+void WavegenSetSampleRate(EspeakProcessorContext* epContext, int rate, int wavemult_fact)
 {
 	int ix;
 	double x;
@@ -316,19 +393,15 @@ void WavegenInit(EspeakProcessorContext* epContext, int rate, int wavemult_fact)
 	if (wavemult_fact == 0)
 		wavemult_fact = 60; // default
 
-	epContext->wvoice = NULL;
 	epContext->samplerate = rate;
 	epContext->PHASE_INC_FACTOR = 0x8000000 / epContext->samplerate; // assumes pitch is Hz*32
 	epContext->Flutter_inc = (64 * epContext->samplerate)/rate;
-	epContext->samplecount = 0;
-	epContext->nsamples = 0;
-	epContext->wavephase = 0x7fffffff;
 
-	epContext->wdata.amplitude = 32;
-	epContext->wdata.amplitude_fmt = 100;
-
-	for (ix = 0; ix < N_EMBEDDED_VALUES; ix++)
-		epContext->embedded_value[ix] = embedded_default[ix];
+	// the recorded consonants stay at their own rate, PlayWave steps through them at this ratio
+	if (epContext->wavefile_samplerate == 0)
+		epContext->wavefile_samplerate = rate;
+	epContext->wave_step = (int)(((int64_t)epContext->wavefile_samplerate << 16) / rate);
+	epContext->pitch_ramp_remaining = 0;
 
 	// set up window to generate a spread of harmonics from a
 	// single peak for HF peaks
@@ -336,6 +409,7 @@ void WavegenInit(EspeakProcessorContext* epContext, int rate, int wavemult_fact)
 	if (epContext->wavemult_max > N_WAVEMULT) epContext->wavemult_max = N_WAVEMULT;
 
 	epContext->wavemult_offset = epContext->wavemult_max/2;
+	epContext->ptoh_valid = 0;
 
 	if (epContext->samplerate != 22050) {
 		// wavemult table has preset values for 22050 Hz, we only need to
@@ -346,17 +420,38 @@ void WavegenInit(EspeakProcessorContext* epContext, int rate, int wavemult_fact)
 		}
 	}
 
-	epContext->pk_shape = pk_shape2;
-
 #if USE_KLATT
 	KlattInit(epContext);
 #endif
 }
 
-void WavegenFini(void)
+void WavegenInit(EspeakProcessorContext* epContext, int rate, int wavemult_fact)
+{
+	int ix;
+
+	epContext->wvoice = NULL;
+	epContext->samplecount = 0;
+	epContext->nsamples = 0;
+	epContext->wavephase = 0x7fffffff;
+
+	epContext->wdata.amplitude = 32;
+	epContext->wdata.amplitude_fmt = 100;
+
+	for (ix = 0; ix < N_EMBEDDED_VALUES; ix++)
+		epContext->embedded_value[ix] = embedded_default[ix];
+
+	epContext->pk_shape = pk_shape2;
+
+	epContext->float_breath_bank = 1;
+	epContext->breath_noise = 0x2545F491;
+
+	WavegenSetSampleRate(epContext, rate, wavemult_fact);
+}
+
+void WavegenFini(EspeakProcessorContext* epContext)
 {
 #if USE_KLATT
-	KlattFini();
+	KlattFini(epContext);
 #endif
 }
 
@@ -402,6 +497,8 @@ static void WavegenSetEcho(EspeakProcessorContext* epContext)
 		amp = 0;
 
 	epContext->echo_head = (delay * epContext->samplerate)/1000;
+	if (epContext->echo_head >= N_ECHO_BUF)
+		epContext->echo_head = N_ECHO_BUF-1; // the buffer is sized for 22050 Hz
 	epContext->echo_length = epContext->echo_head; // ensure completion of echo at the end of speech. Use 1 delay period?
 	if (amp == 0)
 		epContext->echo_length = 0;
@@ -415,6 +512,35 @@ static void WavegenSetEcho(EspeakProcessorContext* epContext)
 	epContext->general_amplitude = ((epContext->general_amplitude * (500-amp))/500);
 }
 
+static bool HarmspectUnchanged(EspeakProcessorContext* epContext, wavegen_peaks_t *peaks, int pitch)
+{
+	// compare against, then remember, everything the harmonic spectrum below is built from.
+	// Only an exact match of the pitch and every peak counts. A new pitch moves every harmonic to
+	// another point on the peak shapes and into another tone_adjust bin, so there's nothing in the
+	// last spectrum to rescale that would come out the same as building it again. Gliding pitch
+	// (intonation, vibrato, pitch bend) always rebuilds; held notes in sing mode and a frozen voice don't
+	int pk;
+	bool unchanged;
+
+	if (peaks != epContext->peaks)
+		return false; // someone else's peaks (spect.c), don't touch the cache
+
+	unchanged = epContext->ptoh_valid && (epContext->ptoh_pitch == pitch);
+	epContext->ptoh_pitch = pitch;
+
+	for (pk = 0; pk <= epContext->wvoice->n_harmonic_peaks; pk++) {
+		int *key = epContext->ptoh_peaks[pk];
+		if (key[0] != peaks[pk].freq || key[1] != peaks[pk].height || key[2] != peaks[pk].left || key[3] != peaks[pk].right) {
+			unchanged = false;
+			key[0] = peaks[pk].freq;
+			key[1] = peaks[pk].height;
+			key[2] = peaks[pk].left;
+			key[3] = peaks[pk].right;
+		}
+	}
+	return unchanged;
+}
+
 int PeaksToHarmspect(EspeakProcessorContext* epContext, wavegen_peaks_t *peaks, int pitch, int *htab, int control)
 {
 	if (epContext->wvoice == NULL)
@@ -449,40 +575,8 @@ int PeaksToHarmspect(EspeakProcessorContext* epContext, wavegen_peaks_t *peaks,
 	if (hmax > hmax_samplerate)
 		hmax = hmax_samplerate;
 
-	for (h = 0; h <= hmax; h++)
-		htab[h] = 0;
-
-	for (pk = 0; pk <= epContext->wvoice->n_harmonic_peaks; pk++) {
-		p = &peaks[pk];
-		if ((p->height == 0) || (fp = p->freq) == 0)
-			continue;
-
-		fhi = p->freq + p->right;
-		h = ((p->freq - p->left) / pitch) + 1;
-		if (h <= 0) h = 1;
-
-		for (f = pitch*h; f < fp; f += pitch)
-			htab[h++] += epContext->pk_shape[(fp-f)/(p->left>>8)] * p->height;
-		for (; f < fhi; f += pitch)
-			htab[h++] += epContext->pk_shape[(f-fp)/(p->right>>8)] * p->height;
-	}
-
-	int y;
-	int h2;
-	// increase bass
-	y = peaks[1].height * 10; // addition as a multiple of 1/256s
-	h2 = (1000<<16)/pitch; // decrease until 1000Hz
-	if (h2 > 0) {
-		x = y/h2;
-		h = 1;
-		while (y > 0) {
-			htab[h++] += y;
-			y -= x;
-		}
-	}
-
 	// find the nearest harmonic for HF peaks where we don't use shape
-	for (; pk < N_PEAKS; pk++) {
+	for (pk = epContext->wvoice->n_harmonic_peaks+1; pk < N_PEAKS; pk++) {
 		x = peaks[pk].height >> 14;
 		epContext->peak_height[pk] = (x * x * 5)/2;
 
@@ -496,15 +590,58 @@ int PeaksToHarmspect(EspeakProcessorContext* epContext, wavegen_peaks_t *peaks,
 			epContext->peak_height[pk] = 0;
 	}
 
-	// convert from the square-rooted values
-	f = 0;
-	for (h = 0; h <= hmax; h++, f += pitch) {
-		x = htab[h] >> 15;
-		htab[h] = (x * x) >> 8;
+	if (HarmspectUnchanged(epContext, peaks, pitch)) {
+		// nothing that shapes the harmonics has moved since last time (steady pitch and formants,
+		// or a frozen voice), the squared and tone adjusted spectrum is the same as before
+		memcpy(htab, epContext->ptoh_htab, (hmax+1) * sizeof(int));
+	} else {
+		memset(htab, 0, (hmax+1) * sizeof(int));
+
+		for (pk = 0; pk <= epContext->wvoice->n_harmonic_peaks; pk++) {
+			p = &peaks[pk];
+			if ((p->height == 0) || (fp = p->freq) == 0)
+				continue;
+
+			fhi = p->freq + p->right;
+			h = ((p->freq - p->left) / pitch) + 1;
+			if (h <= 0) h = 1;
+
+			for (f = pitch*h; f < fp; f += pitch)
+				htab[h++] += epContext->pk_shape[(fp-f)/(p->left>>8)] * p->height;
+			for (; f < fhi; f += pitch)
+				htab[h++] += epContext->pk_shape[(f-fp)/(p->right>>8)] * p->height;
+		}
+
+		int y;
+		int h2;
+		// increase bass
+		y = peaks[1].height * 10; // addition as a multiple of 1/256s
+		h2 = (1000<<16)/pitch; // decrease until 1000Hz
+		if (h2 > 0) {
+			x = y/h2;
+			h = 1;
+			while (y > 0) {
+				htab[h++] += y;
+				y -= x;
+			}
+		}
+
+		// convert from the square-rooted values.
+		// kept apart from the tone adjust so the compiler can vectorize it
+		for (h = 0; h <= hmax; h++) {
+			x = htab[h] >> 15;
+			htab[h] = (x * x) >> 8;
+		}
 
-		int ix;
-		if ((ix = (f >> 19)) < N_TONE_ADJUST)
-			htab[h] = (htab[h] * epContext->wvoice->tone_adjust[ix]) >> 13; // index tone_adjust with Hz/8
+		// index tone_adjust with Hz/8. f only goes up, so stop at the end of the table
+		f = 0;
+		for (h = 0; h <= hmax && (f >> 19) < N_TONE_ADJUST; h++, f += pitch)
+			htab[h] = (htab[h] * epContext->wvoice->tone_adjust[f >> 19]) >> 13;
+
+		if (peaks == epContext->peaks) {
+			memcpy(epContext->ptoh_htab, htab, (hmax+1) * sizeof(int));
+			epContext->ptoh_valid = 1;
+		}
 	}
 
 	// adjust the amplitude of the first harmonic, affects tonal quality
@@ -544,11 +681,7 @@ static void AdvanceParameters(EspeakProcessorContext* epContext)
 	epContext->Flutter_ix += epContext->Flutter_inc;
 	epContext->wdata.pitch += x;
 	
-	if(epContext->const_f0)
-		epContext->wdata.pitch = (epContext->const_f0<<12);
-    if (epContext->bends.fundamentalFreq > 0) {
-        epContext->wdata.pitch = (int)(epContext->bends.fundamentalFreq * (1<<12));
-    }
+	epContext->wdata.pitch = SungPitch(epContext, epContext->wdata.pitch);
 
 	if (epContext->wdata.pitch < 102400)
 		epContext->wdata.pitch = 102400; // min pitch, 25 Hz  (25 << 12)
@@ -642,6 +775,7 @@ void InitBreath(EspeakProcessorContext* epContext)
 
 	for (ix = 0; ix < N_PEAKS; ix++)
 		setresonator(epContext, &epContext->rbreath[ix], 2000, 200, 1);
+	memset(&epContext->breath_bank, 0, sizeof(epContext->breath_bank));
 }
 
 static void SetBreath(EspeakProcessorContext* epContext)
@@ -658,12 +792,61 @@ static void SetBreath(EspeakProcessorContext* epContext)
 			setresonator(epContext, &epContext->rbreath[pk], epContext->peaks[pk].freq >> 16, epContext->wvoice->breathw[pk], 0);
 		}
 	}
+
+	if (epContext->float_breath_bank) {
+		breath_bank_t *bank = &epContext->breath_bank;
+		int lane;
+
+		for (lane = 0; lane < N_BREATH_LANES; lane++) {
+			pk = lane + 1;
+			bank->a[lane] = (float)epContext->rbreath[pk].a;
+			bank->b[lane] = (float)epContext->rbreath[pk].b;
+			bank->c[lane] = (float)epContext->rbreath[pk].c;
+			bank->amp[lane] = (float)(epContext->wvoice->breath[pk] * (epContext->peaks[pk].height >> 14));
+		}
+	}
+}
+
+/*
+   The breath resonators in single precision, one lane per breath formant.
+   SetBreath() refreshes the coefficients and gains every 64 samples, and a
+   formant without breath just has a gain of 0, so every sample does the same
+   multiply-adds in every lane and the loop vectorizes.
+ */
+
+static inline int BreathNoise(EspeakProcessorContext* epContext)
+{
+	// xorshift32, over the same range espeak_rand(epContext, -0x2000, 0x1fff) gives
+	uint32_t x = epContext->breath_noise;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	epContext->breath_noise = x;
+	return (int)(x >> 18) + 0x2000;
+}
+
+static int ApplyBreathBank(EspeakProcessorContext* epContext)
+{
+	breath_bank_t *bank = &epContext->breath_bank;
+	float noise = (float)BreathNoise(epContext);
+	float y[N_BREATH_LANES];
+	int lane;
+
+	for (lane = 0; lane < N_BREATH_LANES; lane++) {
+		float x = bank->a[lane] * noise + bank->b[lane] * bank->x1[lane] + bank->c[lane] * bank->x2[lane];
+		bank->x2[lane] = bank->x1[lane];
+		bank->x1[lane] = x;
+		y[lane] = x * bank->amp[lane];
+	}
+	return (int)(((y[0] + y[4]) + (y[2] + y[6])) + ((y[1] + y[5]) + (y[3] + y[7])));
 }
 
 static int ApplyBreath(EspeakProcessorContext* epContext)
 {
 	if (epContext->wvoice == NULL)
 		return 0;
+	if (epContext->float_breath_bank)
+		return ApplyBreathBank(epContext);
 
 	int value = 0;
 	int noise;
@@ -708,6 +891,7 @@ static int Wavegen(EspeakProcessorContext* epContext, int length, int modulation
 
 	unsigned short waveph;
 	unsigned short theta;
+	int phaseinc;
 	int total;
 	int h;
 	int ix;
@@ -720,6 +904,7 @@ static int Wavegen(EspeakProcessorContext* epContext, int length, int modulation
 	int sample;
 	int amp;
 	int modn_amp = 1, modn_period;
+	espeak_TRACE_RECORD *record;
 	// static int agc = 256;
 	// static int h_switch_sign = 0;
 	// static int cycle_count = 0;
@@ -764,16 +949,17 @@ static int Wavegen(EspeakProcessorContext* epContext, int length, int modulation
 			epContext->maxh2 = PeaksToHarmspect(epContext, epContext->peaks, epContext->wdata.pitch<<4, epContext->hspect[epContext->hswitch], 1);
 
 			SetBreath(epContext);
-		    if (epContext->bends.debugPrintEverything)
-		    {
-		        printf("wave: %i %i %i %i %i %i %i | ",
-		            epContext->samplecount, epContext->phaseinc, epContext->samplecount_start, epContext->wdata.amplitude,
-		            epContext->wdata.pitch, epContext->wdata.amplitude_fmt, epContext->flutter_amp);
-		        for (ix = 0; ix <= epContext->wvoice->n_harmonic_peaks; ix++) {
-		            printf("%f %f %f %f,", epContext->peaks[ix].freq1, epContext->peaks[ix].height1, epContext->peaks[ix].left1, epContext->peaks[ix].right1);
-		        }
-		        printf("\n");
-		    }
+			if ((record = StartTraceRecord(epContext, espeakTRACE_FRAME, epContext->out_ptr)) != NULL) {
+				record->u.frame.pitch = epContext->wdata.pitch;
+				record->u.frame.amplitude = epContext->wdata.amplitude;
+				record->u.frame.amplitude_fmt = epContext->wdata.amplitude_fmt;
+				record->u.frame.n_peaks = N_PEAKS;
+				for (ix = 0; ix < N_PEAKS; ix++) {
+					record->u.frame.freq[ix] = (float)(epContext->peaks[ix].freq1 / 65536);
+					record->u.frame.height[ix] = epContext->peaks[ix].height1;
+				}
+				FinishTraceRecord(epContext);
+			}
 		} else if (!epContext->bends.freeze && (epContext->samplecount & 0x07) == 0) {
 			for (h = 1; h < N_LOWHARM && h <= epContext->maxh2 && h <= epContext->maxh; h++)
 				epContext->harmspect[h] += epContext->harm_inc[h];
@@ -786,12 +972,14 @@ static int Wavegen(EspeakProcessorContext* epContext, int length, int modulation
             epContext->samplecount++;
 	    }
 
-        epContext->bends.vibratoWavePosition += 30;
-	    float phaseIncRescale = epContext->bends.pitchbendMultiplier *
-	        (1 + epContext->bends.vibratoAmount * (float)sin_tab[epContext->bends.vibratoWavePosition >> 5] / (10 * 8191.f));
+		if (epContext->pitch_ramp_remaining == 0 || epContext->phaseinc != epContext->pitch_ramp_base)
+			StartPitchRamp(epContext);
+		phaseinc = epContext->pitch_ramp_inc;
+		epContext->pitch_ramp_inc += epContext->pitch_ramp_step;
+		epContext->pitch_ramp_remaining--;
 
         if (epContext->wavephase > 0) {
-			epContext->wavephase += epContext->phaseinc * phaseIncRescale;
+			epContext->wavephase += phaseinc;
 			if (epContext->wavephase < 0) {
 				// sign has changed, reached a quiet point in the waveform
 				epContext->cbytes = epContext->wavemult_offset - (epContext->cycle_samples)/2;
@@ -853,7 +1041,7 @@ static int Wavegen(EspeakProcessorContext* epContext, int length, int modulation
 				}
 			}
 		} else
-			epContext->wavephase += epContext->phaseinc * phaseIncRescale;
+			epContext->wavephase += phaseinc;
 		waveph = (unsigned short)(epContext->wavephase >> 16);
 		total = 0;
 
@@ -896,15 +1084,18 @@ static int Wavegen(EspeakProcessorContext* epContext, int length, int modulation
 		// mix with sampled wave if required
 		z2 = 0;
 		if (epContext->wdata.mix_wavefile_ix < epContext->wdata.n_mix_wavefile) {
+			epContext->mix_wave_frac += epContext->wave_step;
 			if (epContext->wdata.mix_wave_scale == 0) {
 				// a 16 bit sample
 				c = epContext->wdata.mix_wavefile[epContext->wdata.mix_wavefile_ix+epContext->wdata.mix_wavefile_offset+1];
 				sample = epContext->wdata.mix_wavefile[epContext->wdata.mix_wavefile_ix+epContext->wdata.mix_wavefile_offset] + (c * 256);
-				epContext->wdata.mix_wavefile_ix += 2;
+				epContext->wdata.mix_wavefile_ix += 2 * (epContext->mix_wave_frac >> 16);
 			} else {
 				// a 8 bit sample, scaled
-				sample = (signed char)epContext->wdata.mix_wavefile[epContext->wdata.mix_wavefile_offset+epContext->wdata.mix_wavefile_ix++] * epContext->wdata.mix_wave_scale;
+				sample = (signed char)epContext->wdata.mix_wavefile[epContext->wdata.mix_wavefile_offset+epContext->wdata.mix_wavefile_ix] * epContext->wdata.mix_wave_scale;
+				epContext->wdata.mix_wavefile_ix += epContext->mix_wave_frac >> 16;
 			}
+			epContext->mix_wave_frac &= 0xffff;
 			z2 = (sample * epContext->wdata.amplitude_v) >> 10;
 			z2 = (z2 * epContext->wdata.mix_wave_amp)/32;
 
@@ -987,23 +1178,28 @@ static int PlayWave(EspeakProcessorContext* epContext, int length, bool resume,
 	signed char c;
 
 	if (resume == false) {
-		epContext->wave_n_samples = length;
+		// length is in samples of the wave data, which may be at a different rate to the output
+		epContext->wave_n_samples = (int)(((int64_t)length << 16) / epContext->wave_step);
 		epContext->wave_ix = 0;
+		epContext->wave_frac = 0;
 	}
 
 	epContext->nsamples = 0;
 	epContext->samplecount = 0;
 
 	while ((epContext->wave_n_samples-- > 0) && (epContext->noteEndingEarly == false)) {
+		epContext->wave_frac += epContext->wave_step;
 		if (scale == 0) {
 			// 16 bits data
 			c = data[epContext->wave_ix+1];
 			value = data[epContext->wave_ix] + (c * 256);
-			epContext->wave_ix += 2;
+			epContext->wave_ix += 2 * (epContext->wave_frac >> 16);
 		} else {
 			// 8 bit data, shift by the specified scale factor
-			value = (signed char)data[epContext->wave_ix++] * scale;
+			value = (signed char)data[epContext->wave_ix] * scale;
+			epContext->wave_ix += epContext->wave_frac >> 16;
 		}
+		epContext->wave_frac &= 0xffff;
 		value *= (epContext->consonant_amp * epContext->general_amplitude); // reduce strength of consonant
 		value = value >> 10;
 		value = (value * amp)/32;
@@ -1113,6 +1309,7 @@ void WavegenSetVoice(EspeakProcessorContext* epContext, voice_t *v)
 
 	memcpy(&epContext->v2, v, sizeof(epContext->v2));
 	epContext->wvoice = &epContext->v2;
+	epContext->ptoh_valid = 0;
 
 	if (v->peak_shape == 0)
 		epContext->pk_shape = pk_shape1;
@@ -1366,6 +1563,7 @@ static int WavegenFill2(EspeakProcessorContext* epContext)
 			}
 			epContext->wdata.mix_wavefile_ix = 0;
 			epContext->wdata.mix_wavefile_offset = 0;
+			epContext->mix_wave_frac = 0;
 			epContext->wdata.mix_wavefile = (unsigned char *)q[2];
 			break;
 		case WCMD_SPECT2: // as WCMD_SPECT but stop any concurrent wave file
@@ -1484,16 +1682,18 @@ static int SpeedUp(EspeakProcessorContext* epContext, short *outbuf, int length_
 }
 #endif
 
-// Call WavegenFill2, and then speed up the output samples.
+// Call WavegenFill2, and then speed up the output samples, counting both as espeakSTAGE_WAVEGEN.
 int WavegenFill(EspeakProcessorContext* epContext)
 {
 	int finished;
+	int stage;
 #if USE_LIBSONIC
 	unsigned char *p_start;
 
 	p_start = epContext->out_ptr;
 #endif
 
+	stage = EnterStage(epContext, espeakSTAGE_WAVEGEN);
 	finished = WavegenFill2(epContext);
 
 #if USE_LIBSONIC
@@ -1509,6 +1709,7 @@ int WavegenFill(EspeakProcessorContext* epContext)
 			finished = 0; // there may be more data to flush
 	}
 #endif
+	EnterStage(epContext, stage);
 	return finished;
 }
 
@@ -1528,4 +1729,16 @@ espeak_ng_SetConstF0(EspeakProcessorContext* epContext, int f0)
 	return ENS_OK;
 }
 
+ESPEAK_NG_API espeak_ng_STATUS
+espeak_ng_SetSampleRate(EspeakProcessorContext* epContext, int rate)
+{
+	// Synthesize directly at the given rate instead of the phondata rate.
+	// Call after espeak_ng_Initialize and before selecting a voice, the voice
+	// formant rates are worked out from the samplerate when it is loaded.
+	if (rate <= 0)
+		return EINVAL;
+	WavegenSetSampleRate(epContext, rate, 0);
+	return ENS_OK;
+}
+
 #pragma GCC visibility pop
@@ -44,10 +44,17 @@ void SetPitch2(EspeakProcessorContext* epContext, voice_t *voice,
 void WavegenInit(EspeakProcessorContext* epContext, int rate,
 		int wavemult_fact);
 
-void WavegenFini(void);
+void WavegenSetSampleRate(EspeakProcessorContext* epContext, int rate,
+		int wavemult_fact);
+
+void WavegenFini(EspeakProcessorContext* epContext);
 
 
 int WavegenFill(EspeakProcessorContext* epContext);
+void writeSampleOut(EspeakProcessorContext* epContext, int z, float level);
+int SungPitch(EspeakProcessorContext* epContext, int pitch);
+float VibratoRate(EspeakProcessorContext* epContext);
+float FramePitchBend(EspeakProcessorContext* epContext, int nsamples);
 void WavegenSetVoice(EspeakProcessorContext* epContext, voice_t *v);
 int WcmdqFree(EspeakProcessorContext* epContext);
 void WcmdqStop(EspeakProcessorContext* epContext);
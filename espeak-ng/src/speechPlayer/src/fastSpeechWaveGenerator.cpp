@@ -0,0 +1,361 @@
+/*
+This file is a part of the NV Speech Player project, as bundled with espeak-ng.
+URL: https://bitbucket.org/nvaccess/speechplayer
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License, as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+This license can be found at:
+http://www.gnu.org/licenses/gpl.html
+*/
+
+/*
+The same klsyn-88 model as speechWaveGenerator.cpp, restructured for speed:
+the frame is still read every sample, but the formant coefficients are only worked out
+once per block and ramped linearly across it, and each stage runs over the whole block
+before the next one starts.
+Everything after the coefficients is single precision, the parallel formants run side by
+side as one bank, noise comes from a per instance xorshift instead of rand(), the phase
+accumulators wrap by themselves instead of using fmod, and vibrato is read from a table.
+*/
+
+#define _USE_MATH_DEFINES
+
+#include <cmath>
+#include <cstdint>
+#include "utils.h"
+#include "speechWaveGenerator.h"
+
+using namespace std;
+
+namespace {
+
+const unsigned int blockSize=64;
+const int numParallelLanes=8; // 6 formants, padded to a whole vector
+const int sineTableBits=10;
+const int sineTableSize=1<<sineTableBits;
+const double phaseScale=4294967296.0; // phases are fractions of a cycle in 32 bits
+
+class SineTable {
+	public:
+	float values[sineTableSize];
+	SineTable() {
+		for(int i=0;i<sineTableSize;++i) values[i]=(float)sin((M_PI*2*i)/sineTableSize);
+	}
+};
+
+const SineTable sineTable;
+
+class FastNoiseGenerator {
+	private:
+	uint32_t state;
+	float lastValue;
+
+	public:
+	FastNoiseGenerator(uint32_t seed): state(seed?seed:1), lastValue(0.0f) {};
+
+	float getNext() {
+		state^=state<<13;
+		state^=state>>17;
+		state^=state<<5;
+		lastValue=((float)(state>>8)*(1.0f/16777216.0f))+0.75f*lastValue;
+		return lastValue;
+	}
+
+};
+
+class PhaseAccumulator {
+	private:
+	double incrementFactor;
+	uint32_t phase;
+
+	public:
+	PhaseAccumulator(int sr): incrementFactor(phaseScale/sr), phase(0) {}
+
+	uint32_t getNext(double frequency) {
+		phase+=(uint32_t)(int64_t)(frequency*incrementFactor);
+		return phase;
+	}
+
+};
+
+class FastResonator {
+	private:
+	int sampleRate;
+	bool anti;
+	bool setOnce;
+	double frequency;
+	double bandwidth;
+
+	public:
+	// coefficients reached at the end of the last block, and the ones to ramp to over this one
+	float a, b, c;
+	float targetA, targetB, targetC;
+	float p1, p2;
+
+	FastResonator(int sampleRate, bool anti=false): sampleRate(sampleRate), anti(anti), setOnce(false), frequency(0), bandwidth(0), a(0), b(0), c(0), targetA(0), targetB(0), targetC(0), p1(0), p2(0) {}
+
+	void setParams(double frequency, double bandwidth) {
+		if(setOnce&&(frequency==this->frequency)&&(bandwidth==this->bandwidth)) return;
+		this->frequency=frequency;
+		this->bandwidth=bandwidth;
+		double r=exp(-M_PI/sampleRate*bandwidth);
+		double c=-(r*r);
+		double b=r*cos(M_PI*2/sampleRate*-frequency)*2.0;
+		double a=1.0-b-c;
+		if(anti&&frequency!=0) {
+			a=1.0/a;
+			c*=-a;
+			b*=-a;
+		}
+		targetA=(float)a;
+		targetB=(float)b;
+		targetC=(float)c;
+		if(!setOnce) {
+			this->a=targetA;
+			this->b=targetB;
+			this->c=targetC;
+		}
+		setOnce=true;
+	}
+
+	void resonateBlock(float* buf, unsigned int n) {
+		if(n==0) return;
+		float p1=this->p1, p2=this->p2;
+		float a=this->a, b=this->b, c=this->c;
+		const float da=(targetA-a)/n, db=(targetB-b)/n, dc=(targetC-c)/n;
+		for(unsigned int i=0;i<n;++i) {
+			a+=da;
+			b+=db;
+			c+=dc;
+			float out=a*buf[i]+b*p1+c*p2;
+			p2=p1;
+			p1=anti?buf[i]:out;
+			buf[i]=out;
+		}
+		this->p1=p1;
+		this->p2=p2;
+		this->a=targetA;
+		this->b=targetB;
+		this->c=targetC;
+	}
+
+};
+
+class FastSpeechWaveGeneratorImpl: public SpeechWaveGenerator {
+	private:
+	int sampleRate;
+	PhaseAccumulator pitchGen;
+	PhaseAccumulator vibratoGen;
+	FastNoiseGenerator aspirationGen;
+	FastNoiseGenerator fricGenerator;
+	FastResonator rN0, rNP, r6, r5, r4, r3, r2, r1;
+	FastResonator parallelResonators[6];
+	bool coefficientsSet;
+	float parallelA[numParallelLanes], parallelB[numParallelLanes], parallelC[numParallelLanes];
+	float parallelTargetA[numParallelLanes], parallelTargetB[numParallelLanes], parallelTargetC[numParallelLanes];
+	float parallelP1[numParallelLanes], parallelP2[numParallelLanes];
+	FrameManager* frameManager;
+
+	// per sample values for the current block
+	float cascadeIn[blockSize];
+	float cascadeN0[blockSize];
+	float parallelIn[blockSize];
+	float parallelOut[blockSize];
+	float caNP[blockSize];
+	float parallelBypass[blockSize];
+	float outputGain[blockSize];
+	float parallelAmp[blockSize][numParallelLanes];
+
+	// the rest of a block the caller only wanted part of. Blocks always start where the last one
+	// ended, not where the caller's buffer does, so the output doesn't depend on how much is asked for at once
+	::sample pending[blockSize];
+	unsigned int pendingStart, pendingEnd;
+
+	void setCoefficients(const speechPlayer_frame_t* frame) {
+		rN0.setParams(frame->cfN0,frame->cbN0);
+		rNP.setParams(frame->cfNP,frame->cbNP);
+		r6.setParams(frame->cf6,frame->cb6);
+		r5.setParams(frame->cf5,frame->cb5);
+		r4.setParams(frame->cf4,frame->cb4);
+		r3.setParams(frame->cf3,frame->cb3);
+		r2.setParams(frame->cf2,frame->cb2);
+		r1.setParams(frame->cf1,frame->cb1);
+		const double pf[6]={frame->pf1,frame->pf2,frame->pf3,frame->pf4,frame->pf5,frame->pf6};
+		const double pb[6]={frame->pb1,frame->pb2,frame->pb3,frame->pb4,frame->pb5,frame->pb6};
+		for(int k=0;k<6;++k) {
+			parallelResonators[k].setParams(pf[k],pb[k]);
+			parallelTargetA[k]=parallelResonators[k].targetA;
+			parallelTargetB[k]=parallelResonators[k].targetB;
+			parallelTargetC[k]=parallelResonators[k].targetC;
+			if(!coefficientsSet) {
+				parallelA[k]=parallelTargetA[k];
+				parallelB[k]=parallelTargetB[k];
+				parallelC[k]=parallelTargetC[k];
+			}
+		}
+		coefficientsSet=true;
+	}
+
+	// Reads up to n frames, generating the voice and frication sources as it goes.
+	// The resonators ramp to the coefficients of the last frame read.
+	// Returns fewer than n when the frame manager runs out.
+	unsigned int fillBlock(unsigned int n) {
+		const speechPlayer_frame_t* lastFrame=NULL;
+		unsigned int i;
+		for(i=0;i<n;++i) {
+			const speechPlayer_frame_t* frame=frameManager->getCurrentFrame();
+			if(!frame) break;
+			lastFrame=frame;
+
+			uint32_t vibratoPhase=vibratoGen.getNext(frame->vibratoSpeed);
+			double vibrato=(sineTable.values[vibratoPhase>>(32-sineTableBits)]*0.06*frame->vibratoPitchOffset)+1;
+			float voice=(float)pitchGen.getNext(frame->voicePitch*vibrato)*(float)(1.0/phaseScale);
+			float aspiration=aspirationGen.getNext()*0.2f;
+			float turbulence=aspiration*(float)frame->voiceTurbulenceAmplitude;
+			if(voice<frame->glottalOpenQuotient) {
+				turbulence*=0.01f;
+			}
+			voice=(voice*2)-1;
+			voice+=turbulence;
+			voice*=(float)frame->voiceAmplitude;
+			aspiration*=(float)frame->aspirationAmplitude;
+			cascadeIn[i]=(aspiration+voice)*(float)frame->preFormantGain/2.0f;
+
+			float fric=fricGenerator.getNext()*0.3f*(float)frame->fricationAmplitude;
+			parallelIn[i]=fric*(float)frame->preFormantGain/2.0f;
+
+			caNP[i]=(float)frame->caNP;
+			parallelBypass[i]=(float)frame->parallelBypass;
+			outputGain[i]=(float)frame->outputGain;
+			parallelAmp[i][0]=(float)frame->pa1;
+			parallelAmp[i][1]=(float)frame->pa2;
+			parallelAmp[i][2]=(float)frame->pa3;
+			parallelAmp[i][3]=(float)frame->pa4;
+			parallelAmp[i][4]=(float)frame->pa5;
+			parallelAmp[i][5]=(float)frame->pa6;
+		}
+		if(lastFrame) setCoefficients(lastFrame);
+		return i;
+	}
+
+	void cascadeBlock(unsigned int n) {
+		for(unsigned int i=0;i<n;++i) cascadeN0[i]=cascadeIn[i];
+		rN0.resonateBlock(cascadeN0,n);
+		rNP.resonateBlock(cascadeN0,n);
+		for(unsigned int i=0;i<n;++i) {
+			cascadeN0[i]=(float)calculateValueAtFadePosition(cascadeIn[i],cascadeN0[i],caNP[i]);
+		}
+		r6.resonateBlock(cascadeN0,n);
+		r5.resonateBlock(cascadeN0,n);
+		r4.resonateBlock(cascadeN0,n);
+		r3.resonateBlock(cascadeN0,n);
+		r2.resonateBlock(cascadeN0,n);
+		r1.resonateBlock(cascadeN0,n);
+	}
+
+	void parallelBlock(unsigned int n) {
+		if(n==0) return;
+		float a[numParallelLanes], b[numParallelLanes], c[numParallelLanes];
+		float da[numParallelLanes], db[numParallelLanes], dc[numParallelLanes];
+		float p1[numParallelLanes], p2[numParallelLanes];
+		for(int k=0;k<numParallelLanes;++k) {
+			a[k]=parallelA[k];
+			b[k]=parallelB[k];
+			c[k]=parallelC[k];
+			da[k]=(parallelTargetA[k]-a[k])/n;
+			db[k]=(parallelTargetB[k]-b[k])/n;
+			dc[k]=(parallelTargetC[k]-c[k])/n;
+			p1[k]=parallelP1[k];
+			p2[k]=parallelP2[k];
+		}
+		for(unsigned int i=0;i<n;++i) {
+			const float in=parallelIn[i];
+			float out[numParallelLanes];
+			for(int k=0;k<numParallelLanes;++k) {
+				a[k]+=da[k];
+				b[k]+=db[k];
+				c[k]+=dc[k];
+				out[k]=a[k]*in+b[k]*p1[k]+c[k]*p2[k];
+				p2[k]=p1[k];
+				p1[k]=out[k];
+				out[k]=(out[k]-in)*parallelAmp[i][k];
+			}
+			float sum=0;
+			for(int k=0;k<numParallelLanes;++k) sum+=out[k];
+			parallelOut[i]=(float)calculateValueAtFadePosition(sum,in,parallelBypass[i]);
+		}
+		for(int k=0;k<numParallelLanes;++k) {
+			parallelA[k]=parallelTargetA[k];
+			parallelB[k]=parallelTargetB[k];
+			parallelC[k]=parallelTargetC[k];
+			parallelP1[k]=p1[k];
+			parallelP2[k]=p2[k];
+		}
+	}
+
+	// Renders up to a block, stopping early when the frame manager runs out
+	unsigned int renderBlock(::sample* sampleBuf) {
+		unsigned int got=fillBlock(blockSize);
+		cascadeBlock(got);
+		parallelBlock(got);
+		for(unsigned int i=0;i<got;++i) {
+			float out=(cascadeN0[i]+parallelOut[i])*outputGain[i]*4000;
+			out=out<32000?out:32000;
+			out=out>-32000?out:-32000;
+			sampleBuf[i].value=(int)out;
+		}
+		return got;
+	}
+
+	public:
+	FastSpeechWaveGeneratorImpl(int sr): sampleRate(sr), pitchGen(sr), vibratoGen(sr), aspirationGen(0x2545F491), fricGenerator(0x9E3779B9),
+		rN0(sr,true), rNP(sr), r6(sr), r5(sr), r4(sr), r3(sr), r2(sr), r1(sr),
+		parallelResonators{FastResonator(sr),FastResonator(sr),FastResonator(sr),FastResonator(sr),FastResonator(sr),FastResonator(sr)},
+		coefficientsSet(false), frameManager(NULL), pendingStart(0), pendingEnd(0) {
+		for(int k=0;k<numParallelLanes;++k) {
+			parallelA[k]=parallelB[k]=parallelC[k]=0;
+			parallelTargetA[k]=parallelTargetB[k]=parallelTargetC[k]=0;
+			parallelP1[k]=parallelP2[k]=0;
+		}
+		for(unsigned int i=0;i<blockSize;++i) {
+			for(int k=6;k<numParallelLanes;++k) parallelAmp[i][k]=0;
+		}
+	}
+
+	unsigned int generate(const unsigned int sampleCount, ::sample* sampleBuf) {
+		if(!frameManager) return 0;
+		unsigned int done=0;
+		while(done<sampleCount&&pendingStart<pendingEnd) {
+			sampleBuf[done++]=pending[pendingStart++];
+		}
+		while(done<sampleCount) {
+			unsigned int got;
+			if(sampleCount-done>=blockSize) {
+				got=renderBlock(sampleBuf+done);
+				done+=got;
+			} else {
+				got=renderBlock(pending);
+				pendingStart=0;
+				pendingEnd=got;
+				while(done<sampleCount&&pendingStart<pendingEnd) {
+					sampleBuf[done++]=pending[pendingStart++];
+				}
+			}
+			if(got<blockSize) break;
+		}
+		return done;
+	}
+
+	void setFrameManager(FrameManager* frameManager) {
+		this->frameManager=frameManager;
+	}
+
+};
+
+}
+
+SpeechWaveGenerator* SpeechWaveGenerator::createFast(int sampleRate) {return new FastSpeechWaveGeneratorImpl(sampleRate); }
@@ -23,15 +23,23 @@ typedef struct {
 	SpeechWaveGenerator* waveGenerator;
 } speechPlayer_handleInfo_t;
 
-speechPlayer_handle_t speechPlayer_initialize(int sampleRate) {
+static speechPlayer_handle_t initializeWithGenerator(int sampleRate, SpeechWaveGenerator* waveGenerator) {
 	speechPlayer_handleInfo_t* playerHandleInfo=new speechPlayer_handleInfo_t;
 	playerHandleInfo->sampleRate=sampleRate;
 	playerHandleInfo->frameManager=FrameManager::create();
-	playerHandleInfo->waveGenerator=SpeechWaveGenerator::create(sampleRate);
+	playerHandleInfo->waveGenerator=waveGenerator;
 	playerHandleInfo->waveGenerator->setFrameManager(playerHandleInfo->frameManager);
 	return (speechPlayer_handle_t)playerHandleInfo;
 }
 
+speechPlayer_handle_t speechPlayer_initialize(int sampleRate) {
+	return initializeWithGenerator(sampleRate,SpeechWaveGenerator::create(sampleRate));
+}
+
+speechPlayer_handle_t speechPlayer_initializeFast(int sampleRate) {
+	return initializeWithGenerator(sampleRate,SpeechWaveGenerator::createFast(sampleRate));
+}
+
 void speechPlayer_queueFrame(speechPlayer_handle_t playerHandle, speechPlayer_frame_t* framePtr, unsigned int minFrameDuration, unsigned int fadeDuration, int userIndex, bool purgeQueue) { 
 	speechPlayer_handleInfo_t* playerHandleInfo=(speechPlayer_handleInfo_t*)playerHandle;
 	if (fadeDuration < 1) fadeDuration = 1;
@@ -21,6 +21,7 @@ Based on klsyn-88, found at http://linguistics.berkeley.edu/phonlab/resources/
 
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 #include "utils.h"
 #include "speechWaveGenerator.h"
@@ -29,15 +30,20 @@ using namespace std;
 
 const double PITWO=M_PI*2;
 
+// xorshift32 per generator rather than rand(), which locks for every sample of every voice
 class NoiseGenerator {
 	private:
+	uint32_t state;
 	double lastValue;
 
 	public:
-	NoiseGenerator(): lastValue(0.0) {};
+	NoiseGenerator(uint32_t seed): state(seed?seed:1), lastValue(0.0) {};
 
 	double getNext() {
-		lastValue=((double)rand()/RAND_MAX)+0.75*lastValue;
+		state^=state<<13;
+		state^=state>>17;
+		state^=state<<5;
+		lastValue=((double)state/4294967295.0)+0.75*lastValue;
 		return lastValue;
 	}
 
@@ -67,7 +73,7 @@ class VoiceGenerator {
 
 	public:
 	bool glottisOpen;
-	VoiceGenerator(int sr): pitchGen(sr), vibratoGen(sr), aspirationGen(), glottisOpen(false) {};
+	VoiceGenerator(int sr): pitchGen(sr), vibratoGen(sr), aspirationGen(0x2545F491), glottisOpen(false) {};
 
 	double getNext(const speechPlayer_frame_t* frame) {
 		double vibrato=(sin(vibratoGen.getNext(frame->vibratoSpeed)*PITWO)*0.06*frame->vibratoPitchOffset)+1;
@@ -191,7 +197,7 @@ class SpeechWaveGeneratorImpl: public SpeechWaveGenerator {
 	FrameManager* frameManager;
 
 	public:
-	SpeechWaveGeneratorImpl(int sr): sampleRate(sr), voiceGenerator(sr), fricGenerator(), cascade(sr), parallel(sr), frameManager(NULL) {
+	SpeechWaveGeneratorImpl(int sr): sampleRate(sr), voiceGenerator(sr), fricGenerator(0x9E3779B9), cascade(sr), parallel(sr), frameManager(NULL) {
 	}
 
 	unsigned int generate(const unsigned int sampleCount, ::sample* sampleBuf) {
@@ -22,6 +22,7 @@ http://www.gnu.org/licenses/gpl.html
 class SpeechWaveGenerator: public WaveGenerator {
 	public:
 	static SpeechWaveGenerator* create(int sampleRate); 
+	static SpeechWaveGenerator* createFast(int sampleRate); // block based, single precision. see fastSpeechWaveGenerator.cpp
 	virtual void setFrameManager(FrameManager* frameManager)=0;
 	virtual ~SpeechWaveGenerator() {};
 };
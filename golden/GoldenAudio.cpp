@@ -0,0 +1,234 @@
+#include "dsp/HomerProcessor.h"
+#include "render/RenderJob.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <juce_dsp/juce_dsp.h>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <optional>
+#include <vector>
+
+// Renders a fixed set of lyric, voice and bend scenarios through HomerProcessor, deterministically seeded,
+// and holds each one up against its reference in golden/references. A scenario without a reference fails,
+// so a new one has to have its reference recorded and committed along with it.
+//
+//   HOMER_GOLDEN_RECORD=1  writes the references instead, for when the sound is meant to change
+//   HOMER_GOLDEN_MODE      how close is close enough: exact (the default), snr or spectral. Exact only
+//                          holds on machines that do their floating point the way the recording one did
+//   HOMER_GOLDEN_DIFFS     where a failing scenario's render, reference and difference go as WAVs,
+//                          golden-diffs in the working directory if it isn't set
+
+namespace
+{
+    struct Scenario
+    {
+        const char* name;
+        const char* lyric;
+        const char* voice; // one of HomerState's voiceNames, or nullptr for the default
+        std::function<void (HomerState&)> setUp;
+    };
+
+    constexpr double sampleRate = 48000;
+    constexpr int blockSize = 512;
+    constexpr int numSamples = 3 * 48000;
+    constexpr juce::uint32 sessionSeed = 1234;
+
+    constexpr double minSnrDb = 60;
+    constexpr double maxSpectralDistanceDb = 0.5;
+
+    const std::vector<Scenario>& getScenarios()
+    {
+        static const std::vector<Scenario> scenarios {
+            { "spoken", "She sells seashells by the seashore", nullptr, [] (HomerState&) {} },
+            { "sung", "She sells seashells by the seashore", nullptr, [] (HomerState& hs) {
+                 *hs.singParam = true;
+                 hs.keyFrequency = 220.0f;
+             } },
+            { "german", "Guten Morgen, wie geht es dir", "German", [] (HomerState&) {} },
+            { "klatt", "Hello Homer, how are you", nullptr, [] (HomerState& hs) { *hs.engine = 1; } },
+            { "speechplayer", "Hello Homer, how are you", nullptr, [] (HomerState& hs) { *hs.engine = 2; } },
+            { "bent", "She sells seashells by the seashore", nullptr, [] (HomerState& hs) {
+                 *hs.detuneHarmonics = 0.7f;
+                 *hs.wavetableShape = 0.5f;
+                 *hs.pitchBend = 0.3f;
+                 *hs.vibrato = 0.5f;
+                 *hs.consonantVowelBlend = -0.4f;
+                 *hs.formantFrequencyRescaler.end = 0.7f;
+                 *hs.formantHeightRescaler.curve = 0.5f;
+             } },
+            { "stuck and rotated", "She sells seashells by the seashore", nullptr, [] (HomerState& hs) {
+                 *hs.phonemeStickParam = 0.4f;
+                 *hs.phonemeRotationParam = 0.3f;
+             } },
+            { "frozen", "She sells seashells by the seashore", nullptr, [] (HomerState& hs) { *hs.freezeParam = true; } },
+            { "aliased", "She sells seashells by the seashore", nullptr, [] (HomerState& hs) {
+                 *hs.clockSpeed = 11025.0f;
+                 *hs.amountOfAliasing = 0.8f;
+             } },
+            { "clean resampling", "She sells seashells by the seashore", nullptr, [] (HomerState& hs) {
+                 *hs.clockSpeed = 16000.0f;
+                 *hs.cleanResamplingParam = true;
+             } },
+        };
+        return scenarios;
+    }
+
+    // one note from the top of the first block, offline so nothing depends on how threads are scheduled
+    juce::AudioBuffer<float> render (const Scenario& scenario)
+    {
+        HomerState hs;
+        hs.deterministic = true;
+        hs.sessionSeed = sessionSeed;
+        if (scenario.voice != nullptr) {
+            auto voiceIndex = hs.voiceNames.indexOf (scenario.voice);
+            REQUIRE (voiceIndex >= 0);
+            *hs.languageSelectors[0] = voiceIndex;
+        }
+        scenario.setUp (hs);
+
+        HomerProcessor hp (hs);
+        hp.setOffline (true);
+        hp.prepareToPlay (sampleRate, blockSize);
+        hs.setLyric (0, scenario.lyric);
+
+        juce::AudioBuffer<float> output (1, numSamples);
+        output.clear();
+        for (int start = 0; start < numSamples; start += blockSize) {
+            auto length = std::min (blockSize, numSamples - start);
+            hp.processBlock (output, static_cast<unsigned int> (start), static_cast<unsigned int> (length), start == 0);
+        }
+        hp.releaseResources();
+        return output;
+    }
+
+    std::optional<juce::AudioBuffer<float>> readWav (const juce::File& file)
+    {
+        juce::WavAudioFormat wav;
+        std::unique_ptr<juce::AudioFormatReader> reader (wav.createReaderFor (file.createInputStream().release(), true));
+        if (reader == nullptr) {
+            return std::nullopt;
+        }
+        juce::AudioBuffer<float> buffer (static_cast<int> (reader->numChannels), static_cast<int> (reader->lengthInSamples));
+        reader->read (&buffer, 0, buffer.getNumSamples(), 0, true, true);
+        return buffer;
+    }
+
+    // signal to noise in dB, taking the difference from the reference as the noise
+    double getSnrDb (const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& output)
+    {
+        double signal = 0;
+        double noise = 0;
+        for (int i = 0; i < reference.getNumSamples(); ++i) {
+            auto r = static_cast<double> (reference.getSample (0, i));
+            auto d = static_cast<double> (output.getSample (0, i)) - r;
+            signal += r * r;
+            noise += d * d;
+        }
+        if (noise == 0) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return 10 * std::log10 (std::max (signal, 1.0e-30) / noise);
+    }
+
+    // the RMS difference of the two log power spectra in dB, averaged over Hann windowed frames. Bins
+    // quieter than powerFloor count as powerFloor, so the differences in near silence don't swamp it
+    double getSpectralDistanceDb (const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& output)
+    {
+        constexpr int order = 11;
+        constexpr int size = 1 << order;
+        constexpr int hop = size / 2;
+        constexpr float powerFloor = 1.0e-10f;
+        juce::dsp::FFT fft (order);
+        juce::dsp::WindowingFunction<float> window (size, juce::dsp::WindowingFunction<float>::hann, false);
+        std::vector<float> a (2 * size);
+        std::vector<float> b (2 * size);
+
+        double total = 0;
+        int numFrames = 0;
+        for (int start = 0; start + size <= reference.getNumSamples(); start += hop) {
+            std::fill (a.begin(), a.end(), 0.0f);
+            std::fill (b.begin(), b.end(), 0.0f);
+            std::copy_n (reference.getReadPointer (0, start), size, a.begin());
+            std::copy_n (output.getReadPointer (0, start), size, b.begin());
+            window.multiplyWithWindowingTable (a.data(), size);
+            window.multiplyWithWindowingTable (b.data(), size);
+            fft.performFrequencyOnlyForwardTransform (a.data(), true);
+            fft.performFrequencyOnlyForwardTransform (b.data(), true);
+
+            double sum = 0;
+            for (int bin = 0; bin <= size / 2; ++bin) {
+                auto d = 10 * (std::log10 (std::max (a[bin] * a[bin], powerFloor)) - std::log10 (std::max (b[bin] * b[bin], powerFloor)));
+                sum += d * d;
+            }
+            total += std::sqrt (sum / (size / 2 + 1));
+            ++numFrames;
+        }
+        return numFrames > 0 ? total / numFrames : 0;
+    }
+
+    void writeDiffs (const Scenario& scenario, const juce::AudioBuffer<float>& reference, const juce::AudioBuffer<float>& output)
+    {
+        auto path = juce::SystemStats::getEnvironmentVariable ("HOMER_GOLDEN_DIFFS", {});
+        auto directory = path.isNotEmpty() ? juce::File (path) : juce::File::getCurrentWorkingDirectory().getChildFile ("golden-diffs");
+        auto name = juce::File::createLegalFileName (scenario.name);
+
+        juce::AudioBuffer<float> difference (1, output.getNumSamples());
+        difference.copyFrom (0, 0, output, 0, 0, output.getNumSamples());
+        difference.addFrom (0, 0, reference, 0, 0, std::min (reference.getNumSamples(), output.getNumSamples()), -1.0f);
+
+        CHECK (RenderJob::writeWav (output, sampleRate, directory.getChildFile (name + "-render.wav"), 32).wasOk());
+        CHECK (RenderJob::writeWav (reference, sampleRate, directory.getChildFile (name + "-reference.wav"), 32).wasOk());
+        CHECK (RenderJob::writeWav (difference, sampleRate, directory.getChildFile (name + "-difference.wav"), 32).wasOk());
+        WARN ("wrote the render, reference and difference to " << directory.getFullPathName());
+    }
+}
+
+TEST_CASE ("Golden audio", "[golden]")
+{
+    auto mode = juce::SystemStats::getEnvironmentVariable ("HOMER_GOLDEN_MODE", "exact");
+    REQUIRE ((mode == "exact" || mode == "snr" || mode == "spectral"));
+    auto recording = juce::SystemStats::getEnvironmentVariable ("HOMER_GOLDEN_RECORD", {}).getIntValue() != 0;
+    auto references = juce::File (GOLDEN_REFERENCES_DIR);
+
+    for (auto& scenario : getScenarios()) {
+        DYNAMIC_SECTION (scenario.name)
+        {
+            auto output = render (scenario);
+            REQUIRE (std::any_of (output.getReadPointer (0), output.getReadPointer (0) + numSamples, [] (float s) { return s != 0; }));
+
+            // 32 bit WAVs are floats, so the references read back exactly as they were rendered
+            auto file = references.getChildFile (juce::File::createLegalFileName (scenario.name) + ".wav");
+            auto reference = recording ? std::nullopt : readWav (file);
+            if (recording) {
+                REQUIRE (RenderJob::writeWav (output, sampleRate, file, 32).wasOk());
+                WARN ("recorded " << file.getFullPathName());
+            } else if (!reference) {
+                FAIL ("no reference for " << scenario.name << " at " << file.getFullPathName() << ", run with HOMER_GOLDEN_RECORD=1 to record one");
+            } else {
+                auto matches = reference->getNumChannels() == 1 && reference->getNumSamples() == output.getNumSamples();
+                juce::String measured = "the reference is a different length";
+                if (matches && mode == "exact") {
+                    matches = std::equal (output.getReadPointer (0), output.getReadPointer (0) + numSamples, reference->getReadPointer (0));
+                    measured = "SNR " + juce::String (getSnrDb (*reference, output)) + " dB, bit exact needed";
+                } else if (matches && mode == "snr") {
+                    auto snr = getSnrDb (*reference, output);
+                    matches = snr >= minSnrDb;
+                    measured = "SNR " + juce::String (snr) + " dB, at least " + juce::String (minSnrDb) + " needed";
+                } else if (matches && mode == "spectral") {
+                    auto distance = getSpectralDistanceDb (*reference, output);
+                    matches = distance <= maxSpectralDistanceDb;
+                    measured = "log spectral distance " + juce::String (distance) + " dB, at most " + juce::String (maxSpectralDistanceDb) + " allowed";
+                }
+
+                if (!matches) {
+                    writeDiffs (scenario, *reference, output);
+                }
+                INFO (measured);
+                CHECK (matches);
+            }
+        }
+    }
+}
@@ -1,7 +1,8 @@
 #include "PluginEditor.h"
 
 PluginEditor::PluginEditor (PluginProcessor& p)
-    : AudioProcessorEditor (&p), processorRef (p), lyricsEditor (processorRef.homerState), bendsPanel (processorRef.homerState)
+    : AudioProcessorEditor (&p), processorRef (p), lyricsEditor (processorRef.homerState), bendsPanel (processorRef.homerState),
+      timingsPanel (processorRef.homerState)
 {
     juce::ignoreUnused (processorRef);
 
@@ -22,6 +23,14 @@ PluginEditor::PluginEditor (PluginProcessor& p)
         inspector->setVisible (true);
     };
 
+    // where the CPU goes, over the lyrics while it's up
+    addChildComponent (timingsPanel);
+    addAndMakeVisible (timingsButton);
+    timingsButton.setClickingTogglesState (true);
+    timingsButton.onClick = [&] {
+        timingsPanel.setVisible (timingsButton.getToggleState());
+    };
+
     // Make sure that before the constructor has finished, you've set the
     // editor's size to whatever you need it to be.
     setSize (800, 400);
@@ -51,4 +60,6 @@ void PluginEditor::resized()
     bendsPanel.setBounds (area.withTrimmedTop (titlePanel.getBottom() + 5).withLeft (std::max(getWidth() / 2, getRight() - 600)));
     lyricsEditor.setBounds (bendsPanel.getBounds().withLeft (area.getX()).withRight (bendsPanel.getX() - 5));
     inspectButton.setBounds (titlePanel.getBounds().withWidth (100).reduced (5));
+    timingsButton.setBounds (titlePanel.getBounds().withTrimmedLeft (titlePanel.getWidth() - 100).reduced (5));
+    timingsPanel.setBounds (lyricsEditor.getBounds());
 }
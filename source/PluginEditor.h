@@ -5,6 +5,7 @@
 
 #include "gui/BendsPanel.h"
 #include "gui/LyricsEditor.h"
+#include "gui/TimingsPanel.h"
 #include "gui/TitlePanel.h"
 
 #include "melatonin_inspector/melatonin_inspector.h"
@@ -32,5 +33,8 @@ private:
 
     std::unique_ptr<melatonin::Inspector> inspector;
     juce::TextButton inspectButton { "Inspect the UI" };
+
+    TimingsPanel timingsPanel;
+    juce::TextButton timingsButton { "Timings" };
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginEditor)
 };
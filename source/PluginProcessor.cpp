@@ -94,6 +94,17 @@ void PluginProcessor::prepareToPlay (double sampleRate, int samplesPerBlock)
 {
     std::cout << "prepareToPlay" << std::endl;
     homerProcessor = std::make_unique<HomerProcessor> (homerState);
+
+    // HOMER_TRACE=file traces the synthesis into file for analysis_and_graphs/homer_trace.py, into a new file each
+    // time the host prepares Homer so one doesn't write over another
+    auto tracePath = juce::SystemStats::getEnvironmentVariable ("HOMER_TRACE", {});
+    if (tracePath.isNotEmpty()) {
+        auto traceFile = juce::File::getCurrentWorkingDirectory().getChildFile (tracePath);
+        homerProcessor->startTrace (traceFile.exists() ? traceFile.getNonexistentSibling() : traceFile);
+    }
+    // hosts prepare again around a bounce. Switching anywhere else would set up or tear down espeak
+    // threads on the audio thread, so one that doesn't gets a bounce through the real time threads, only slower
+    homerProcessor->setOffline (isNonRealtime());
     homerProcessor->prepareToPlay (sampleRate, samplesPerBlock);
 }
 
@@ -160,8 +171,19 @@ void PluginProcessor::processBlock (juce::AudioBuffer<float>& buffer,
         }
     }
 
+    // the notes played are done with, what goes out is what Homer sings. Hosts hand the same buffer in
+    // every block, and clearing keeps its storage, so making room for the most a block can send only
+    // allocates the first block a buffer comes by. A host that hands in a new one each block owns that
+    midiMessages.clear();
+    midiMessages.ensureSize (VoiceMidi::maxBytesPerBlock);
+    if (homerState.killParam->get()) {
+        voiceMidi.allNotesOff (midiMessages, 0);
+    }
+
     if (noteStartSample >= 0) {
         homerProcessor->processBlock (buffer, 0, noteStartSample, false);
+        voiceMidi.addEvents (homerProcessor->getEvents(), midiMessages);
+        voiceMidi.allNotesOff (midiMessages, noteStartSample);
 
         buffer.applyGainRamp(0, noteStartSample, 1, 0);
 
@@ -170,12 +192,14 @@ void PluginProcessor::processBlock (juce::AudioBuffer<float>& buffer,
         }
 
         homerProcessor->processBlock (buffer, noteStartSample, buffer.getNumSamples() - noteStartSample, true);
+        voiceMidi.addEvents (homerProcessor->getEvents(), midiMessages);
     } else {
         if (!homerState.currentMidiNotes.empty()) {
             homerState.keyFrequency = juce::MidiMessage::getMidiNoteInHertz (homerState.currentMidiNotes.back());
         }
 
         homerProcessor->processBlock (buffer, 0, buffer.getNumSamples(), false);
+        voiceMidi.addEvents (homerProcessor->getEvents(), midiMessages);
     }
 
     homerState.peakLevel = buffer.getMagnitude (0,0,buffer.getNumSamples());
@@ -196,23 +220,12 @@ juce::AudioProcessorEditor* PluginProcessor::createEditor()
 //==============================================================================
 void PluginProcessor::getStateInformation (juce::MemoryBlock& destData)
 {
-    juce::XmlElement xml("state");
-    auto params = xml.createNewChildElement ("parameters");
-    for (auto& p : getParameters()) {
-        params->setAttribute (juce::String("param-") + juce::String(p->getParameterIndex()), p->getValue());
-    }
-    auto lyrics = xml.createNewChildElement ("lyrics");
-    // You should use this method to store your parameters in the memory block.
-    // You could do that either as raw data, or use the XML or ValueTree classes
-    // as intermediaries to make it easy to save and load complex data.
-    juce::ignoreUnused (destData);
+    homerState.saveState (destData);
 }
 
 void PluginProcessor::setStateInformation (const void* data, int sizeInBytes)
 {
-    // You should use this method to restore your parameters from this memory block,
-    // whose contents will have been created by the getStateInformation() call.
-    juce::ignoreUnused (data, sizeInBytes);
+    homerState.loadState (data, static_cast<size_t> (juce::jmax (0, sizeInBytes)));
 }
 
 //==============================================================================
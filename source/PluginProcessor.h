@@ -1,6 +1,7 @@
 #pragma once
 
 #include "state/HomerState.h"
+#include "dsp/VoiceMidi.h"
 
 #include <juce_audio_processors/juce_audio_processors.h>
 
@@ -46,5 +47,6 @@ public:
     HomerState homerState;
 private:
     std::unique_ptr<HomerProcessor> homerProcessor;
+    VoiceMidi voiceMidi;
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PluginProcessor)
 };
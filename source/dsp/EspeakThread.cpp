@@ -3,6 +3,7 @@
 //
 
 #include "EspeakThread.h"
+#include "../state/EspeakDataPath.h"
 #include "espeak-ng/espeak_ng.h"
 
 #if defined(_WIN32) || defined(_WIN64)
@@ -11,19 +12,23 @@
 #include <pthread.h>
 #endif
 
-EspeakThread::EspeakThread(HomerState& hs) : Thread ("EspeakThread"), epContext(), homerState (hs), readyToGo(false), readyToWait (false)
+EspeakThread::EspeakThread(HomerState& hs) : Thread ("EspeakThread"), epContext(), homerState (hs), readyToGo(false), readyToWait (false), synthesisSampleRate (0), synthesisEngine (0), lyricLine (0), lyricVersion (0), voiceIndex (0), randSeed (0), traced (false), synchronous (false)
 {
 }
 
 EspeakThread::~EspeakThread()
-= default;
+{
+    // a running thread may still be inside espeak, a synchronous note never is
+    if (synchronous) {
+        espeak_Terminate (&epContext);
+    }
+}
 
 void EspeakThread::resetEspeakContext()
 {
-    // const char* path = R"(D:\projects\circuitbent-speech\espeak-ng\espeak-ng-data)";
-    const char* path = R"(/home/arden/projects/circuitbent-speech/espeak-ng/espeak-ng-data)";
+    const char* path = espeakDataPath;
     espeak_AUDIO_OUTPUT output = AUDIO_OUTPUT_SYNCHRONOUS;
-    int buflength = 500, options = 0;
+    int buflength = 500, options = espeakINITIALIZE_PHONEME_EVENTS;
 
     memset(&epContext, 0, sizeof(EspeakProcessorContext));
 
@@ -31,6 +36,9 @@ void EspeakThread::resetEspeakContext()
 
     espeak_Initialize (&epContext, output, buflength, path, options);
 
+    if (synthesisSampleRate > 0) {
+        espeak_ng_SetSampleRate (&epContext, synthesisSampleRate);
+    }
 }
 
 void EspeakThread::endNote()
@@ -57,23 +65,37 @@ int synthCallback(short *wav, int, espeak_EVENT*)
     return 0;
 }
 
-
-void EspeakThread::run()
+static void eventCallback (const espeak_EVENT* event)
 {
-    resetEspeakContext();
-
-    language = homerState.voiceNames[*homerState.languageSelectors[*homerState.lyricSelector - 1]];
-    auto voiceResult = espeak_SetVoiceByName(&epContext, language.toRawUTF8());
-    jassert (voiceResult == 0);
-    std::vector<float> samples;
-    samples.clear();
+    VoiceEvent voiceEvent;
+    switch (event->type) {
+        case espeakEVENT_WORD:
+            voiceEvent.type = VoiceEvent::Type::word;
+            break;
+        case espeakEVENT_SENTENCE:
+            voiceEvent.type = VoiceEvent::Type::sentence;
+            break;
+        case espeakEVENT_PHONEME:
+            voiceEvent.type = VoiceEvent::Type::phoneme;
+            std::memcpy (voiceEvent.phoneme.data(), event->id.string, voiceEvent.phoneme.size());
+            voiceEvent.phonemeClass = static_cast<VoiceEvent::PhonemeClass> (event->length);
+            break;
+        case espeakEVENT_END:
+            voiceEvent.type = VoiceEvent::Type::end;
+            break;
+        default:
+            return;
+    }
+    voiceEvent.sample = event->sample;
+    voiceEvent.textPosition = event->text_position;
+    voiceEvent.length = voiceEvent.type == VoiceEvent::Type::phoneme ? 0 : event->length;
+    static_cast<EspeakThread*> (event->user_data)->events.push (voiceEvent);
+}
 
-    espeak_SetSynthCallback(&epContext, synthCallback);
 
-    void* user_data = &samples;
-    unsigned int *identifier = nullptr;
-
-    lyrics = homerState.lyrics[*homerState.lyricSelector - 1].toStdString();
+void EspeakThread::run()
+{
+    prepareNote();
 
     readyToWait = true;
     auto waitResult = wait (-1);
@@ -85,10 +107,7 @@ void EspeakThread::run()
         return;
     }
 
-    // epContext.bends.debugPrintEverything = true;
-    setBendParametersFromState();
-    auto synthError = espeak_Synth(&epContext, lyrics.c_str(), 500, 0, POS_CHARACTER, 0, espeakCHARS_AUTO, identifier, user_data);
-    jassert (synthError == 0);
+    startNote();
     epContext.allDone = true;
     epContext.doneProcessing = true;
     #if defined(_WIN32) || defined(_WIN64)
@@ -97,6 +116,103 @@ void EspeakThread::run()
     #endif
 
 }
+
+void EspeakThread::prepareSynchronously()
+{
+    jassert (!isThreadRunning());
+    synchronous = true;
+    prepareNote();
+}
+
+void EspeakThread::startSynchronously()
+{
+    jassert (synchronous);
+    auto pullResult = espeak_ng_SetPullMode (&epContext, 1);
+    jassert (pullResult == ENS_OK);
+    startNote();
+}
+
+bool EspeakThread::isSinging() const
+{
+    // a thread that has sung its last sample may take a moment to stop, and the block after
+    // shouldn't depend on whether it has
+    return !epContext.allDone && (synchronous || isThreadRunning());
+}
+
+void EspeakThread::prepareNote()
+{
+    resetEspeakContext();
+
+    lyricLine = *homerState.lyricSelector - 1;
+    voiceIndex = *homerState.languageSelectors[static_cast<size_t> (lyricLine)];
+    language = homerState.voiceNames[voiceIndex];
+    auto voiceResult = espeak_SetVoiceByName(&epContext, language.toRawUTF8());
+    jassert (voiceResult == 0);
+    auto engineResult = espeak_ng_SetSynthesisEngine (&epContext, synthesisEngine);
+    jassert (engineResult == ENS_OK);
+
+    espeak_SetSynthCallback(&epContext, synthCallback);
+    espeak_ng_SetEventCallback (&epContext, eventCallback);
+    espeak_ng_SetTrace (&epContext, traced);
+
+    auto snapshot = homerState.phonemeCache.getSnapshot (lyricLine);
+    lyricVersion = snapshot.version;
+    lyrics = snapshot.lyric.toStdString();
+    if (snapshot.voice == language) {
+        translation = snapshot.translation;
+    } else {
+        // the voice was changed without going through the editor, which bumps the version and sets up another thread
+        homerState.phonemeCache.translate (lyricLine, snapshot.lyric, language);
+        if (homerState.deterministic) {
+            // unless this one is going to wait for the new translation anyway
+            lyricVersion = homerState.phonemeCache.getVersion (lyricLine);
+        }
+    }
+
+    if (homerState.deterministic && translation == nullptr && snapshot.lyric.isNotEmpty()) {
+        // singing from the text makes different choices to singing from the translation, so whether
+        // the translation was ready in time can't be left to chance
+        translation = homerState.phonemeCache.waitForTranslation (lyricLine, lyricVersion, translationTimeoutMs);
+        auto after = homerState.phonemeCache.getSnapshot (lyricLine);
+        if (translation == nullptr && after.version == lyricVersion) {
+            // the one way a deterministic note can still come out differently, so it's said out loud
+            auto reason = after.translated ? juce::String ("couldn't be translated")
+                                           : "wasn't translated within " + juce::String (translationTimeoutMs) + " ms";
+            juce::Logger::writeToLog ("Homer: lyric line " + juce::String (lyricLine + 1) + " " + reason
+                + ", so this note is sung from its text and may not come out the same every time");
+        }
+    }
+}
+
+void EspeakThread::startNote()
+{
+    // the events find their way back here through it
+    void* user_data = this;
+    unsigned int *identifier = nullptr;
+
+    setBendParametersFromState();
+    if (homerState.deterministic) {
+        espeak_ng_SetRandSeed (&epContext, static_cast<long> (randSeed));
+    }
+    if (translation == nullptr) {
+        // it may have finished translating since this thread was set up
+        translation = homerState.phonemeCache.tryGetTranslation (lyricLine, lyricVersion);
+    }
+    if (translation != nullptr) {
+        // the recorded commands go straight to wavegen, unless the bends or engine need them generated again
+        auto synthError = translation->commands != nullptr
+            ? espeak_ng_SynthesizeCommandStream (&epContext, translation->commands, user_data)
+            : ENS_NOT_SUPPORTED;
+        if (synthError == ENS_NOT_SUPPORTED) {
+            synthError = espeak_ng_SynthesizePhonemeCache (&epContext, translation->phonemes, user_data);
+        }
+        jassert (synthError == ENS_OK);
+    } else {
+        auto synthError = espeak_Synth(&epContext, lyrics.c_str(), 500, 0, POS_CHARACTER, 0, espeakCHARS_AUTO, identifier, user_data);
+        jassert (synthError == 0);
+    }
+}
+
 void EspeakThread::setBendParametersFromState()
 {
     if (homerState.singParam->get()) {
@@ -110,6 +226,7 @@ void EspeakThread::setBendParametersFromState()
     epContext.bends.detuneHarmonics = homerState.detuneHarmonics->get();
     epContext.bends.pitchbendMultiplier = std::pow(2.0f, *homerState.pitchBend / 12.f);
     epContext.bends.vibratoAmount = *homerState.vibrato;
+    epContext.bends.vibratoRate = *homerState.vibratoRate;
 
     epContext.bends.formantFrequencyRescaler.start = *homerState.formantFrequencyRescaler.start;
     epContext.bends.formantFrequencyRescaler.end = *homerState.formantFrequencyRescaler.end;
@@ -137,6 +254,15 @@ void EspeakThread::setOutputBuffer (float* ptr, int numSamples)
 
 void EspeakThread::process()
 {
+    if (synchronous) {
+        // whatever the note doesn't fill is left as it was, like when the thread finishes mid-buffer
+        auto numSamples = espeak_ng_PullSamples (&epContext, epContext.pluginBuffer, epContext.pluginBufferSize);
+        if (numSamples < epContext.pluginBufferSize) {
+            epContext.allDone = true;
+        }
+        return;
+    }
+
     epContext.readyToProcess = true;
     epContext.doneProcessing = false;
     epContext.allDone = false;
@@ -7,7 +7,9 @@
 
 #include "juce_core/juce_core.h"
 #include "../state/HomerState.h"
+#include "VoiceEvents.h"
 
+#include <atomic>
 #include <espeak-ng/speak_lib.h>
 
 class EspeakThread : public juce::Thread
@@ -21,17 +23,54 @@ public:
 
     void run() override;
 
+    // for offline rendering: sets up the note the way run() does, but with no thread, so it can be done
+    // on any thread ahead of time, and startSynchronously() then has process() pull samples straight from espeak
+    void prepareSynchronously();
+    void startSynchronously();
+    bool isSinging() const;
+
     void setBendParametersFromState();
     void setOutputBuffer(float* ptr, int numSamples);
     void process();
     EspeakProcessorContext epContext;
     HomerState& homerState;
 
-    bool readyToGo;
-    bool readyToWait;
+    // set by the thread, read by whoever holds it. It's ready to wait once the note is set up, which
+    // in deterministic mode includes having the line's translation
+    std::atomic<bool> readyToGo;
+    std::atomic<bool> readyToWait;
+
+    // 0 synthesizes at the phondata rate (22050), anything else is passed to espeak_ng_SetSampleRate
+    int synthesisSampleRate;
+
+    // passed to espeak_ng_SetSynthesisEngine: 0 harmonic wavegen, 1-5 klatt glottal source, 6 speechPlayer
+    int synthesisEngine;
+
+    // which version of which lyric line this thread was set up to sing, in which voice
+    int lyricLine;
+    int lyricVersion;
+    int voiceIndex;
+
+    // the note's random seed, set before it starts. Only used when the state is deterministic
+    juce::uint32 randSeed;
+
+    // the words and phonemes as the note reaches them, pushed from whichever thread runs espeak
+    VoiceEventQueue events;
+
+    // whether the note records a synthesis trace for a TraceWriter to collect. Set before it's prepared
+    bool traced;
+
+private:
+    void prepareNote();
+    void startNote();
+
+    // how long a deterministic note waits for its line's translation before singing from the text
+    static constexpr int translationTimeoutMs = 2000;
 
+    bool synchronous;
     juce::String language;
     std::string lyrics;
+    PhonemeCache::Translation translation;
 };
 
 #endif //HOMER_ESPEAKTHREAD_H
@@ -4,7 +4,7 @@
 
 #include "HomerProcessor.h"
 
-HomerProcessor::HomerProcessor(HomerState& hs) : samplerate (0), homerState (hs)
+HomerProcessor::HomerProcessor(HomerState& hs) : offline (false), numSpareOfflineNotesPending (0), samplerate (0), noteIndex (0), samplesWithOtherSettings (0), numEspeakThreadsSetUp (0), notePending (false), pendingNoteSeed (0), numLateNotes (0), noteInputPosition (0), noteStageCycles(), homerState (hs)
 {
 }
 HomerProcessor::~HomerProcessor()
@@ -12,16 +12,54 @@ HomerProcessor::~HomerProcessor()
     releaseResources();
 }
 
+void HomerProcessor::setOffline (bool shouldBeOffline)
+{
+    if (shouldBeOffline == offline) {
+        return;
+    }
+    releaseResources();
+    offline = shouldBeOffline;
+    noteIndex = 0;
+    notePending = false;
+    if (!offline && samplerate > 0) {
+        setUpNextEspeakThread();
+    }
+}
+
 void HomerProcessor::prepareToPlay (double fs, int samplesPerBlockExpected)
 {
     resampler.prepareToPlay (fs);
     resampler.setInputSamplerate (22050);
 
     samplerate = static_cast<int>(fs);
-    nextEspeakThread = std::make_unique<EspeakThread> (homerState);
-    setUpNextEspeakThread();
-    currentEspeakThread.reset ();
+    noteIndex = 0;
+    notePending = false;
+    numLateNotes = 0;
+    if (offline) {
+        releaseResources();
+    } else {
+        nextEspeakThread = std::make_unique<EspeakThread> (homerState);
+        setUpNextEspeakThread();
+        currentEspeakThread.reset ();
+    }
     inputBuffer.setSize (1, samplesPerBlockExpected * 2);
+    events.reserve (VoiceEventQueue::capacity);
+    pendingEvents.reserve (VoiceEventQueue::capacity);
+}
+
+bool HomerProcessor::startTrace (const juce::File& file)
+{
+    traceWriter = std::make_unique<TraceWriter> (file);
+    if (!traceWriter->openedOk()) {
+        traceWriter.reset();
+        return false;
+    }
+    return true;
+}
+
+void HomerProcessor::stopTrace()
+{
+    traceWriter.reset();
 }
 
 void HomerProcessor::setText (const juce::String& text)
@@ -30,33 +68,90 @@ void HomerProcessor::setText (const juce::String& text)
 
 void HomerProcessor::processBlock (juce::AudioSampleBuffer& buffer, unsigned int startSample, unsigned int numSamples, bool startNewNote)
 {
-    resetNextEspeakThreadIfNeeded();
+    resetNextEspeakThreadIfNeeded (static_cast<int> (numSamples));
+    events.clear();
 
     jassert (startSample + numSamples <= buffer.getNumSamples());
 
     auto speedDuck = 1 - 4 * homerState.peakLevel * *homerState.clockCurrentStealing;
     speedDuck = std::max (speedDuck, 0.1f);
 
-    resampler.setInputSamplerate (*homerState.clockSpeed * speedDuck);
-    resampler.setAliasingAmount (*homerState.amountOfAliasing);
     auto ptr = buffer.getWritePointer(0) + startSample;
 
-    if ((startNewNote || homerState.killParam->get()) && currentEspeakThread && currentEspeakThread->isThreadRunning()) {
-        currentEspeakThread->endNote();
+    if ((startNewNote || homerState.killParam->get()) && currentEspeakThread && currentEspeakThread->isSinging()) {
+        if (offline) {
+            // nothing else is inside a synchronous note's espeak, so it can just go
+            currentEspeakThread.reset();
+        } else {
+            currentEspeakThread->endNote();
+        }
+    }
+    if (homerState.killParam->get()) {
+        notePending = false;
     }
 
     if (startNewNote) {
+        // the last note's tail was ramped out before this, and whatever the resampler still held of
+        // it would depend on where the blocks fell
+        resampler.reset();
+        pendingEvents.clear();
+        noteInputPosition = 0;
+        noteStageCycles.fill (0);
+    }
+
+    if (startNewNote && offline) {
+        currentEspeakThread = startOfflineNote (getNoteSeed());
+        ++noteIndex;
+    } else if (startNewNote && homerState.deterministic && !isReadyForNote()) {
+        // a thread still being set up can't be checked yet, and may be waiting for its line's translation.
+        // Singing it anyway, or the last line, would leave which lyric the note gets down to timing, so
+        // the note keeps its seed and waits, silent, for a thread that's ready
+        currentEspeakThread.reset();
+        pendingNoteSeed = getNoteSeed();
+        notePending = true;
+        ++noteIndex;
+        ++numLateNotes;
+    } else if (startNewNote || (notePending && !offline && isReadyForNote())) {
         currentEspeakThread = std::move(nextEspeakThread);
         setUpNextEspeakThread();
         jassert (currentEspeakThread);
         jassert (currentEspeakThread->isThreadRunning());
 
+        // read when the thread starts the note, which it doesn't until it's notified
+        currentEspeakThread->randSeed = startNewNote ? getNoteSeed() : pendingNoteSeed;
+        if (startNewNote) {
+            ++noteIndex;
+        }
+        notePending = false;
         while (!currentEspeakThread->readyToGo) {
             currentEspeakThread->notify();
         }
     }
 
-    if (currentEspeakThread && currentEspeakThread->isThreadRunning()) {
+    if (currentEspeakThread && currentEspeakThread->isSinging()) {
+        // a thread that was set up at the host rate is already there when the clock is at its default.
+        // if the clock gets moved during the note, we still resample, just from the higher rate.
+        auto synthesisRate = currentEspeakThread->synthesisSampleRate > 0 ? currentEspeakThread->synthesisSampleRate : espeakSampleRate;
+        auto clockRatio = *homerState.clockSpeed * speedDuck / espeakSampleRate;
+
+        if (synthesisRate == samplerate && clockRatio == 1 && *homerState.amountOfAliasing == 0) {
+            juce::FloatVectorOperations::clear (ptr, static_cast<int> (numSamples));
+            currentEspeakThread->setOutputBuffer (ptr, static_cast<int> (numSamples));
+            currentEspeakThread->setBendParametersFromState();
+            processNote();
+            collectEvents (startSample, static_cast<int> (numSamples), false);
+            noteInputPosition += numSamples;
+
+            for (int channel = 1; channel < buffer.getNumChannels(); ++channel) {
+                buffer.copyFrom (channel, startSample, ptr, numSamples);
+            }
+            return;
+        }
+
+        resampler.setInputSamplerate (synthesisRate * clockRatio);
+        resampler.setAliasingAmount (*homerState.amountOfAliasing);
+        resampler.setMode (homerState.cleanResamplingParam->get() ? Resampler::Mode::polyphase : Resampler::Mode::lofi);
+
         inputBuffer.clear();
         auto numInputSamples = resampler.getNumSamplesNeeded (numSamples);
         if (numInputSamples > inputBuffer.getNumSamples()) {
@@ -67,18 +162,102 @@ void HomerProcessor::processBlock (juce::AudioSampleBuffer& buffer, unsigned int
 
         currentEspeakThread->setBendParametersFromState();
 
-        currentEspeakThread->process();
+        processNote();
+        collectEvents (startSample, static_cast<int> (numSamples), true);
+        noteInputPosition += numInputSamples;
 
-        resampler.resampleIntoBuffer (ptr, numSamples, inputBuffer.getReadPointer (0), numInputSamples);
+        {
+            const ScopedStageTimer timer (homerState.stageTimings, StageTimings::Stage::resample);
+            resampler.resampleIntoBuffer (ptr, numSamples, inputBuffer.getReadPointer (0), numInputSamples);
+        }
 
         for (int channel = 1; channel < buffer.getNumChannels(); ++channel) {
             buffer.copyFrom (channel, startSample, ptr, numSamples);
         }
+    } else if (currentEspeakThread) {
+        // a thread that filled its last block exactly passes the note's end on after handing it over
+        collectEvents (startSample, static_cast<int> (numSamples), false);
+    }
+}
+
+void HomerProcessor::processNote()
+{
+    auto start = StageTimings::now();
+    currentEspeakThread->process();
+    auto cycles = StageTimings::now() - start;
+
+    // espeak counts its own stages, on whichever thread runs it. A stage's time is only counted once
+    // it's left, so a block can get some of the one before's, but it all adds up over the note
+    std::array<juce::uint64, espeakSTAGE_COUNT> stageCycles;
+    espeak_ng_GetStageCycles (&currentEspeakThread->epContext, stageCycles.data());
+    constexpr std::pair<int, StageTimings::Stage> espeakStages[] {
+        { espeakSTAGE_TRANSLATE, StageTimings::Stage::translate },
+        { espeakSTAGE_GENERATE, StageTimings::Stage::generate },
+        { espeakSTAGE_WAVEGEN, StageTimings::Stage::wavegen },
+    };
+    juce::uint64 espeakCycles = 0;
+    for (auto [espeakStage, stage] : espeakStages) {
+        auto delta = stageCycles[static_cast<size_t> (espeakStage)] - noteStageCycles[static_cast<size_t> (espeakStage)];
+        // translating and generating only happen now and then, and the blocks they don't aren't counted
+        if (delta > 0) {
+            homerState.stageTimings.add (stage, delta);
+        }
+        espeakCycles += delta;
+    }
+    noteStageCycles = stageCycles;
+
+    // an offline note runs right here, so there's nothing handed off
+    if (!offline) {
+        homerState.stageTimings.add (StageTimings::Stage::handoff, cycles > espeakCycles ? cycles - espeakCycles : 0);
+    }
+}
+
+void HomerProcessor::collectEvents (unsigned int startSample, int numSamples, bool resampled)
+{
+    // the trace goes the same way as the events, just on to a file
+    if (traceWriter) {
+        traceWriter->collect (currentEspeakThread->epContext);
+    }
+
+    // past the sizes reserved in prepareToPlay, events are dropped rather than allocated for
+    currentEspeakThread->events.popAll ([this] (const VoiceEvent& event) {
+        if (pendingEvents.size() < pendingEvents.capacity()) {
+            pendingEvents.push_back (event);
+        }
+    });
+
+    // the ones heard in this block go out. The resampler has to be asked where before resampleIntoBuffer moves it on
+    auto stillPending = pendingEvents.begin();
+    for (auto& event : pendingEvents) {
+        constexpr juce::int64 farAway = std::numeric_limits<int>::max() / 2;
+        auto inputSample = static_cast<int> (juce::jlimit (-farAway, farAway, event.sample - noteInputPosition));
+        auto offset = resampled ? resampler.getOutputSampleFor (inputSample, numSamples) : std::max (0, inputSample);
+        if (offset < numSamples && events.size() < events.capacity()) {
+            event.offset = static_cast<int> (startSample) + offset;
+            events.push_back (event);
+        } else {
+            *stillPending++ = event;
+        }
     }
+    pendingEvents.erase (stillPending, pendingEvents.end());
 }
 
 void HomerProcessor::releaseResources()
 {
+    if (offlinePool) {
+        // the pool is shared, so wait for this instance's jobs rather than removing everyone's
+        for (;;) {
+            const juce::SpinLock::ScopedLockType sl (spareOfflineNotesLock);
+            if (numSpareOfflineNotesPending == 0) {
+                break;
+            }
+            const juce::SpinLock::ScopedUnlockType sul (spareOfflineNotesLock);
+            juce::Thread::sleep (1);
+        }
+        offlinePool.reset();
+    }
+    spareOfflineNotes.clear();
+
     while (currentEspeakThread && currentEspeakThread->isThreadRunning()) {
         currentEspeakThread->endNote();
     }
@@ -94,15 +273,157 @@ void HomerProcessor::setUpNextEspeakThread()
         nextEspeakThread->endNote();
     }
     nextEspeakThread = std::make_unique<EspeakThread> (homerState);
+    ++numEspeakThreadsSetUp;
+    samplesWithOtherSettings = 0;
+    nextEspeakThread->synthesisSampleRate = getDesiredSynthesisRate();
+    nextEspeakThread->synthesisEngine = getDesiredSynthesisEngine();
+    nextEspeakThread->traced = traceWriter != nullptr;
     auto threadStarted = nextEspeakThread->startThread();
     jassert (threadStarted);
 }
 
-void HomerProcessor::resetNextEspeakThreadIfNeeded()
+void HomerProcessor::resetNextEspeakThreadIfNeeded (int numSamples)
 {
-    if (nextEspeakThread && nextEspeakThread->isThreadRunning() && nextEspeakThread->readyToWait &&
-        (nextEspeakThread->language != homerState.voiceNames[*homerState.languageSelectors[*homerState.lyricSelector - 1]] ||
-        nextEspeakThread->lyrics != homerState.lyrics[*homerState.lyricSelector - 1].toStdString())) {
+    if (!nextEspeakThread || !nextEspeakThread->isThreadRunning() || !nextEspeakThread->readyToWait) {
+        return;
+    }
+    if (!isSetUpForCurrentLine (*nextEspeakThread)) {
+        setUpNextEspeakThread();
+        return;
+    }
+
+    // automation can take the engine, or the rate with the clock and aliasing, back and forth, and each
+    // new thread is started from here, so new settings are only set up for once they've held a while.
+    // Until then a note gets the old ones, which still sing right, the rate going through the resampler
+    if (isSetUpForCurrentSettings (*nextEspeakThread)) {
+        samplesWithOtherSettings = 0;
+    } else if ((samplesWithOtherSettings += numSamples) >= samplerate / 1000 * settingsSettleMs) {
         setUpNextEspeakThread();
     }
-}
\ No newline at end of file
+}
+
+bool HomerProcessor::isReadyForNote()
+{
+    if (offline) {
+        return samplerate > 0;
+    }
+    // a note waiting on it has nothing to gain from letting the settings settle
+    resetNextEspeakThreadIfNeeded (samplerate / 1000 * settingsSettleMs);
+    return nextEspeakThread && nextEspeakThread->readyToWait && isSetUpForCurrentLyric (*nextEspeakThread);
+}
+
+bool HomerProcessor::isSetUpForCurrentLyric (const EspeakThread& espeakThread) const
+{
+    return isSetUpForCurrentLine (espeakThread) && isSetUpForCurrentSettings (espeakThread);
+}
+
+bool HomerProcessor::isSetUpForCurrentLine (const EspeakThread& espeakThread) const
+{
+    // only integers are compared here, the lyric itself is picked up by the thread
+    auto lyricLine = *homerState.lyricSelector - 1;
+    return espeakThread.lyricLine == lyricLine &&
+        espeakThread.lyricVersion == homerState.phonemeCache.getVersion (lyricLine) &&
+        espeakThread.voiceIndex == homerState.languageSelectors[static_cast<size_t> (lyricLine)]->getIndex();
+}
+
+bool HomerProcessor::isSetUpForCurrentSettings (const EspeakThread& espeakThread) const
+{
+    return espeakThread.synthesisSampleRate == getDesiredSynthesisRate() &&
+        espeakThread.synthesisEngine == getDesiredSynthesisEngine();
+}
+
+int HomerProcessor::getDesiredSynthesisRate() const
+{
+    // with the clock at its default and no aliasing, the resampler would only be upsampling cleanly,
+    // so have espeak synthesize at the host rate and skip it altogether.
+    // Only the harmonic wavegen follows the rate, klatt mixes its consonants and speechPlayer runs at 22050.
+    if (getDesiredSynthesisEngine() == 0 && samplerate > espeakSampleRate &&
+        *homerState.clockSpeed >= espeakSampleRate && *homerState.amountOfAliasing == 0) {
+        return samplerate;
+    }
+    return 0;
+}
+
+int HomerProcessor::getDesiredSynthesisEngine() const
+{
+    // engine choices in espeak_ng_SetSynthesisEngine numbering, klatt uses the impulsive glottal source
+    constexpr std::array<int, 3> engines { 0, 1, 6 };
+    return engines[static_cast<size_t> (homerState.engine->getIndex())];
+}
+
+std::unique_ptr<EspeakThread> HomerProcessor::prepareOfflineNote()
+{
+    auto note = std::make_unique<EspeakThread> (homerState);
+    note->synthesisSampleRate = getDesiredSynthesisRate();
+    note->synthesisEngine = getDesiredSynthesisEngine();
+    note->traced = traceWriter != nullptr;
+    note->prepareSynchronously();
+    return note;
+}
+
+juce::uint32 HomerProcessor::getNoteSeed() const
+{
+    // splitmix64's finaliser over the session seed, the note's index and its line, so neighbouring
+    // notes and lines get unrelated seeds
+    auto line = static_cast<juce::uint64> (*homerState.lyricSelector - 1);
+    auto x = (static_cast<juce::uint64> (homerState.sessionSeed.load()) << 32)
+        ^ (static_cast<juce::uint64> (static_cast<juce::uint32> (noteIndex)) << 8) ^ line;
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return static_cast<juce::uint32> (x);
+}
+
+std::unique_ptr<EspeakThread> HomerProcessor::startOfflineNote (juce::uint32 randSeed)
+{
+    // a spare that was set up for something else, or for an older version of the line, is thrown away,
+    // and if none of them fits the note is set up right here rather than waiting for one
+    std::unique_ptr<EspeakThread> note;
+    std::vector<std::unique_ptr<EspeakThread>> staleNotes;
+    {
+        const juce::SpinLock::ScopedLockType sl (spareOfflineNotesLock);
+        for (auto& spare : spareOfflineNotes) {
+            if (note == nullptr && isSetUpForCurrentLyric (*spare)) {
+                note = std::move (spare);
+            } else {
+                staleNotes.push_back (std::move (spare));
+            }
+        }
+        spareOfflineNotes.clear();
+    }
+    staleNotes.clear();
+
+    if (note == nullptr) {
+        note = prepareOfflineNote();
+    }
+    note->randSeed = randSeed;
+    note->startSynchronously();
+    topUpSpareOfflineNotes();
+    return note;
+}
+
+void HomerProcessor::topUpSpareOfflineNotes()
+{
+    if (offlinePool == nullptr) {
+        offlinePool = std::make_unique<juce::SharedResourcePointer<OfflinePool>>();
+    }
+
+    int numNotesToSetUp;
+    {
+        const juce::SpinLock::ScopedLockType sl (spareOfflineNotesLock);
+        auto numSpareOfflineNotes = std::min ((*offlinePool)->getNumThreads(), maxSpareOfflineNotes);
+        numNotesToSetUp = numSpareOfflineNotes - static_cast<int> (spareOfflineNotes.size()) - numSpareOfflineNotesPending;
+        numSpareOfflineNotesPending += std::max (0, numNotesToSetUp);
+    }
+
+    // setting a note up is mostly loading espeak's data, which doesn't depend on anything the note plays
+    for (; numNotesToSetUp > 0; --numNotesToSetUp) {
+        (*offlinePool)->addJob ([this] {
+            auto note = prepareOfflineNote();
+            const juce::SpinLock::ScopedLockType sl (spareOfflineNotesLock);
+            spareOfflineNotes.push_back (std::move (note));
+            --numSpareOfflineNotesPending;
+        });
+    }
+}
@@ -9,6 +9,7 @@
 #include "../state/HomerState.h"
 #include "EspeakThread.h"
 #include "Resampler.h"
+#include "TraceWriter.h"
 
 class HomerProcessor
 {
@@ -19,14 +20,85 @@ public:
     void setText(const juce::String &text);
     void processBlock(juce::AudioSampleBuffer &buffer, unsigned int startSample, unsigned int numSamples, bool startNewNote);
     void releaseResources();
+
+    // when the host renders offline, notes are synthesized on the calling thread instead of handing each
+    // block to an espeak thread and waiting, while spare notes are set up on the other cores
+    void setOffline(bool shouldBeOffline);
+    bool isOffline() const { return offline; }
+
+    // the words, sentences and phonemes heard in the last processBlock, in order, with the offsets they're
+    // heard at after resampling. Held to a size set in prepareToPlay
+    const std::vector<VoiceEvent>& getEvents() const { return events; }
+
+    // traces the synthesis of every note from here on into file, until stopTrace(). Call them before
+    // prepareToPlay or setOffline, the notes already set up aren't traced
+    bool startTrace (const juce::File& file);
+    void stopTrace();
+
+    // whether a note started now would sing straight away. A deterministic real time note whose thread
+    // isn't set up for the current lyric yet starts at the top of the first block after it is, so the
+    // audio thread never waits on a translation. Call it from the thread that calls processBlock
+    bool isReadyForNote();
+
+    // deterministic real time notes that started late like that, since prepareToPlay
+    int getNumLateNotes() const { return numLateNotes.load(); }
+
+    // threads set up for the next real time note, each one started from processBlock or prepareToPlay
+    int getNumEspeakThreadsSetUp() const { return numEspeakThreadsSetUp; }
+
+    static constexpr int espeakSampleRate = 22050;
 private:
     void setUpNextEspeakThread();
-    void resetNextEspeakThreadIfNeeded();
+    void resetNextEspeakThreadIfNeeded (int numSamples);
+    bool isSetUpForCurrentLyric(const EspeakThread& espeakThread) const;
+    bool isSetUpForCurrentLine (const EspeakThread& espeakThread) const;
+    bool isSetUpForCurrentSettings (const EspeakThread& espeakThread) const;
+    int getDesiredSynthesisRate() const;
+    int getDesiredSynthesisEngine() const;
+    std::unique_ptr<EspeakThread> prepareOfflineNote();
+    std::unique_ptr<EspeakThread> startOfflineNote (juce::uint32 randSeed);
+    juce::uint32 getNoteSeed() const;
+    void topUpSpareOfflineNotes();
+    void collectEvents (unsigned int startSample, int numSamples, bool resampled);
+    void processNote();
     juce::AudioBuffer<float> inputBuffer;
     std::unique_ptr<EspeakThread> currentEspeakThread;
     std::unique_ptr<EspeakThread> nextEspeakThread;
+
+    // one pool for every instance that's offline at once, so a batch of them shares the cores
+    struct OfflinePool : juce::ThreadPool
+    {
+        OfflinePool() : juce::ThreadPool (std::max (1, juce::SystemStats::getNumCpus() - 1)) {}
+    };
+    // one spare per thread in the pool, but each holds a loaded espeak context so not too many
+    static constexpr int maxSpareOfflineNotes = 8;
+
+    bool offline;
+    std::unique_ptr<juce::SharedResourcePointer<OfflinePool>> offlinePool;
+    juce::SpinLock spareOfflineNotesLock;
+    std::vector<std::unique_ptr<EspeakThread>> spareOfflineNotes;
+    int numSpareOfflineNotesPending;
+
     int samplerate;
+    // notes started since prepareToPlay or going on or offline, for seeding deterministic notes
+    int noteIndex;
+    // how long the next thread's rate or engine has been out of date, see resetNextEspeakThreadIfNeeded
+    static constexpr int settingsSettleMs = 100;
+    int samplesWithOtherSettings;
+    int numEspeakThreadsSetUp;
+    // a deterministic real time note waiting for its thread, with the seed it got when it was played
+    bool notePending;
+    juce::uint32 pendingNoteSeed;
+    std::atomic<int> numLateNotes;
     Resampler resampler;
+    std::vector<VoiceEvent> events;
+    // events the note got to before they're heard, mostly ones the resampler's latency holds back
+    std::vector<VoiceEvent> pendingEvents;
+    // samples the note has made at its synthesis rate, up to the start of the block
+    juce::int64 noteInputPosition;
+    std::unique_ptr<TraceWriter> traceWriter;
+    // the note's espeak_ng_GetStageCycles() as of the last block, so each block adds what it took
+    std::array<juce::uint64, espeakSTAGE_COUNT> noteStageCycles;
     HomerState& homerState;
 };
 
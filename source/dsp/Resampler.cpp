@@ -6,8 +6,55 @@
 
 #include "juce_dsp/juce_dsp.h"
 
-Resampler::Resampler() : position (0), increment (0), realSampleRate (0), prevSample (0), prev2Sample (0), inputSampleRate (0), aliasingAmount (0)
+namespace
 {
+    // The input rate is clamped to the host rate, so we only ever upsample. That means the anti-imaging filter
+    // lives in input-sample time and a single bank covers 22050 -> 44.1k, 48k, 96k, and every clock speed in between;
+    // the ratio only changes which phases we visit.
+    struct PolyphaseBank
+    {
+        static constexpr int taps = Resampler::polyphaseTaps;
+        static constexpr int phases = Resampler::polyphasePhases;
+
+        PolyphaseBank()
+        {
+            constexpr auto halfTaps = taps / 2;
+            constexpr auto cutoff = 0.9; // relative to the input nyquist
+            constexpr auto pi = juce::MathConstants<double>::pi;
+
+            // one extra row (fraction == 1) so we can always interpolate between row n and row n + 1
+            for (int phase = 0; phase <= phases; ++phase) {
+                auto fraction = static_cast<double> (phase) / phases;
+                auto* row = coefficients.data() + phase * taps;
+                double sum = 0;
+                for (int tap = 0; tap < taps; ++tap) {
+                    // distance from this tap to the output point, in input samples
+                    auto x = halfTaps - 1 - tap + fraction;
+                    auto sinc = x == 0 ? 1.0 : std::sin (pi * cutoff * x) / (pi * cutoff * x);
+                    auto w = (x + halfTaps) / (2.0 * halfTaps);
+                    auto window = 0.35875 - 0.48829 * std::cos (2 * pi * w) + 0.14128 * std::cos (4 * pi * w) - 0.01168 * std::cos (6 * pi * w);
+                    row[tap] = static_cast<float> (sinc * window);
+                    sum += row[tap];
+                }
+                for (int tap = 0; tap < taps; ++tap) {
+                    row[tap] = static_cast<float> (row[tap] / sum);
+                }
+            }
+        }
+
+        alignas (64) std::array<float, (phases + 1) * taps> coefficients {};
+    };
+
+    const PolyphaseBank& getPolyphaseBank()
+    {
+        static const PolyphaseBank bank;
+        return bank;
+    }
+}
+
+Resampler::Resampler() : mode (Mode::lofi), position (0), increment (0), realSampleRate (0), prevSample (0), prev2Sample (0), inputSampleRate (0), aliasingAmount (0), historyIndex (0)
+{
+    history.fill (0);
 }
 Resampler::~Resampler()
 {
@@ -19,9 +66,18 @@ void Resampler::prepareToPlay (double realfs)
     }
     realSampleRate = realfs;
     increment = 1;
+    reset();
+
+    // build the bank here rather than on the first polyphase block
+    getPolyphaseBank();
+}
+void Resampler::reset()
+{
     position = 0.5;
     prevSample = 0;
     prev2Sample = 0;
+    history.fill (0);
+    historyIndex = 0;
 }
 void Resampler::setInputSamplerate (float fs)
 {
@@ -32,6 +88,14 @@ void Resampler::setAliasingAmount (float amount)
 {
     aliasingAmount = amount;
 }
+void Resampler::setMode (Mode newMode)
+{
+    mode = newMode;
+}
+Resampler::Mode Resampler::getMode() const
+{
+    return mode;
+}
 float Resampler::interpolate (float a, float b, float x) const
 {
     jassert (0 <= x);
@@ -55,9 +119,81 @@ float Resampler::interpolate (float a, float b, float x) const
     return a * exp (-x * 10 * (scaledAliasingAmount - 0.5));
 }
 
+float Resampler::polyphaseInterpolate (float x) const
+{
+    jassert (0 <= x);
+    jassert (x <= 1);
+
+    const auto& bank = getPolyphaseBank();
+    auto phase = x * polyphasePhases;
+    auto phaseIndex = std::min (static_cast<int> (phase), polyphasePhases - 1);
+    auto phaseFraction = phase - static_cast<float> (phaseIndex);
+
+    // oldest sample first. the newest sample is at the end of the window, so the output
+    // runs polyphaseTaps / 2 - 1 input samples behind the lofi path.
+    const auto* window = history.data() + historyIndex + 1;
+    const auto* row = bank.coefficients.data() + phaseIndex * polyphaseTaps;
+    const auto* nextRow = row + polyphaseTaps;
+
+    // fixed trip count and no dependencies between lanes, so this vectorizes
+    float a = 0;
+    float b = 0;
+    for (int tap = 0; tap < polyphaseTaps; ++tap) {
+        a += window[tap] * row[tap];
+        b += window[tap] * nextRow[tap];
+    }
+    return a + (b - a) * phaseFraction;
+}
+
+void Resampler::pushSample (float sample)
+{
+    prev2Sample = prevSample;
+    prevSample = sample;
+
+    historyIndex = (historyIndex + 1) % polyphaseTaps;
+    history[historyIndex] = sample;
+    history[historyIndex + polyphaseTaps] = sample;
+}
+
 int Resampler::getNumSamplesNeeded (int bufferLength) const
 {
-    return floor(bufferLength * increment + position);
+    // steps the position the way resampleIntoBuffer will, rather than multiplying, so the count is exactly
+    // what it takes. Rounding the other way now and then would drop or repeat a sample, and where that
+    // happened would depend on the block size
+    auto p = position;
+    int needed = 0;
+    for (int i = 0; i < bufferLength; ++i) {
+        p = p + increment;
+        while (p >= 1) {
+            p -= 1;
+            ++needed;
+        }
+    }
+    return needed;
+}
+
+int Resampler::getOutputSampleFor (int inputSample, int bufferLength) const
+{
+    // lofi glides from the sample before last to the last one, so a sample is reached once the one after
+    // it is in. polyphase is centred another polyphaseTaps / 2 - 1 samples back
+    auto latency = mode == Mode::polyphase ? polyphaseTaps / 2 : 1;
+    if (inputSample + latency < 0) {
+        // it was in an earlier block's source, and reached before this block
+        return 0;
+    }
+    auto p = position;
+    int pushed = 0;
+    for (int i = 0; i < bufferLength; ++i) {
+        p = p + increment;
+        while (p >= 1) {
+            p -= 1;
+            if (pushed++ == inputSample + latency) {
+                // it's pushed after output i is made
+                return i + 1;
+            }
+        }
+    }
+    return bufferLength;
 }
 
 void Resampler::resampleIntoBuffer (float* destination, int destinationLength, const float* source, int sourceLength)
@@ -65,12 +201,15 @@ void Resampler::resampleIntoBuffer (float* destination, int destinationLength, c
     int sourceI = 0;
     int destinationI = 0;
     for (destinationI = 0; destinationI < destinationLength; destinationI++) {
-        destination[destinationI] = interpolate(prev2Sample, prevSample, position);
+        if (mode == Mode::polyphase) {
+            destination[destinationI] = polyphaseInterpolate (position);
+        } else {
+            destination[destinationI] = interpolate(prev2Sample, prevSample, position);
+        }
         position = position + increment;
         while (position >= 1) {
             position -= 1;
-            prev2Sample = prevSample;
-            prevSample = source[sourceI];
+            pushSample (source[sourceI]);
             sourceI++;
             // jassert (sourceI < sourceLength);
         }
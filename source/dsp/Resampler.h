@@ -5,22 +5,43 @@
 #ifndef HOMER_RESAMPLER_H
 #define HOMER_RESAMPLER_H
 #include "juce_audio_basics/juce_audio_basics.h"
+#include <array>
 
 class Resampler
 {
 public:
+    enum class Mode
+    {
+        lofi,       // linear / zero order hold / decay blend, controlled by the aliasing amount
+        polyphase   // windowed sinc, no imaging. ignores the aliasing amount.
+    };
+
+    static constexpr int polyphaseTaps = 32;
+    static constexpr int polyphasePhases = 128;
+
     Resampler();
     ~Resampler();
 
     void prepareToPlay(double realSampleRate);
+    // forgets the samples it has seen and where it was between them, so the next note starts the same way every time
+    void reset();
     void setInputSamplerate(float fs);
     void setAliasingAmount(float amount);
+    void setMode(Mode newMode);
+    Mode getMode() const;
     int getNumSamplesNeeded(int bufferLength) const;
+    // which of the next bufferLength output samples the input sample at inputSample of the next block's
+    // source is first heard on, after the interpolation's latency. inputSample is negative for samples of
+    // earlier blocks, and it's bufferLength when the sample isn't heard until a later block
+    int getOutputSampleFor(int inputSample, int bufferLength) const;
     void resampleIntoBuffer(float* destination, int destinationLength, const float* source, int sourceLength);
     void releaseResources();
 private:
     float interpolate(float a, float b, float x) const;
+    float polyphaseInterpolate(float x) const;
+    void pushSample(float sample);
 
+    Mode mode;
     float aliasingAmount;
     float position;
     float increment;
@@ -28,6 +49,10 @@ private:
     float realSampleRate;
     float prevSample;
     float prev2Sample;
+
+    // every sample is written twice, so the last polyphaseTaps samples are always contiguous
+    std::array<float, 2 * polyphaseTaps> history;
+    int historyIndex;
 };
 
 #endif //HOMER_RESAMPLER_H
@@ -0,0 +1,59 @@
+#include "TraceWriter.h"
+#include "espeak-ng/espeak_ng.h"
+
+TraceWriter::TraceWriter (const juce::File& file) : Thread ("TraceWriter"), records (static_cast<size_t> (capacity))
+{
+    stream = file.createOutputStream();
+    if (stream == nullptr || stream->failedToOpen()) {
+        stream.reset();
+        return;
+    }
+    stream->setPosition (0);
+    stream->truncate();
+    stream->writeInt (static_cast<int> (magic));
+    stream->writeInt (static_cast<int> (version));
+    stream->writeInt (static_cast<int> (sizeof (espeak_TRACE_RECORD)));
+    startThread();
+}
+
+TraceWriter::~TraceWriter()
+{
+    stopThread (1000);
+    if (stream != nullptr) {
+        writeReady();
+        stream->flush();
+    }
+}
+
+void TraceWriter::collect (EspeakProcessorContext& context)
+{
+    if (stream == nullptr) {
+        return;
+    }
+    int start1, size1, start2, size2;
+    fifo.prepareToWrite (fifo.getFreeSpace(), start1, size1, start2, size2);
+    auto numRead = espeak_ng_ReadTrace (&context, records.data() + start1, size1);
+    if (numRead == size1 && size2 > 0) {
+        numRead += espeak_ng_ReadTrace (&context, records.data() + start2, size2);
+    }
+    fifo.finishedWrite (numRead);
+}
+
+void TraceWriter::run()
+{
+    while (!threadShouldExit()) {
+        writeReady();
+        wait (50);
+    }
+}
+
+void TraceWriter::writeReady()
+{
+    const auto scope = fifo.read (fifo.getNumReady());
+    if (scope.blockSize1 > 0) {
+        stream->write (records.data() + scope.startIndex1, static_cast<size_t> (scope.blockSize1) * sizeof (espeak_TRACE_RECORD));
+    }
+    if (scope.blockSize2 > 0) {
+        stream->write (records.data() + scope.startIndex2, static_cast<size_t> (scope.blockSize2) * sizeof (espeak_TRACE_RECORD));
+    }
+}
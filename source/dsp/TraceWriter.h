@@ -0,0 +1,37 @@
+#ifndef HOMER_TRACEWRITER_H
+#define HOMER_TRACEWRITER_H
+
+#include "juce_core/juce_core.h"
+
+#include <espeak-ng/speak_lib.h>
+#include <vector>
+
+// writes the synthesis traces of the notes to a file, on a thread of its own. The file starts with magic,
+// version and recordSize as 32 bit ints, then it's espeak_TRACE_RECORDs as they are in memory, each note's
+// starting with its espeakTRACE_START. analysis_and_graphs/homer_trace.py reads it.
+class TraceWriter : private juce::Thread
+{
+public:
+    static constexpr juce::uint32 magic = 0x52544d48; // "HMTR"
+    static constexpr juce::uint32 version = 1;
+    static constexpr int capacity = 8192;
+
+    explicit TraceWriter (const juce::File& file);
+    ~TraceWriter() override;
+
+    bool openedOk() const { return stream != nullptr; }
+
+    // takes whatever the note has traced since the last call, from the thread driving its synthesis. Nothing
+    // is allocated or written here, and whatever doesn't fit waits in the note's ring
+    void collect (EspeakProcessorContext& context);
+
+private:
+    void run() override;
+    void writeReady();
+
+    juce::AbstractFifo fifo { capacity };
+    std::vector<espeak_TRACE_RECORD> records;
+    std::unique_ptr<juce::FileOutputStream> stream;
+};
+
+#endif //HOMER_TRACEWRITER_H
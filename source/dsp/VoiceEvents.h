@@ -0,0 +1,68 @@
+#ifndef HOMER_VOICEEVENTS_H
+#define HOMER_VOICEEVENTS_H
+
+#include "juce_core/juce_core.h"
+
+#include <array>
+#include <atomic>
+
+// a word, sentence or phoneme that a note starts singing, and where
+struct VoiceEvent
+{
+    enum class Type : juce::uint8 { word, sentence, phoneme, end };
+    // espeak_PHONEME_CLASS, in the same order
+    enum class PhonemeClass : juce::uint8 { silent, vowel, liquid, stop, fricative, nasal };
+
+    Type type = Type::word;
+    // in samples at the note's synthesis rate, from the start of the note
+    juce::int64 sample = 0;
+    // set by HomerProcessor: the sample of the buffer passed to processBlock that the event is heard on
+    int offset = 0;
+    // where the word is in the lyric, for words and sentences
+    int textPosition = 0;
+    int length = 0;
+    // espeak's name for a phoneme, padded with zeros, and the kind of sound it makes
+    std::array<char, 8> phoneme {};
+    PhonemeClass phonemeClass = PhonemeClass::silent;
+};
+
+// carries a note's events from espeak to the processor: one thread pushes and one pops, with no
+// locks and nothing allocated, so it's fine on the audio thread and on espeak's thread while the
+// audio thread waits for it. It holds capacity events, and when it's full pushing drops the new
+// one, keeping the ones already waiting, and counts it.
+class VoiceEventQueue
+{
+public:
+    static constexpr int capacity = 256;
+
+    bool push (const VoiceEvent& event)
+    {
+        const auto scope = fifo.write (1);
+        if (scope.blockSize1 + scope.blockSize2 == 0) {
+            numDropped.fetch_add (1, std::memory_order_relaxed);
+            return false;
+        }
+        events[static_cast<size_t> (scope.blockSize1 > 0 ? scope.startIndex1 : scope.startIndex2)] = event;
+        return true;
+    }
+
+    template <typename Callback>
+    void popAll (Callback&& callback)
+    {
+        const auto scope = fifo.read (fifo.getNumReady());
+        scope.forEach ([this, &callback] (int index) { callback (events[static_cast<size_t> (index)]); });
+    }
+
+    int getNumReady() const { return fifo.getNumReady(); }
+
+    // events that didn't fit, since the queue was made
+    int getNumDropped() const { return numDropped.load (std::memory_order_relaxed); }
+
+private:
+    // an AbstractFifo keeps one slot empty to tell full from empty
+    juce::AbstractFifo fifo { capacity + 1 };
+    std::array<VoiceEvent, capacity + 1> events;
+    std::atomic<int> numDropped { 0 };
+};
+
+#endif //HOMER_VOICEEVENTS_H
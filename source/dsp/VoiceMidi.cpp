@@ -0,0 +1,45 @@
+#include "VoiceMidi.h"
+
+void VoiceMidi::addEvents (const std::vector<VoiceEvent>& events, juce::MidiBuffer& midi)
+{
+    for (auto& event : events) {
+        switch (event.type) {
+            case VoiceEvent::Type::word:
+                startNote (heldWordNote, wordNote, midi, event.offset);
+                break;
+            case VoiceEvent::Type::phoneme:
+                if (event.phonemeClass == VoiceEvent::PhonemeClass::silent) {
+                    stopNote (heldPhonemeNote, midi, event.offset);
+                } else {
+                    startNote (heldPhonemeNote, phonemeNoteBase + static_cast<int> (event.phonemeClass) - 1, midi, event.offset);
+                }
+                break;
+            case VoiceEvent::Type::end:
+                allNotesOff (midi, event.offset);
+                break;
+            case VoiceEvent::Type::sentence:
+                break;
+        }
+    }
+}
+
+void VoiceMidi::allNotesOff (juce::MidiBuffer& midi, int sample)
+{
+    stopNote (heldPhonemeNote, midi, sample);
+    stopNote (heldWordNote, midi, sample);
+}
+
+void VoiceMidi::startNote (int& heldNote, int note, juce::MidiBuffer& midi, int sample)
+{
+    stopNote (heldNote, midi, sample);
+    midi.addEvent (juce::MidiMessage::noteOn (channel, note, velocity), sample);
+    heldNote = note;
+}
+
+void VoiceMidi::stopNote (int& heldNote, juce::MidiBuffer& midi, int sample)
+{
+    if (heldNote >= 0) {
+        midi.addEvent (juce::MidiMessage::noteOff (channel, heldNote), sample);
+        heldNote = -1;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef HOMER_VOICEMIDI_H
+#define HOMER_VOICEMIDI_H
+
+#include "juce_audio_basics/juce_audio_basics.h"
+#include "VoiceEvents.h"
+
+#include <vector>
+
+// turns what Homer sings into MIDI that other instruments can follow. Each word holds wordNote until
+// the next word or the end of the sentence, and each phoneme that makes a sound holds a note for its
+// class, from phonemeNoteBase for vowels up through liquids, stops and fricatives to nasals
+class VoiceMidi
+{
+public:
+    static constexpr int channel = 1;
+    static constexpr int wordNote = 36;
+    static constexpr int phonemeNoteBase = 60;
+    static constexpr juce::uint8 velocity = 100;
+
+    // the most one host block can send, for reserving a MidiBuffer: the block is processed in at most two
+    // parts, each event stops a note and starts another, and the held notes are let go twice. A note on
+    // or off takes 9 bytes in a MidiBuffer with its sample position and size
+    static constexpr int maxBytesPerBlock = (2 * 2 * VoiceEventQueue::capacity + 4) * 9;
+
+    // events from HomerProcessor::getEvents(), at the offsets they're heard on
+    void addEvents (const std::vector<VoiceEvent>& events, juce::MidiBuffer& midi);
+
+    // lets go of the held notes, for when the note is cut off before its end
+    void allNotesOff (juce::MidiBuffer& midi, int sample);
+
+private:
+    void startNote (int& heldNote, int note, juce::MidiBuffer& midi, int sample);
+    void stopNote (int& heldNote, juce::MidiBuffer& midi, int sample);
+
+    int heldWordNote = -1;
+    int heldPhonemeNote = -1;
+};
+
+#endif //HOMER_VOICEMIDI_H
@@ -20,11 +20,13 @@ formantHeightEditor (homerState.formantHeightRescaler)
     bendParameters.push_back (homerState.detuneHarmonics);
     bendParameters.push_back (homerState.pitchBend);
     bendParameters.push_back (homerState.vibrato);
+    bendParameters.push_back (homerState.vibratoRate);
     bendParameters.push_back (homerState.consonantVowelBlend);
 
     toggleParameters.push_back (homerState.singParam);
     toggleParameters.push_back (homerState.freezeParam);
     toggleParameters.push_back (homerState.killParam);
+    toggleParameters.push_back (homerState.cleanResamplingParam);
 
     for (auto& bendParameter : bendParameters) {
         auto slider = std::make_unique<juce::Slider>();
@@ -68,6 +70,12 @@ formantHeightEditor (homerState.formantHeightRescaler)
         toggleButtons.push_back (std::move(button));
     }
 
+    addAndMakeVisible (engineSelect);
+    engineSelect.setTitle (homerState.engine->getName (50));
+    engineSelect.addItemList (homerState.engine->choices, 1);
+    engineSelect.setSelectedItemIndex (homerState.engine->getIndex(), juce::dontSendNotification);
+    engineSelect.addListener (this);
+
     addAndMakeVisible (formantFrequencyEditor);
     addAndMakeVisible (formantHeightEditor);
 
@@ -87,6 +95,8 @@ void BendsPanel::timerCallback()
     for (int i = 0; i < toggleParameters.size(); i++) {
         toggleButtons[i]->setToggleState (*toggleParameters[i], juce::dontSendNotification);
     }
+
+    engineSelect.setSelectedItemIndex (homerState.engine->getIndex(), juce::dontSendNotification);
 }
 
 void BendsPanel::sliderValueChanged (juce::Slider*)
@@ -111,6 +121,13 @@ void BendsPanel::buttonStateChanged (juce::Button* button)
 {
 }
 
+void BendsPanel::comboBoxChanged (juce::ComboBox*)
+{
+    homerState.engine->beginChangeGesture();
+    *homerState.engine = std::max (0, engineSelect.getSelectedItemIndex());
+    homerState.engine->endChangeGesture();
+}
+
 void BendsPanel::paint (juce::Graphics& g)
 {
     g.fillAll (juce::Colours::yellow);
@@ -144,6 +161,7 @@ void BendsPanel::resized()
         auto zone = toggleZone.withHeight (40).withY (toggleZone.getY() + i * 40);
         toggleButtons[i]->setBounds (zone);
     }
+    engineSelect.setBounds (toggleZone.withTop (toggleZone.getBottom() - 30).reduced (5));
 
     auto formantEditorArea = usableArea.withWidth (toggleZone.getWidth()).withTop (toggleZone.getBottom() + 10);
     formantFrequencyEditor.setBounds (formantEditorArea.withHeight (formantEditorArea.getHeight() / 2));
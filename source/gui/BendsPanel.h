@@ -10,7 +10,7 @@
 #include "juce_gui_basics/juce_gui_basics.h"
 #include <vector>
 
-class BendsPanel : public juce::Component, public juce::Slider::Listener, public juce::Timer, public juce::Button::Listener
+class BendsPanel : public juce::Component, public juce::Slider::Listener, public juce::Timer, public juce::Button::Listener, public juce::ComboBox::Listener
 {
 public:
     BendsPanel(HomerState& hs);
@@ -21,6 +21,7 @@ private:
     void sliderValueChanged (juce::Slider*) override;
     void buttonClicked(juce::Button*) override;
     void buttonStateChanged(juce::Button*) override;
+    void comboBoxChanged(juce::ComboBox*) override;
     void paint(juce::Graphics& g) override;
     void resized() override;
 
@@ -32,6 +33,7 @@ private:
     std::vector<std::unique_ptr<juce::Slider>> bendSliders;
     std::vector<std::unique_ptr<juce::Label>> bendSliderLabels;
     std::vector<std::unique_ptr<juce::ToggleButton>> toggleButtons;
+    juce::ComboBox engineSelect;
     juce::Rectangle<int> sliderZone;
     juce::Rectangle<int> toggleZone;
 
@@ -23,7 +23,7 @@ LyricLineEditor::LyricLineEditor(HomerState& hs, int n) : homerState(hs), lineNu
 
     voiceSelect.setSelectedItemIndex (homerState.languageSelectors[lineNumber]->getIndex());
 
-    textEditor.setText (homerState.lyrics[lineNumber]);
+    textEditor.setText (homerState.getLyric (lineNumber));
 }
 
 LyricLineEditor::~LyricLineEditor()
@@ -31,16 +31,17 @@ LyricLineEditor::~LyricLineEditor()
 }
 void LyricLineEditor::textEditorReturnKeyPressed (juce::TextEditor&)
 {
-    homerState.lyrics[lineNumber] = textEditor.getText();
+    homerState.setLyric (lineNumber, textEditor.getText());
 }
 void LyricLineEditor::textEditorEscapeKeyPressed (juce::TextEditor&)
 {
-    textEditor.setText (homerState.lyrics[lineNumber]);
+    textEditor.setText (homerState.getLyric (lineNumber));
 }
 void LyricLineEditor::comboBoxChanged (juce::ComboBox*)
 {
     auto id = voiceSelect.getSelectedItemIndex();
     *homerState.languageSelectors[lineNumber] = std::min(std::max(0, id), homerState.voiceNames.size() - 1);
+    homerState.setLyric (lineNumber, homerState.getLyric (lineNumber));
 }
 
 void LyricLineEditor::paint (juce::Graphics& g)
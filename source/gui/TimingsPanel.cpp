@@ -0,0 +1,46 @@
+#include "TimingsPanel.h"
+
+TimingsPanel::TimingsPanel (HomerState& hs) : homerState (hs)
+{
+    heading.setText ("stage, times timed, microseconds per time and share of the total", juce::dontSendNotification);
+    for (auto* label : { &heading, &table }) {
+        label->setFont (juce::Font (juce::Font::getDefaultMonospacedFontName(), 13.0f, juce::Font::plain));
+        label->setJustificationType (juce::Justification::topLeft);
+        label->setColour (juce::Label::textColourId, juce::Colours::black);
+        addAndMakeVisible (label);
+    }
+    heading.setColour (juce::Label::textColourId, juce::Colours::darkgrey);
+
+    resetButton.onClick = [this] {
+        homerState.stageTimings.reset();
+        timerCallback();
+    };
+    addAndMakeVisible (resetButton);
+
+    timerCallback();
+    startTimerHz (4);
+}
+
+TimingsPanel::~TimingsPanel()
+{
+}
+
+void TimingsPanel::timerCallback()
+{
+    table.setText (homerState.stageTimings.toString(), juce::dontSendNotification);
+}
+
+void TimingsPanel::paint (juce::Graphics& g)
+{
+    g.fillAll (juce::Colours::lightyellow);
+    g.setColour (juce::Colours::black);
+    g.drawRect (getLocalBounds());
+}
+
+void TimingsPanel::resized()
+{
+    auto area = getLocalBounds().reduced (5);
+    resetButton.setBounds (area.removeFromBottom (25).removeFromRight (80));
+    heading.setBounds (area.removeFromTop (20));
+    table.setBounds (area);
+}
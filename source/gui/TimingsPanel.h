@@ -0,0 +1,27 @@
+#ifndef HOMER_TIMINGSPANEL_H
+#define HOMER_TIMINGSPANEL_H
+
+#include "../state/HomerState.h"
+#include "juce_gui_basics/juce_gui_basics.h"
+
+// a debug view of HomerState's stageTimings, refreshed a few times a second
+class TimingsPanel : public juce::Component, public juce::Timer
+{
+public:
+    TimingsPanel(HomerState& hs);
+    ~TimingsPanel() override;
+
+private:
+    void timerCallback() override;
+    void paint(juce::Graphics& g) override;
+    void resized() override;
+
+    HomerState& homerState;
+    juce::Label heading;
+    juce::Label table;
+    juce::TextButton resetButton { "Reset" };
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (TimingsPanel);
+};
+
+#endif //HOMER_TIMINGSPANEL_H
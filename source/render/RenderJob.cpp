@@ -0,0 +1,309 @@
+#include "RenderJob.h"
+#include "../PluginProcessor.h"
+
+#include <algorithm>
+#include <juce_audio_formats/juce_audio_formats.h>
+
+static void sortAutomation (std::map<juce::String, std::vector<RenderJob::AutomationPoint>>& automation)
+{
+    for (auto& [parameterID, points] : automation) {
+        std::stable_sort (points.begin(), points.end(), [] (const auto& a, const auto& b) { return a.time < b.time; });
+    }
+}
+
+static float getAutomationValue (const std::vector<RenderJob::AutomationPoint>& points, double time)
+{
+    auto next = std::upper_bound (points.begin(), points.end(), time, [] (double t, const auto& point) { return t < point.time; });
+    if (next == points.begin()) {
+        return points.front().value;
+    }
+    if (next == points.end()) {
+        return points.back().value;
+    }
+    auto previous = std::prev (next);
+    auto proportion = (time - previous->time) / (next->time - previous->time);
+    return previous->value + static_cast<float> (proportion) * (next->value - previous->value);
+}
+
+juce::Result RenderJob::loadMidiFile (const juce::File& file)
+{
+    juce::FileInputStream stream (file);
+    if (!stream.openedOk()) {
+        return juce::Result::fail ("can't open " + file.getFullPathName());
+    }
+    juce::MidiFile midiFile;
+    if (!midiFile.readFrom (stream)) {
+        return juce::Result::fail (file.getFullPathName() + " isn't a MIDI file");
+    }
+    midiFile.convertTimestampTicksToSeconds();
+
+    notes.clear();
+    for (int track = 0; track < midiFile.getNumTracks(); ++track) {
+        notes.addSequence (*midiFile.getTrack (track), 0);
+    }
+    notes.sort();
+    return juce::Result::ok();
+}
+
+juce::Result RenderJob::loadNotes (const juce::var& json)
+{
+    if (!json.isArray()) {
+        return juce::Result::fail ("notes should be an array of [start, duration, note, velocity]");
+    }
+
+    notes.clear();
+    for (auto& note : *json.getArray()) {
+        if (!note.isArray() || note.size() != 4) {
+            return juce::Result::fail ("notes should be an array of [start, duration, note, velocity]");
+        }
+        auto start = static_cast<double> (note[0]);
+        auto noteNumber = juce::jlimit (0, 127, static_cast<int> (note[2]));
+        auto velocity = static_cast<juce::uint8> (juce::jlimit (1, 127, static_cast<int> (note[3])));
+        notes.addEvent (juce::MidiMessage::noteOn (1, noteNumber, velocity).withTimeStamp (start));
+        notes.addEvent (juce::MidiMessage::noteOff (1, noteNumber).withTimeStamp (start + static_cast<double> (note[1])));
+    }
+    notes.sort();
+    notes.updateMatchedPairs();
+    return juce::Result::ok();
+}
+
+juce::Result RenderJob::loadAutomationFile (const juce::File& file)
+{
+    if (!file.existsAsFile()) {
+        return juce::Result::fail ("can't open " + file.getFullPathName());
+    }
+
+    if (file.hasFileExtension ("json")) {
+        juce::var json;
+        auto parsed = juce::JSON::parse (file.loadFileAsString(), json);
+        return parsed.wasOk() ? loadAutomation (json) : juce::Result::fail (file.getFullPathName() + ": " + parsed.getErrorMessage());
+    }
+
+    juce::StringArray lines;
+    file.readLines (lines);
+    for (int i = 0; i < lines.size(); ++i) {
+        auto line = lines[i].trim();
+        if (line.isEmpty() || line.startsWithChar ('#')) {
+            continue;
+        }
+        auto fields = juce::StringArray::fromTokens (line, ",", "\"");
+        fields.trim();
+        if (fields.size() != 3) {
+            return juce::Result::fail (file.getFullPathName() + ":" + juce::String (i + 1) + ": expected time,parameter,value");
+        }
+        if (!fields[0].containsOnly ("0123456789.+-eE")) {
+            // a header line
+            continue;
+        }
+        automation[fields[1].unquoted()].push_back ({ fields[0].getDoubleValue(), fields[2].getFloatValue() });
+    }
+    sortAutomation (automation);
+    return juce::Result::ok();
+}
+
+juce::Result RenderJob::loadAutomation (const juce::var& json)
+{
+    auto object = json.getDynamicObject();
+    if (object == nullptr) {
+        return juce::Result::fail ("automation should be an object of parameter IDs");
+    }
+
+    for (auto& property : object->getProperties()) {
+        auto& points = automation[property.name.toString()];
+        if (!property.value.isArray()) {
+            points.push_back ({ 0, static_cast<float> (property.value) });
+            continue;
+        }
+        for (auto& point : *property.value.getArray()) {
+            if (!point.isArray() || point.size() != 2) {
+                return juce::Result::fail ("automation points for " + property.name.toString() + " should be [time, value]");
+            }
+            points.push_back ({ static_cast<double> (point[0]), static_cast<float> (point[1]) });
+        }
+    }
+    sortAutomation (automation);
+    return juce::Result::ok();
+}
+
+juce::Result RenderJob::fromJson (const juce::var& json, const juce::File& baseDirectory, RenderJob& job)
+{
+    if (!json.isObject()) {
+        return juce::Result::fail ("a job should be an object");
+    }
+
+    for (auto [key, strings] : { std::pair { "lyrics", &job.lyrics }, std::pair { "voices", &job.voices } }) {
+        auto values = json.getProperty (key, {});
+        if (values.size() > HomerState::numLyricLines) {
+            return juce::Result::fail (juce::String ("there are only ") + juce::String (HomerState::numLyricLines) + " lyric lines");
+        }
+        for (int line = 0; line < values.size(); ++line) {
+            (*strings)[static_cast<size_t> (line)] = values[line].toString();
+        }
+    }
+
+    auto result = juce::Result::ok();
+    if (json.hasProperty ("notes")) {
+        result = job.loadNotes (json["notes"]);
+    } else if (json.hasProperty ("midi")) {
+        result = job.loadMidiFile (baseDirectory.getChildFile (json["midi"].toString()));
+    } else {
+        return juce::Result::fail ("a job needs a midi file or notes");
+    }
+    if (result.failed()) {
+        return result;
+    }
+
+    auto automation = json.getProperty ("automation", {});
+    if (automation.isString()) {
+        result = job.loadAutomationFile (baseDirectory.getChildFile (automation.toString()));
+    } else if (automation.isObject()) {
+        result = job.loadAutomation (automation);
+    }
+    if (result.failed()) {
+        return result;
+    }
+
+    job.sampleRate = json.getProperty ("sampleRate", job.sampleRate);
+    job.blockSize = json.getProperty ("blockSize", job.blockSize);
+    job.tailSeconds = json.getProperty ("tail", job.tailSeconds);
+    if (json.hasProperty ("seed")) {
+        job.seed = static_cast<juce::uint32> (static_cast<juce::int64> (json["seed"]));
+    }
+    if (json.hasProperty ("output")) {
+        job.outputFile = baseDirectory.getChildFile (json["output"].toString());
+    }
+    return juce::Result::ok();
+}
+
+int RenderJob::getNumSamples() const
+{
+    return static_cast<int> (std::ceil ((notes.getEndTime() + tailSeconds) * sampleRate));
+}
+
+juce::Result RenderJob::render (juce::AudioBuffer<float>& output) const
+{
+    PluginProcessor plugin;
+    output.setSize (2, std::max (0, getNumSamples()));
+    int position = 0;
+    return render (plugin, [&output, &position] (const juce::AudioBuffer<float>& block) {
+        for (int channel = 0; channel < output.getNumChannels(); ++channel) {
+            output.copyFrom (channel, position, block, std::min (channel, block.getNumChannels() - 1), 0, block.getNumSamples());
+        }
+        position += block.getNumSamples();
+        return true;
+    });
+}
+
+juce::Result RenderJob::render (PluginProcessor& plugin, const BlockCallback& onBlock) const
+{
+    if (notes.getNumEvents() == 0) {
+        return juce::Result::fail ("there are no notes to sing");
+    }
+    if (sampleRate <= 0 || blockSize <= 0) {
+        return juce::Result::fail ("the sample rate and block size have to be positive");
+    }
+
+    auto& hs = plugin.homerState;
+
+    // whatever the last job left behind
+    for (auto* parameter : plugin.getParameters()) {
+        parameter->setValueNotifyingHost (parameter->getDefaultValue());
+    }
+    hs.currentMidiNotes.clear();
+    hs.noteCurrentlyDown = false;
+    hs.deterministic = seed.has_value();
+    hs.sessionSeed = seed.value_or (0);
+
+    // the voice has to be set before the lyric, which is translated in it
+    for (size_t line = 0; line < HomerState::numLyricLines; ++line) {
+        if (voices[line].isNotEmpty()) {
+            auto voiceIndex = hs.voiceNames.indexOf (voices[line]);
+            if (voiceIndex < 0) {
+                return juce::Result::fail ("there's no voice called " + voices[line]);
+            }
+            auto* selector = hs.languageSelectors[line];
+            selector->setValueNotifyingHost (selector->convertTo0to1 (static_cast<float> (voiceIndex)));
+        }
+        if (lyrics[line].isNotEmpty() || hs.getLyric (static_cast<int> (line)).isNotEmpty()) {
+            hs.setLyric (static_cast<int> (line), lyrics[line]);
+        }
+    }
+
+    std::vector<std::pair<juce::RangedAudioParameter*, const std::vector<AutomationPoint>*>> automated;
+    for (auto& [parameterID, points] : automation) {
+        juce::RangedAudioParameter* parameter = nullptr;
+        for (auto* p : plugin.getParameters()) {
+            if (auto* ranged = dynamic_cast<juce::RangedAudioParameter*> (p); ranged != nullptr && ranged->getParameterID() == parameterID) {
+                parameter = ranged;
+            }
+        }
+        if (parameter == nullptr) {
+            return juce::Result::fail ("there's no parameter called " + parameterID);
+        }
+        if (!points.empty()) {
+            automated.emplace_back (parameter, &points);
+        }
+    }
+
+    auto numSamples = getNumSamples();
+    juce::AudioBuffer<float> block (2, blockSize);
+
+    plugin.setNonRealtime (true);
+    plugin.prepareToPlay (sampleRate, blockSize);
+
+    juce::MidiBuffer midi;
+    int nextEvent = 0;
+    auto result = juce::Result::ok();
+    for (int start = 0; start < numSamples; start += blockSize) {
+        auto numBlockSamples = std::min (blockSize, numSamples - start);
+
+        // like a host that doesn't split blocks, the bends move once per block
+        for (auto& [parameter, points] : automated) {
+            parameter->setValueNotifyingHost (parameter->convertTo0to1 (getAutomationValue (*points, start / sampleRate)));
+        }
+
+        midi.clear();
+        for (; nextEvent < notes.getNumEvents(); ++nextEvent) {
+            auto& message = notes.getEventPointer (nextEvent)->message;
+            auto samplePosition = juce::roundToInt (message.getTimeStamp() * sampleRate);
+            if (samplePosition >= start + numBlockSamples) {
+                break;
+            }
+            midi.addEvent (message, std::max (0, samplePosition - start));
+        }
+
+        block.setSize (2, numBlockSamples, false, false, true);
+        block.clear();
+        plugin.processBlock (block, midi);
+        if (!onBlock (block)) {
+            result = juce::Result::fail ("the render was stopped");
+            break;
+        }
+    }
+
+    plugin.releaseResources();
+    return result;
+}
+
+juce::Result RenderJob::writeWav (const juce::AudioBuffer<float>& audio, double sampleRate, const juce::File& file, int bitsPerSample)
+{
+    file.getParentDirectory().createDirectory();
+    file.deleteFile();
+    std::unique_ptr<juce::OutputStream> stream = file.createOutputStream();
+    if (stream == nullptr) {
+        return juce::Result::fail ("can't write to " + file.getFullPathName());
+    }
+
+    juce::WavAudioFormat wav;
+    std::unique_ptr<juce::AudioFormatWriter> writer (wav.createWriterFor (stream.get(), sampleRate,
+        static_cast<unsigned int> (audio.getNumChannels()), bitsPerSample, {}, 0));
+    if (writer == nullptr) {
+        return juce::Result::fail ("can't write " + juce::String (bitsPerSample) + " bit WAV files");
+    }
+    stream.release(); // the writer owns it now
+
+    if (!writer->writeFromAudioSampleBuffer (audio, 0, audio.getNumSamples())) {
+        return juce::Result::fail ("couldn't finish writing " + file.getFullPathName());
+    }
+    return juce::Result::ok();
+}
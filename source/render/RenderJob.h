@@ -0,0 +1,72 @@
+#ifndef HOMER_RENDERJOB_H
+#define HOMER_RENDERJOB_H
+
+#include <array>
+#include <functional>
+#include <map>
+#include <optional>
+#include <vector>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <juce_core/juce_core.h>
+
+#include "../state/HomerState.h"
+
+class PluginProcessor;
+
+// One take rendered without a host: the plugin bounced offline through the same
+// PluginProcessor, HomerProcessor and Resampler path a DAW would use.
+struct RenderJob
+{
+    struct AutomationPoint
+    {
+        double time; // seconds
+        float value; // in the parameter's own range, so Hz for the clock speed
+    };
+
+    // lines or voices left empty keep the plugin's defaults
+    std::array<juce::String, HomerState::numLyricLines> lyrics;
+    std::array<juce::String, HomerState::numLyricLines> voices;
+
+    // timestamps in seconds
+    juce::MidiMessageSequence notes;
+
+    // by parameter ID, each sorted by time and held between and beyond its points
+    std::map<juce::String, std::vector<AutomationPoint>> automation;
+
+    double sampleRate = 48000;
+    int blockSize = 512;
+    // how long to keep rendering after the last MIDI event, for the note to finish
+    double tailSeconds = 2;
+
+    // renders deterministically from this session seed, the same samples every time whatever the block
+    // size; without it the random choices are seeded from the clock
+    std::optional<juce::uint32> seed;
+
+    juce::File outputFile;
+
+    juce::Result loadMidiFile (const juce::File& file);
+
+    // [start, duration, note, velocity] arrays, in seconds and 0-127, for jobs that don't come with a MIDI file
+    juce::Result loadNotes (const juce::var& json);
+
+    // .json is an object of parameter ID to a value or to [time, value] pairs,
+    // anything else is read as CSV lines of time,parameter,value
+    juce::Result loadAutomationFile (const juce::File& file);
+    juce::Result loadAutomation (const juce::var& json);
+
+    // the same keys as the homer-render options, with paths relative to baseDirectory
+    static juce::Result fromJson (const juce::var& json, const juce::File& baseDirectory, RenderJob& job);
+
+    // the number of samples render() produces, the notes plus the tail
+    int getNumSamples() const;
+
+    juce::Result render (juce::AudioBuffer<float>& output) const;
+
+    // renders with a plugin that may have sung other jobs before, putting its lyrics and parameters
+    // back to their defaults first, and hands over each block as it's done. Returning false stops the render.
+    using BlockCallback = std::function<bool (const juce::AudioBuffer<float>& block)>;
+    juce::Result render (PluginProcessor& plugin, const BlockCallback& onBlock) const;
+    static juce::Result writeWav (const juce::AudioBuffer<float>& audio, double sampleRate, const juce::File& file, int bitsPerSample);
+};
+
+#endif //HOMER_RENDERJOB_H
@@ -0,0 +1,8 @@
+#ifndef HOMER_ESPEAKDATAPATH_H
+#define HOMER_ESPEAKDATAPATH_H
+
+// where every espeak context Homer sets up loads its voices and phoneme data from
+// inline constexpr const char* espeakDataPath = R"(D:\projects\circuitbent-speech\espeak-ng\espeak-ng-data)";
+inline constexpr const char* espeakDataPath = R"(/home/arden/projects/circuitbent-speech/espeak-ng/espeak-ng-data)";
+
+#endif //HOMER_ESPEAKDATAPATH_H
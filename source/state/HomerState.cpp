@@ -3,15 +3,18 @@
 //
 
 #include "HomerState.h"
+#include "EspeakDataPath.h"
 
 #include "espeak-ng/speak_lib.h"
 
+#include <cstring>
+#include <map>
+
 HomerState::HomerState() : formantFrequencyRescaler ("ffrescale", "formant frequency rescale"), formantHeightRescaler("fhrescale", "formant height rescaler"), peakLevel (0), rmsLevel (0)
 {
     EspeakProcessorContext epContext;
 
-    // const char* path = R"(D:\projects\circuitbent-speech\espeak-ng\espeak-ng-data)";
-    const char* path = R"(/home/arden/projects/circuitbent-speech/espeak-ng/espeak-ng-data)";
+    const char* path = espeakDataPath;
     espeak_AUDIO_OUTPUT output = AUDIO_OUTPUT_SYNCHRONOUS;
     int buflength = 500, options = 0;
     memset(&epContext, 0, sizeof(EspeakProcessorContext));
@@ -22,6 +25,8 @@ HomerState::HomerState() : formantFrequencyRescaler ("ffrescale", "formant frequ
     for (int i = 0; voices[i] != nullptr; i++) {
         voiceNames.add((const char8_t* const)voices[i]->name);
     }
+    // only needed for the names, and a batch render makes a lot of these
+    espeak_Terminate (&epContext);
 
     lyricSelector = new juce::AudioParameterInt({"lyricsselector", 1}, "Lyric line", 1, numLyricLines, 1);
 
@@ -35,6 +40,9 @@ HomerState::HomerState() : formantFrequencyRescaler ("ffrescale", "formant frequ
     singParam = new juce::AudioParameterBool({"sing", 1}, "speak/sing", false);
     freezeParam = new juce::AudioParameterBool({"freeze", 1}, "freeze", false);
     killParam = new juce::AudioParameterBool({"kill", 1}, "kill", false);
+    cleanResamplingParam = new juce::AudioParameterBool({"cleanresampling", 1}, "clean resampling", false);
+
+    engine = new juce::AudioParameterChoice({"engine", 1}, "engine", juce::StringArray {"Wavegen", "Klatt", "speechPlayer"}, 0);
 
     phonemeRotationParam = new juce::AudioParameterFloat({"phonemerotation", 1}, "phoneme rotation", 0, 1, 0);
     phonemeStickParam = new juce::AudioParameterFloat({"phonemestick", 1}, "phoneme stick", 0, 1, 0);
@@ -45,6 +53,7 @@ HomerState::HomerState() : formantFrequencyRescaler ("ffrescale", "formant frequ
     detuneHarmonics = new juce::AudioParameterFloat({"detuneharmonics", 1}, "detune harmonics", -1, 1, 0);
     pitchBend = new juce::AudioParameterFloat({"pitchbend", 1}, "pitch bend", -1, 1, 0);
     vibrato = new juce::AudioParameterFloat({"vibrato", 1}, "vibrato", 0, 1, 0);
+    vibratoRate = new juce::AudioParameterFloat({"vibratorate", 1}, "vibrato rate", 0.5f, 20, 10);
     consonantVowelBlend = new juce::AudioParameterFloat({"cvblend", 1}, "consonant/vowel blend", -1, 1, 0);
 
     params.push_back(lyricSelector);
@@ -54,6 +63,9 @@ HomerState::HomerState() : formantFrequencyRescaler ("ffrescale", "formant frequ
     params.push_back (singParam);
     params.push_back (freezeParam);
     params.push_back (killParam);
+    params.push_back (cleanResamplingParam);
+
+    params.push_back (engine);
 
     params.push_back (phonemeRotationParam);
     params.push_back (phonemeStickParam);
@@ -64,6 +76,7 @@ HomerState::HomerState() : formantFrequencyRescaler ("ffrescale", "formant frequ
     params.push_back (detuneHarmonics);
     params.push_back (pitchBend);
     params.push_back (vibrato);
+    params.push_back (vibratoRate);
     params.push_back (consonantVowelBlend);
 
     params.push_back(formantFrequencyRescaler.start);
@@ -73,4 +86,134 @@ HomerState::HomerState() : formantFrequencyRescaler ("ffrescale", "formant frequ
     params.push_back (formantHeightRescaler.start);
     params.push_back (formantHeightRescaler.end);
     params.push_back (formantHeightRescaler.curve);
-}
\ No newline at end of file
+}
+
+void HomerState::setLyric (int line, const juce::String& text)
+{
+    lyrics[static_cast<size_t> (line)] = text;
+    phonemeCache.translate (line, text, voiceNames[*languageSelectors[static_cast<size_t> (line)]]);
+}
+
+// The state is a header followed by sections, all little endian:
+//
+//   "HOMR", then the format version as a byte
+//   per section: a four character tag, its size in bytes as a compressed int, then its contents
+//
+//   "PARM": the number of parameters, then each one's ID as a string and its normalised value as a float
+//   "LYRC": the number of lines, then each one's text and voice name as strings
+//   "SEED": whether renders are deterministic as a byte, then the session seed as an int
+//
+// Strings are null terminated UTF-8 and counts are compressed ints, as MemoryOutputStream writes them.
+// Readers skip sections they don't know, so new sections don't need a new version; the version only
+// goes up when an existing section's layout changes. Parameters are stored by ID and voices by name,
+// so states survive parameters being added and espeak's voice list changing order.
+static constexpr char stateMagic[4] = { 'H', 'O', 'M', 'R' };
+static constexpr juce::uint8 stateVersion = 1;
+
+static void writeSection (juce::OutputStream& out, const char* tag, const juce::MemoryOutputStream& contents)
+{
+    out.write (tag, 4);
+    out.writeCompressedInt (static_cast<int> (contents.getDataSize()));
+    out.write (contents.getData(), contents.getDataSize());
+}
+
+void HomerState::saveState (juce::MemoryBlock& destData) const
+{
+    juce::MemoryOutputStream out (destData, false);
+    out.write (stateMagic, sizeof (stateMagic));
+    out.writeByte (static_cast<char> (stateVersion));
+
+    juce::MemoryOutputStream parameters;
+    parameters.writeCompressedInt (static_cast<int> (params.size()));
+    for (auto* param : params) {
+        parameters.writeString (static_cast<juce::AudioProcessorParameterWithID*> (param)->getParameterID());
+        parameters.writeFloat (param->getValue());
+    }
+    writeSection (out, "PARM", parameters);
+
+    juce::MemoryOutputStream lines;
+    lines.writeCompressedInt (numLyricLines);
+    for (size_t line = 0; line < numLyricLines; ++line) {
+        lines.writeString (lyrics[line]);
+        lines.writeString (voiceNames[*languageSelectors[line]]);
+    }
+    writeSection (out, "LYRC", lines);
+
+    juce::MemoryOutputStream seeding;
+    seeding.writeBool (deterministic);
+    seeding.writeInt (static_cast<int> (sessionSeed.load()));
+    writeSection (out, "SEED", seeding);
+}
+
+bool HomerState::loadState (const void* data, size_t sizeInBytes)
+{
+    juce::MemoryInputStream in (data, sizeInBytes, false);
+    char magic[sizeof (stateMagic)];
+    if (in.read (magic, sizeof (magic)) != sizeof (magic) || std::memcmp (magic, stateMagic, sizeof (magic)) != 0
+        || static_cast<juce::uint8> (in.readByte()) > stateVersion) {
+        return false;
+    }
+
+    // read everything before changing anything, so a truncated state doesn't get half loaded
+    std::map<juce::String, float> values;
+    std::vector<std::pair<juce::String, juce::String>> lines;
+    bool loadedDeterministic = false;
+    juce::uint32 loadedSessionSeed = 0;
+    while (!in.isExhausted()) {
+        char tag[4];
+        if (in.read (tag, sizeof (tag)) != sizeof (tag)) {
+            return false;
+        }
+        auto size = in.readCompressedInt();
+        if (size < 0 || size > in.getNumBytesRemaining()) {
+            return false;
+        }
+        juce::MemoryInputStream section (static_cast<const char*> (in.getData()) + in.getPosition(), static_cast<size_t> (size), false);
+        in.skipNextBytes (size);
+
+        if (std::memcmp (tag, "PARM", 4) == 0) {
+            auto count = section.readCompressedInt();
+            for (int i = 0; i < count && !section.isExhausted(); ++i) {
+                auto id = section.readString();
+                values[id] = section.readFloat();
+            }
+        } else if (std::memcmp (tag, "LYRC", 4) == 0) {
+            auto count = section.readCompressedInt();
+            for (int i = 0; i < count && !section.isExhausted(); ++i) {
+                auto text = section.readString();
+                auto voice = section.readString();
+                lines.emplace_back (text, voice);
+            }
+        } else if (std::memcmp (tag, "SEED", 4) == 0) {
+            loadedDeterministic = section.readBool();
+            loadedSessionSeed = static_cast<juce::uint32> (section.readInt());
+        }
+    }
+
+    deterministic = loadedDeterministic;
+    sessionSeed = loadedSessionSeed;
+
+    // parameters the state doesn't have, from before they were added, go back to their defaults
+    for (auto* param : params) {
+        auto id = static_cast<juce::AudioProcessorParameterWithID*> (param)->getParameterID();
+        auto it = values.find (id);
+        auto value = it != values.end() ? juce::jlimit (0.0f, 1.0f, it->second) : param->getDefaultValue();
+        if (param->getValue() != value) {
+            param->setValueNotifyingHost (value);
+        }
+    }
+
+    for (size_t line = 0; line < numLyricLines; ++line) {
+        auto [text, voice] = line < lines.size() ? lines[line] : std::pair<juce::String, juce::String> {};
+        // by name, in case this espeak lists its voices differently; otherwise the parameter's index stands
+        auto voiceIndex = voiceNames.indexOf (voice);
+        if (voiceIndex >= 0 && voiceIndex != languageSelectors[line]->getIndex()) {
+            *languageSelectors[line] = voiceIndex;
+        }
+        // the phoneme cache leaves lines whose text and voice are the same as they were
+        if (text != lyrics[line] || (text.isNotEmpty() && phonemeCache.getSnapshot (static_cast<int> (line)).voice != voiceNames[*languageSelectors[line]])) {
+            setLyric (static_cast<int> (line), text);
+        }
+    }
+    return true;
+}
@@ -7,10 +7,13 @@
 
 #include <vector>
 #include <array>
+#include <atomic>
 #include <juce_core/juce_core.h>
 #include <juce_audio_processors/juce_audio_processors.h>
 
 #include "RescaleParameters.h"
+#include "PhonemeCache.h"
+#include "StageTimings.h"
 
 struct HomerState
 {
@@ -18,18 +21,38 @@ struct HomerState
 
     HomerState();
 
-    std::array<juce::String, numLyricLines> lyrics;
+    // commits a lyric line, so the next note sings it and its translation starts in the background
+    void setLyric (int line, const juce::String& text);
+    const juce::String& getLyric (int line) const { return lyrics[static_cast<size_t> (line)]; }
+
+    // what the host saves with a session: the parameters, the lyric lines with their voices and the
+    // seeding, in the binary format described in HomerState.cpp
+    void saveState (juce::MemoryBlock& destData) const;
+
+    // only touches what differs from the current state, so lines that didn't change keep their
+    // translations and nothing is rebuilt here; the new lines are translated in the background.
+    // Returns false, leaving everything as it was, for data that isn't a state this version can read.
+    bool loadState (const void* data, size_t sizeInBytes);
+
     std::array<juce::AudioParameterChoice*, numLyricLines> languageSelectors;
 
     juce::AudioParameterInt* lyricSelector;
 
     juce::StringArray voiceNames;
 
+    // where this instance's CPU goes, for the timings panel and the benchmarks
+    StageTimings stageTimings;
+
+    PhonemeCache phonemeCache { numLyricLines, stageTimings };
+
     // juce::AudioParameterChoice* currentVoiceParam;
 
     juce::AudioParameterBool* singParam;
     juce::AudioParameterBool* freezeParam;
     juce::AudioParameterBool* killParam;
+    juce::AudioParameterBool* cleanResamplingParam;
+
+    juce::AudioParameterChoice* engine;
 
     juce::AudioParameterFloat* phonemeRotationParam;
     juce::AudioParameterFloat* phonemeStickParam;
@@ -40,6 +63,7 @@ struct HomerState
     juce::AudioParameterFloat* detuneHarmonics;
     juce::AudioParameterFloat* pitchBend;
     juce::AudioParameterFloat* vibrato;
+    juce::AudioParameterFloat* vibratoRate;
     juce::AudioParameterFloat* consonantVowelBlend;
 
     RescaleParameters formantFrequencyRescaler;
@@ -47,6 +71,12 @@ struct HomerState
 
     std::vector<juce::AudioProcessorParameter*> params;
 
+    // for bounces that come out the same every time: each note's random choices are seeded from the
+    // session seed, the note's index and its lyric line, and a note waits for its line's translation
+    // rather than singing from the text while the translation is still being made
+    std::atomic<bool> deterministic { false };
+    std::atomic<juce::uint32> sessionSeed { 0 };
+
     std::vector<int> currentMidiNotes;
     float keyFrequency = 0;
     bool noteCurrentlyDown = false;
@@ -54,6 +84,9 @@ struct HomerState
     float peakLevel;
     float rmsLevel;
 
+private:
+    // only written through setLyric, which is what gets a line to the notes
+    std::array<juce::String, numLyricLines> lyrics;
 };
 
 #endif //HOMER_HOMERSTATE_H
@@ -0,0 +1,147 @@
+#include "PhonemeCache.h"
+#include "EspeakDataPath.h"
+
+PhonemeCache::PhonemeCache (int numLines, StageTimings& t)
+    : Thread ("PhonemeCache"),
+      entries (static_cast<size_t> (numLines)),
+      versions (std::make_unique<std::atomic<int>[]> (static_cast<size_t> (numLines))),
+      timings (t)
+{
+}
+
+PhonemeCache::~PhonemeCache()
+{
+    stopThread (4000);
+    if (epContext) {
+        espeak_Terminate (epContext.get());
+    }
+}
+
+void PhonemeCache::translate (int line, const juce::String& lyric, const juce::String& voice)
+{
+    jassert (line >= 0 && line < static_cast<int> (entries.size()));
+    {
+        const juce::ScopedLock sl (lock);
+        auto& entry = entries[static_cast<size_t> (line)];
+        if (entry.lyric == lyric && entry.voice == voice) {
+            return;
+        }
+        auto version = versions[static_cast<size_t> (line)].load() + 1;
+        entry = { lyric, voice, version, nullptr, false };
+        versions[static_cast<size_t> (line)].store (version, std::memory_order_release);
+        if (std::find (pendingLines.begin(), pendingLines.end(), line) == pendingLines.end()) {
+            pendingLines.push_back (line);
+        }
+    }
+
+    if (!isThreadRunning()) {
+        startThread (juce::Thread::Priority::low);
+    }
+    notify();
+}
+
+PhonemeCache::Snapshot PhonemeCache::getSnapshot (int line) const
+{
+    const juce::ScopedLock sl (lock);
+    return entries[static_cast<size_t> (line)];
+}
+
+PhonemeCache::Translation PhonemeCache::tryGetTranslation (int line, int version) const
+{
+    const juce::ScopedTryLock sl (lock);
+    if (!sl.isLocked()) {
+        return nullptr;
+    }
+    auto& entry = entries[static_cast<size_t> (line)];
+    return entry.version == version ? entry.translation : nullptr;
+}
+
+PhonemeCache::Translation PhonemeCache::waitForTranslation (int line, int version, int timeoutMs) const
+{
+    auto deadline = juce::Time::getMillisecondCounter() + static_cast<juce::uint32> (timeoutMs);
+    for (;;) {
+        {
+            const juce::ScopedLock sl (lock);
+            auto& entry = entries[static_cast<size_t> (line)];
+            if (entry.version != version || entry.translated) {
+                return entry.version == version ? entry.translation : nullptr;
+            }
+        }
+        if (juce::Time::getMillisecondCounter() >= deadline) {
+            return nullptr;
+        }
+        juce::Thread::sleep (1);
+    }
+}
+
+PhonemeCache::Translation PhonemeCache::find (const juce::String& lyric, const juce::String& voice) const
+{
+    const juce::ScopedLock sl (lock);
+    for (auto& entry : entries) {
+        if (entry.translation && entry.lyric == lyric && entry.voice == voice) {
+            return entry.translation;
+        }
+    }
+    return nullptr;
+}
+
+void PhonemeCache::run()
+{
+    while (!threadShouldExit()) {
+        int line = -1;
+        Snapshot snapshot;
+        {
+            const juce::ScopedLock sl (lock);
+            if (!pendingLines.empty()) {
+                line = pendingLines.front();
+                pendingLines.erase (pendingLines.begin());
+                snapshot = entries[static_cast<size_t> (line)];
+            }
+        }
+
+        if (line < 0) {
+            wait (-1);
+            continue;
+        }
+
+        Translation translation;
+        {
+            // recording the commands is timed with it, as it's done here rather than in the note
+            const ScopedStageTimer timer (timings, StageTimings::Stage::translate);
+            translation = translateNow (snapshot.lyric, snapshot.voice);
+        }
+
+        // the line may have been edited again while this one was translating
+        const juce::ScopedLock sl (lock);
+        auto& entry = entries[static_cast<size_t> (line)];
+        if (entry.version == snapshot.version) {
+            entry.translation = translation;
+            entry.translated = true;
+        }
+    }
+}
+
+PhonemeCache::Translation PhonemeCache::translateNow (const juce::String& lyric, const juce::String& voice)
+{
+    if (!epContext) {
+        epContext = std::make_unique<EspeakProcessorContext>();
+        memset (epContext.get(), 0, sizeof (EspeakProcessorContext));
+        initEspeakContext (epContext.get());
+        // the recordings keep the phoneme markers, so notes sung from them still have phoneme events
+        espeak_Initialize (epContext.get(), AUDIO_OUTPUT_SYNCHRONOUS, 500, espeakDataPath, espeakINITIALIZE_PHONEME_EVENTS);
+    }
+
+    if (espeak_SetVoiceByName (epContext.get(), voice.toRawUTF8()) != EE_OK) {
+        return nullptr;
+    }
+
+    auto text = lyric.toStdString();
+    auto translation = std::make_shared<Lyric>();
+    if (espeak_ng_TranslatePhonemeCache (epContext.get(), text.c_str(), espeakCHARS_AUTO, &translation->phonemes) != ENS_OK) {
+        return nullptr;
+    }
+    if (espeak_ng_RecordCommandStream (epContext.get(), translation->phonemes, &translation->commands) != ENS_OK) {
+        translation->commands = nullptr;
+    }
+    return translation;
+}
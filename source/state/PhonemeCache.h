@@ -0,0 +1,86 @@
+#ifndef HOMER_PHONEMECACHE_H
+#define HOMER_PHONEMECACHE_H
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <juce_core/juce_core.h>
+
+#include <espeak-ng/speak_lib.h>
+#include <espeak-ng/espeak_ng.h>
+
+#include "StageTimings.h"
+
+// The committed lyric lines, each with a version number that changes whenever its text or voice does,
+// and their phoneme translations, made on a background thread so a note can start straight at
+// espeak's wavegen commands instead of translating its text first.
+class PhonemeCache : private juce::Thread
+{
+public:
+    struct Lyric
+    {
+        Lyric() = default;
+        ~Lyric()
+        {
+            espeak_ng_FreeCommandStream (commands);
+            espeak_ng_FreePhonemeCache (phonemes);
+        }
+
+        espeak_ng_PHONEME_CACHE phonemes = nullptr;
+        // what Generate() queued for the phonemes in the voice's own engine at espeak's rate,
+        // nullptr if it couldn't be recorded
+        espeak_ng_COMMAND_STREAM commands = nullptr;
+
+        JUCE_DECLARE_NON_COPYABLE (Lyric)
+    };
+    using Translation = std::shared_ptr<const Lyric>;
+
+    struct Snapshot
+    {
+        juce::String lyric;
+        juce::String voice;
+        int version = 0;
+        Translation translation; // nullptr until the background thread has got to it
+        bool translated = false; // whether it has, as translating can fail
+    };
+
+    // the background translations are timed into timings
+    PhonemeCache (int numLines, StageTimings& timings);
+    ~PhonemeCache() override;
+
+    // commits lyric in voice to the line, and translates it in the background if either changed
+    void translate (int line, const juce::String& lyric, const juce::String& voice);
+
+    // bumped by every change to the line, safe to compare from the audio thread
+    int getVersion (int line) const noexcept { return versions[static_cast<size_t> (line)].load (std::memory_order_acquire); }
+
+    Snapshot getSnapshot (int line) const;
+
+    // the line's translation if it's ready and still at version, without waiting on the lock
+    Translation tryGetTranslation (int line, int version) const;
+
+    // the line's translation at version, waiting up to timeoutMs for the background thread to finish it.
+    // nullptr if it couldn't be translated, the line has moved on, or it took too long
+    Translation waitForTranslation (int line, int version, int timeoutMs) const;
+
+    // the translation of lyric in voice on any line, or nullptr if there isn't one ready
+    Translation find (const juce::String& lyric, const juce::String& voice) const;
+
+private:
+    void run() override;
+    Translation translateNow (const juce::String& lyric, const juce::String& voice);
+
+    juce::CriticalSection lock;
+    std::vector<Snapshot> entries;
+    std::unique_ptr<std::atomic<int>[]> versions;
+    std::vector<int> pendingLines;
+    StageTimings& timings;
+
+    // only touched by the background thread
+    std::unique_ptr<EspeakProcessorContext> epContext;
+
+    JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (PhonemeCache)
+};
+
+#endif //HOMER_PHONEMECACHE_H
@@ -11,6 +11,8 @@ RescaleParameters::RescaleParameters(const juce::String baseID, const juce::Stri
 }
 float RescaleParameters::rescale (float x) const
 {
-    float sloped = std::pow (x, std::pow(5.f, -*curve));
-    return (*end - *start) * sloped + *start;
+    rescaler.start = *start;
+    rescaler.end = *end;
+    rescaler.curve = *curve;
+    return applyBendRescaler (&rescaler, x, 0, 1);
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #define HOMER_RESCALEPARAMETERS_H
 
 #include "juce_audio_processors/juce_audio_processors.h"
+#include <espeak-ng/speak_lib.h>
 
 struct RescaleParameters
 {
@@ -16,7 +17,11 @@ struct RescaleParameters
 
     juce::String name;
 
+    // evaluated with the same table the synth uses, so the editor draws exactly what is heard
     float rescale(float x) const;
+
+private:
+    mutable BendRescaler rescaler {};
 };
 
 #endif //HOMER_RESCALEPARAMETERS_H
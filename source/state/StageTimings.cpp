@@ -0,0 +1,105 @@
+#include "StageTimings.h"
+
+#include <bit>
+
+juce::uint64 StageTimings::Histogram::getPercentileCycles (double fraction) const
+{
+    auto wanted = static_cast<juce::uint64> (std::ceil (fraction * static_cast<double> (count)));
+    juce::uint64 seen = 0;
+    for (int bucket = 0; bucket < numBuckets; ++bucket) {
+        seen += buckets[static_cast<size_t> (bucket)];
+        if (seen >= wanted && seen > 0) {
+            return std::min (maxCycles, (juce::uint64 { 1 } << bucket) - 1);
+        }
+    }
+    return maxCycles;
+}
+
+double StageTimings::getCyclesPerSecond()
+{
+    static const double cyclesPerSecond = [] {
+        auto startTicks = juce::Time::getHighResolutionTicks();
+        auto startCycles = now();
+        juce::Thread::sleep (20);
+        auto cycles = static_cast<double> (now() - startCycles);
+        auto seconds = juce::Time::highResolutionTicksToSeconds (juce::Time::getHighResolutionTicks() - startTicks);
+        return seconds > 0 ? cycles / seconds : 1.0e9;
+    }();
+    return cyclesPerSecond;
+}
+
+const char* StageTimings::getName (Stage stage)
+{
+    switch (stage) {
+        case Stage::translate: return "translate";
+        case Stage::generate: return "generate";
+        case Stage::wavegen: return "wavegen";
+        case Stage::handoff: return "handoff";
+        case Stage::resample: return "resample";
+    }
+    return "";
+}
+
+void StageTimings::add (Stage stage, juce::uint64 cycles) noexcept
+{
+    auto& c = counters[static_cast<size_t> (stage)];
+    auto bucket = std::min (static_cast<int> (std::bit_width (cycles)), numBuckets - 1);
+    c.buckets[static_cast<size_t> (bucket)].fetch_add (1, std::memory_order_relaxed);
+    c.count.fetch_add (1, std::memory_order_relaxed);
+    c.totalCycles.fetch_add (cycles, std::memory_order_relaxed);
+
+    auto maxCycles = c.maxCycles.load (std::memory_order_relaxed);
+    while (cycles > maxCycles && !c.maxCycles.compare_exchange_weak (maxCycles, cycles, std::memory_order_relaxed)) {
+    }
+}
+
+StageTimings::Histogram StageTimings::getHistogram (Stage stage) const
+{
+    // the counts can move on while they're read, so the buckets needn't add up to count exactly
+    auto& c = counters[static_cast<size_t> (stage)];
+    Histogram h;
+    for (size_t bucket = 0; bucket < h.buckets.size(); ++bucket) {
+        h.buckets[bucket] = c.buckets[bucket].load (std::memory_order_relaxed);
+    }
+    h.count = c.count.load (std::memory_order_relaxed);
+    h.totalCycles = c.totalCycles.load (std::memory_order_relaxed);
+    h.maxCycles = c.maxCycles.load (std::memory_order_relaxed);
+    return h;
+}
+
+void StageTimings::reset()
+{
+    for (auto& c : counters) {
+        for (auto& bucket : c.buckets) {
+            bucket.store (0, std::memory_order_relaxed);
+        }
+        c.count.store (0, std::memory_order_relaxed);
+        c.totalCycles.store (0, std::memory_order_relaxed);
+        c.maxCycles.store (0, std::memory_order_relaxed);
+    }
+}
+
+juce::String StageTimings::toString() const
+{
+    std::array<Histogram, numStages> histograms;
+    double totalCycles = 0;
+    for (int stage = 0; stage < numStages; ++stage) {
+        histograms[static_cast<size_t> (stage)] = getHistogram (static_cast<Stage> (stage));
+        totalCycles += static_cast<double> (histograms[static_cast<size_t> (stage)].totalCycles);
+    }
+
+    auto microseconds = 1.0e6 / getCyclesPerSecond();
+    juce::String text;
+    for (int stage = 0; stage < numStages; ++stage) {
+        auto& h = histograms[static_cast<size_t> (stage)];
+        text << juce::String (getName (static_cast<Stage> (stage))).paddedRight (' ', 10)
+             << juce::String (static_cast<juce::int64> (h.count)).paddedLeft (' ', 9)
+             << "  mean " << juce::String (h.getMeanCycles() * microseconds, 1).paddedLeft (' ', 8)
+             << "  p50 " << juce::String (static_cast<double> (h.getPercentileCycles (0.5)) * microseconds, 1).paddedLeft (' ', 8)
+             << "  p99 " << juce::String (static_cast<double> (h.getPercentileCycles (0.99)) * microseconds, 1).paddedLeft (' ', 8)
+             << "  max " << juce::String (static_cast<double> (h.maxCycles) * microseconds, 1).paddedLeft (' ', 9)
+             << "  " << juce::String (totalCycles > 0 ? 100 * static_cast<double> (h.totalCycles) / totalCycles : 0.0, 1).paddedLeft (' ', 5)
+             << "%\n";
+    }
+    return text;
+}
@@ -0,0 +1,83 @@
+#ifndef HOMER_STAGETIMINGS_H
+#define HOMER_STAGETIMINGS_H
+
+#include <array>
+#include <atomic>
+#include <juce_core/juce_core.h>
+
+#include <espeak-ng/speak_lib.h>
+#include <espeak-ng/espeak_ng.h>
+
+// Where an instance's CPU goes, as a histogram per stage of espeak_ng_ReadCycleCounter() counts.
+// Adding a time is a few relaxed atomic adds, so any thread can do it, the audio thread included,
+// and a snapshot can be taken from any other while they do.
+class StageTimings
+{
+public:
+    enum class Stage
+    {
+        translate, // lyrics into phonemes, in the background or when a note sings from its text
+        generate,  // espeak's Generate(), or replaying a recorded command stream
+        wavegen,   // making samples in whichever engine the note is in
+        handoff,   // what the audio thread waits on the espeak thread for beyond the stages above
+        resample   // the resampler, when the note isn't synthesized at the host rate
+    };
+    static constexpr int numStages = 5;
+
+    // bucket b counts the times of b bits, so from 2^(b-1) up to 2^b - 1 cycles
+    static constexpr int numBuckets = 48;
+
+    struct Histogram
+    {
+        std::array<juce::uint64, numBuckets> buckets {};
+        juce::uint64 count = 0;
+        juce::uint64 totalCycles = 0;
+        juce::uint64 maxCycles = 0;
+
+        double getMeanCycles() const { return count > 0 ? static_cast<double> (totalCycles) / static_cast<double> (count) : 0; }
+
+        // the time fraction of them took at most, rounded up to the top of its bucket
+        juce::uint64 getPercentileCycles (double fraction) const;
+    };
+
+    static juce::uint64 now() noexcept { return espeak_ng_ReadCycleCounter(); }
+
+    // the rate now() counts at, measured against JUCE's clock the first time it's asked for
+    static double getCyclesPerSecond();
+
+    static const char* getName (Stage stage);
+
+    void add (Stage stage, juce::uint64 cycles) noexcept;
+    Histogram getHistogram (Stage stage) const;
+    void reset();
+
+    // a line per stage with its count, mean, p50, p99 and max in microseconds and its share of the total
+    juce::String toString() const;
+
+private:
+    struct Counters
+    {
+        std::array<std::atomic<juce::uint64>, numBuckets> buckets {};
+        std::atomic<juce::uint64> count { 0 };
+        std::atomic<juce::uint64> totalCycles { 0 };
+        std::atomic<juce::uint64> maxCycles { 0 };
+    };
+    std::array<Counters, numStages> counters;
+};
+
+// adds the time from its construction to its destruction to the stage
+class ScopedStageTimer
+{
+public:
+    ScopedStageTimer (StageTimings& t, StageTimings::Stage s) noexcept : timings (t), stage (s), start (StageTimings::now()) {}
+    ~ScopedStageTimer() { timings.add (stage, StageTimings::now() - start); }
+
+private:
+    StageTimings& timings;
+    StageTimings::Stage stage;
+    juce::uint64 start;
+
+    JUCE_DECLARE_NON_COPYABLE (ScopedStageTimer)
+};
+
+#endif //HOMER_STAGETIMINGS_H
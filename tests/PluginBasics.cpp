@@ -1,11 +1,15 @@
 #include "dsp/EspeakThread.h"
 #include "dsp/HomerProcessor.h"
 #include "dsp/Resampler.h"
+#include "dsp/VoiceMidi.h"
 #include "helpers/test_helpers.h"
+#include "render/RenderJob.h"
 
 #include <PluginProcessor.h>
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/matchers/catch_matchers_string.hpp>
+#include <optional>
+#include <set>
 #include <vector>
 
 TEST_CASE ("one is equal to one", "[dummy]")
@@ -101,6 +105,27 @@ void carryOut(EspeakProcessorContext& epContext, int fs, juce::String outFileNam
     writer->writeFromAudioSampleBuffer (buffer, 0, buffer.getNumSamples());
 }
 
+// plays a note from the top of the first block until it goes quiet again, and returns how many seconds of
+// it had sound, 0 if it never made any. Every sample it makes has to be a number
+double renderUntilSilence (HomerProcessor& hp, int bufsiz, double rate)
+{
+    auto buffer = juce::AudioBuffer<float> (1, bufsiz);
+    int numBlocksWithSound = 0;
+    for (auto i = 0; i < 2000; ++i) {
+        buffer.clear();
+        hp.processBlock (buffer, 0, static_cast<unsigned int> (bufsiz), i == 0);
+        for (auto s = 0; s < bufsiz; ++s) {
+            REQUIRE (std::isfinite (buffer.getSample (0, s)));
+        }
+        if (buffer.getMagnitude (0, bufsiz) > 0) {
+            numBlocksWithSound++;
+        } else if (numBlocksWithSound > 0) {
+            break;
+        }
+    }
+    return numBlocksWithSound * bufsiz / rate;
+}
+
 /*TEST_CASE ("Basics of espeak", "[espeak]")
 {
     EspeakProcessorContext epContext;
@@ -126,7 +151,7 @@ TEST_CASE("debug print it all", "[printeverything]")
 {
     EspeakProcessorContext epContext;
     auto fs = prepareForEpBendTest(epContext);
-    epContext.bends.debugPrintEverything = true;
+    espeak_ng_SetTrace (&epContext, 1);
     carryOut (epContext, fs, juce::String("debugPrintEverything.wav"));
 }
 
@@ -331,7 +356,7 @@ TEST_CASE("Freezes", "[freeze]")
     auto buffer = juce::AudioBuffer<float> ();
     buffer.setSize (1, bufsiz);
     buffer.clear();
-    hs.lyrics[0] = "Hello Homer";
+    hs.setLyric (0, "Hello Homer");
     int i = 0;
     for (; i < 1000; ++i) {
         if (i == 4) {
@@ -392,7 +417,7 @@ TEST_CASE("Multiple notes", "[notes]")
     auto buffer = juce::AudioBuffer<float> ();
     buffer.setSize (1, bufsiz);
     buffer.clear();
-    hs.lyrics[0] = "Hello Homer";
+    hs.setLyric (0, "Hello Homer");
     int i = 0;
     for (; i < 1000; ++i) {
         buffer.clear();
@@ -459,6 +484,762 @@ TEST_CASE("Resampler trick", "[resamplertrick]")
     }
 }
 
+TEST_CASE("Polyphase resampler", "[resamplerpolyphase]")
+{
+    for (auto outputRate : {44100.0, 48000.0, 96000.0}) {
+        Resampler r;
+        r.prepareToPlay (outputRate);
+        r.setMode (Resampler::Mode::polyphase);
+        r.setInputSamplerate (22050);
+
+        auto inBuffer = juce::AudioBuffer<float> (1, 600);
+        auto buffer = juce::AudioBuffer<float> (1, 256);
+        float angle = 0;
+        float prev_out = 0;
+        float peak = 0;
+        for (auto iter = 0; iter < 40; ++iter) {
+            auto numSamplesNeeded = r.getNumSamplesNeeded (buffer.getNumSamples());
+            REQUIRE (numSamplesNeeded <= inBuffer.getNumSamples());
+            for (auto samp = 0; samp < numSamplesNeeded; ++samp) {
+                inBuffer.setSample (0, samp, sin (angle));
+                angle += 2 * M_PI * 200 / 22050;
+            }
+            r.resampleIntoBuffer (buffer.getWritePointer (0), buffer.getNumSamples(), inBuffer.getReadPointer (0), numSamplesNeeded);
+            for (auto samp = 0; samp < buffer.getNumSamples(); ++samp) {
+                auto next_out = buffer.getSample (0, samp);
+                REQUIRE (abs (next_out - prev_out) < 0.06);
+                prev_out = next_out;
+                if (iter > 4) {
+                    peak = std::max (peak, abs (next_out));
+                }
+            }
+        }
+        // unity gain in the passband, no overshoot
+        REQUIRE (peak > 0.99);
+        REQUIRE (peak < 1.01);
+    }
+}
+
+TEST_CASE("Resampler event positions", "[resamplerevents]")
+{
+    // an impulse peaks where the resampler says the sample it's on is heard, in either mode, at any clock
+    for (auto mode : { Resampler::Mode::lofi, Resampler::Mode::polyphase }) {
+        for (auto inputRate : { 8000.0f, 22050.0f, 40000.0f }) {
+            for (auto inputSample = 0; inputSample < 150; inputSample += 7) {
+                Resampler r;
+                r.prepareToPlay (48000);
+                r.setMode (mode);
+                r.setInputSamplerate (inputRate);
+
+                auto buffer = juce::AudioBuffer<float> (1, 1024);
+                auto numSamplesNeeded = r.getNumSamplesNeeded (buffer.getNumSamples());
+                auto inBuffer = juce::AudioBuffer<float> (1, numSamplesNeeded);
+                inBuffer.clear();
+                inBuffer.setSample (0, inputSample, 1);
+
+                auto heardAt = r.getOutputSampleFor (inputSample, buffer.getNumSamples());
+                r.resampleIntoBuffer (buffer.getWritePointer (0), buffer.getNumSamples(), inBuffer.getReadPointer (0), numSamplesNeeded);
+                auto* samples = buffer.getReadPointer (0);
+                auto peakAt = static_cast<int> (std::max_element (samples, samples + buffer.getNumSamples()) - samples);
+                REQUIRE (std::abs (peakAt - heardAt) <= 1);
+            }
+        }
+    }
+}
+
+TEST_CASE("Direct host rate synthesis", "[directrate]")
+{
+    for (auto hostRate : {48000.0, 96000.0}) {
+        HomerState hs;
+        HomerProcessor hp(hs);
+        auto bufsiz = 512;
+        hp.prepareToPlay (hostRate, bufsiz);
+        hs.setLyric (0, "Hello Homer");
+
+        // at the default clock speed the note should take as long at the host rate as it does at 22050
+        auto seconds = renderUntilSilence (hp, bufsiz, hostRate);
+        REQUIRE (seconds > 0.4);
+        REQUIRE (seconds < 2.0);
+        hp.releaseResources();
+    }
+}
+
+TEST_CASE("Aliasing automated across 0", "[directrate]")
+{
+    // at 0 the next note is set up at the host rate, anywhere else at espeak's, so automation going back
+    // and forth across it mustn't start a thread from processBlock every time it does
+    HomerState hs;
+    HomerProcessor hp(hs);
+    auto bufsiz = 512;
+    hp.prepareToPlay (48000, bufsiz);
+    hs.setLyric (0, "She sells seashells by the seashore");
+
+    auto buffer = juce::AudioBuffer<float> (1, bufsiz);
+    auto numBlocksWithSound = 0;
+    auto process = [&] (bool startNewNote) {
+        buffer.clear();
+        hp.processBlock (buffer, 0, static_cast<unsigned int> (bufsiz), startNewNote);
+        for (auto s = 0; s < bufsiz; ++s) {
+            REQUIRE (std::isfinite (buffer.getSample (0, s)));
+        }
+        numBlocksWithSound += buffer.getMagnitude (0, bufsiz) > 0;
+    };
+    process (true);
+    while (!hp.isReadyForNote()) {
+        juce::Thread::sleep (1);
+    }
+    auto numSetUp = hp.getNumEspeakThreadsSetUp();
+
+    // across and back every 4 blocks, about 43 ms
+    for (auto i = 0; i < 200; ++i) {
+        *hs.amountOfAliasing = (i / 4) % 2 == 0 ? 0.5f : 0.0f;
+        process (false);
+    }
+    REQUIRE (hp.getNumEspeakThreadsSetUp() == numSetUp);
+    REQUIRE (numBlocksWithSound > 0);
+
+    // held on the other side, the next note is set up for it once
+    *hs.amountOfAliasing = 0.5f;
+    for (auto i = 0; i < 20; ++i) {
+        process (false);
+    }
+    REQUIRE (hp.getNumEspeakThreadsSetUp() == numSetUp + 1);
+    hp.releaseResources();
+}
+
+TEST_CASE("Bend rescaler table", "[rescaler]")
+{
+    RescaleParameters parameters ("testrescale", "test rescale");
+    for (auto curve : {-1.f, -0.3f, 0.f, 0.5f, 1.f})
+    {
+        *parameters.curve = curve;
+        BendRescaler rescaler {};
+        rescaler.end = 1;
+        rescaler.curve = curve;
+        for (int i = 0; i <= 1000; i++)
+        {
+            auto x = i / 1000.f;
+            auto exact = std::pow (x, std::pow (5.f, -curve));
+            auto fromTable = applyBendRescaler (&rescaler, x, 0, 1);
+            REQUIRE (std::abs (fromTable - exact) < (x < 1.f / BEND_RESCALER_TABLE_SIZE ? 1e-6f : 0.005f));
+            // the editor has to draw the curve the synth uses
+            REQUIRE (parameters.rescale (x) == fromTable);
+        }
+    }
+}
+
+TEST_CASE("Synthesis engines", "[engine]")
+{
+    for (auto engineIndex = 0; engineIndex < 3; ++engineIndex) {
+        HomerState hs;
+        HomerProcessor hp(hs);
+        auto bufsiz = 512;
+        *hs.engine = engineIndex;
+        hp.prepareToPlay (48000, bufsiz);
+        hs.setLyric (0, "Hello Homer");
+
+        // every engine has to reach the plugin buffer, not just espeak's own output buffer
+        auto seconds = renderUntilSilence (hp, bufsiz, 48000.0);
+        REQUIRE (seconds > 0.4);
+        REQUIRE (seconds < 2.0);
+        hp.releaseResources();
+    }
+}
+
+TEST_CASE("Phoneme rotation", "[rotation]")
+{
+    // one seeded note offline, with the phonemes it sang
+    struct Render
+    {
+        std::vector<float> samples;
+        std::vector<VoiceEvent> phonemes;
+    };
+    auto render = [] (int engineIndex, std::optional<float> rotation) {
+        HomerState hs;
+        hs.deterministic = true;
+        *hs.engine = engineIndex;
+        if (rotation.has_value()) {
+            *hs.phonemeRotationParam = *rotation;
+        }
+        HomerProcessor hp(hs);
+        hp.setOffline (true);
+        auto bufsiz = 512;
+        hp.prepareToPlay (48000, bufsiz);
+        hs.setLyric (0, "She sells seashells by the seashore");
+
+        Render result;
+        auto buffer = juce::AudioBuffer<float> (1, bufsiz);
+        for (auto i = 0; i < 400; ++i) {
+            buffer.clear();
+            hp.processBlock (buffer, 0, static_cast<unsigned int> (bufsiz), i == 0);
+            result.samples.insert (result.samples.end(), buffer.getReadPointer (0), buffer.getReadPointer (0) + bufsiz);
+            for (auto& event : hp.getEvents()) {
+                if (event.type == VoiceEvent::Type::phoneme) {
+                    result.phonemes.push_back (event);
+                }
+            }
+        }
+        hp.releaseResources();
+        return result;
+    };
+
+    for (auto engineIndex = 0; engineIndex < 3; ++engineIndex) {
+        auto unrotated = render (engineIndex, std::nullopt);
+        REQUIRE (unrotated.phonemes.size() > 10);
+
+        // no rotation, or less than a step of it, leaves the note as it was
+        for (auto rotation : { 0.0f, 0.05f }) {
+            auto same = render (engineIndex, rotation);
+            REQUIRE (same.samples == unrotated.samples);
+            REQUIRE (same.phonemes.size() == unrotated.phonemes.size());
+            for (size_t i = 0; i < same.phonemes.size(); ++i) {
+                REQUIRE (same.phonemes[i].phoneme == unrotated.phonemes[i].phoneme);
+            }
+        }
+
+        // any more sings other phonemes, however far it goes, but each one from the same class as the
+        // phoneme it replaced, so vowels stay vowels and nothing that made a sound turns into a pause
+        for (auto rotation : { 0.1f, 0.5f, 1.0f }) {
+            auto rotated = render (engineIndex, rotation);
+            REQUIRE (rotated.samples != unrotated.samples);
+            REQUIRE (std::all_of (rotated.samples.begin(), rotated.samples.end(), [] (float sample) { return std::isfinite (sample); }));
+            REQUIRE (std::any_of (rotated.samples.begin(), rotated.samples.end(), [] (float sample) { return sample != 0; }));
+            REQUIRE (rotated.phonemes.size() == unrotated.phonemes.size());
+            size_t numRotated = 0;
+            for (size_t i = 0; i < rotated.phonemes.size(); ++i) {
+                REQUIRE (rotated.phonemes[i].phonemeClass == unrotated.phonemes[i].phonemeClass);
+                numRotated += rotated.phonemes[i].phoneme != unrotated.phonemes[i].phoneme;
+            }
+            REQUIRE (numRotated > rotated.phonemes.size() / 2);
+        }
+    }
+}
+
+TEST_CASE("Phoneme cache", "[phonemecache]")
+{
+    HomerState hs;
+    auto voice = hs.voiceNames[*hs.languageSelectors[0]];
+    hs.setLyric (0, "Hello Homer");
+    auto version = hs.phonemeCache.getVersion (0);
+
+    auto waitForTranslation = [&hs] (const juce::String& lyric, const juce::String& voice) {
+        for (auto i = 0; i < 500 && hs.phonemeCache.find (lyric, voice) == nullptr; ++i) {
+            juce::Thread::sleep (10);
+        }
+        return hs.phonemeCache.find (lyric, voice);
+    };
+    REQUIRE (waitForTranslation ("Hello Homer", voice) != nullptr);
+    REQUIRE (hs.phonemeCache.find ("Hello Homer", voice)->commands != nullptr);
+    REQUIRE (hs.phonemeCache.find ("Hello Homer", hs.voiceNames[1]) == nullptr);
+
+    // a note sung from the cache should sound like one translated on the fly
+    HomerProcessor hp(hs);
+    auto bufsiz = 512;
+    hp.prepareToPlay (48000, bufsiz);
+    auto seconds = renderUntilSilence (hp, bufsiz, 48000.0);
+    REQUIRE (seconds > 0.4);
+    REQUIRE (seconds < 2.0);
+
+    // rotated phonemes aren't in the recording, so that note is generated from the phonemes
+    *hs.phonemeRotationParam = 0.1f;
+    REQUIRE (renderUntilSilence (hp, bufsiz, 48000.0) > 0);
+    hp.releaseResources();
+
+    // editing the line gives it a new version and throws its old translation away
+    hs.setLyric (0, "Hello Homer");
+    REQUIRE (hs.phonemeCache.getVersion (0) == version);
+    hs.setLyric (0, "Goodbye Homer");
+    REQUIRE (hs.phonemeCache.getVersion (0) != version);
+    REQUIRE (hs.phonemeCache.find ("Hello Homer", voice) == nullptr);
+    REQUIRE (hs.phonemeCache.tryGetTranslation (0, version) == nullptr);
+    REQUIRE (waitForTranslation ("Goodbye Homer", voice) != nullptr);
+}
+
+TEST_CASE("Offline rendering", "[offline]")
+{
+    auto bufsiz = 512;
+    auto renderNote = [bufsiz] (bool offline) {
+        HomerState hs;
+        HomerProcessor hp(hs);
+        hp.setOffline (offline);
+        hp.prepareToPlay (48000, bufsiz);
+        hs.setLyric (0, "Hello Homer");
+        std::vector<float> samples;
+        auto buffer = juce::AudioBuffer<float> (1, bufsiz);
+        for (auto i = 0; i < 2000; ++i) {
+            buffer.clear();
+            hp.processBlock (buffer, 0, bufsiz, i == 0);
+            if (buffer.getMagnitude (0, bufsiz) == 0 && !samples.empty()) {
+                break;
+            }
+            samples.insert (samples.end(), buffer.getReadPointer (0), buffer.getReadPointer (0) + bufsiz);
+        }
+        hp.releaseResources();
+        return samples;
+    };
+
+    // pulling the samples on this thread has to sing the same note as handing blocks to the espeak thread
+    auto offline = renderNote (true);
+    auto seconds = offline.size() / 48000.0;
+    REQUIRE (seconds > 0.4);
+    REQUIRE (seconds < 2.0);
+    REQUIRE (offline == renderNote (false));
+
+    // notes started back to back, some of them from spares set up on the pool
+    HomerState hs;
+    HomerProcessor hp(hs);
+    hp.setOffline (true);
+    hp.prepareToPlay (44100, bufsiz);
+    hs.setLyric (0, "Hello Homer");
+    hs.setLyric (1, "Goodbye Homer");
+    auto buffer = juce::AudioBuffer<float> (1, bufsiz);
+    for (auto note = 0; note < 12; ++note) {
+        *hs.lyricSelector = note % 2 + 1;
+        float peak = 0;
+        for (auto i = 0; i < 20; ++i) {
+            buffer.clear();
+            hp.processBlock (buffer, 0, bufsiz, i == 0);
+            peak = std::max (peak, buffer.getMagnitude (0, bufsiz));
+        }
+        REQUIRE (peak > 0);
+    }
+
+    // going back to real time picks up the espeak threads again
+    hp.setOffline (false);
+    REQUIRE (!hp.isOffline());
+    float peak = 0;
+    for (auto i = 0; i < 20; ++i) {
+        buffer.clear();
+        hp.processBlock (buffer, 0, bufsiz, i == 0);
+        peak = std::max (peak, buffer.getMagnitude (0, bufsiz));
+    }
+    REQUIRE (peak > 0);
+    hp.releaseResources();
+}
+
+TEST_CASE("Voice events", "[events]")
+{
+    auto bufsiz = 512;
+    auto renderEvents = [bufsiz] (bool offline) {
+        HomerState hs;
+        HomerProcessor hp(hs);
+        hp.setOffline (offline);
+        hp.prepareToPlay (48000, bufsiz);
+        hs.setLyric (0, "Hello Homer");
+        std::vector<VoiceEvent> events;
+        auto buffer = juce::AudioBuffer<float> (1, bufsiz);
+        auto capacity = hp.getEvents().capacity();
+        for (auto i = 0; i < 2000; ++i) {
+            buffer.clear();
+            hp.processBlock (buffer, 0, bufsiz, i == 0);
+            events.insert (events.end(), hp.getEvents().begin(), hp.getEvents().end());
+            if (buffer.getMagnitude (0, bufsiz) == 0 && !events.empty()) {
+                break;
+            }
+        }
+        // nothing was allocated for them after prepareToPlay
+        REQUIRE (hp.getEvents().capacity() == capacity);
+        hp.releaseResources();
+        return events;
+    };
+
+    auto events = renderEvents (true);
+    for (auto& event : events) {
+        REQUIRE (event.offset >= 0);
+        REQUIRE (event.offset < bufsiz);
+    }
+    auto isType = [] (VoiceEvent::Type type) { return [type] (const VoiceEvent& event) { return event.type == type; }; };
+    REQUIRE (std::count_if (events.begin(), events.end(), isType (VoiceEvent::Type::word)) == 2);
+    REQUIRE (std::count_if (events.begin(), events.end(), isType (VoiceEvent::Type::phoneme)) > 6);
+    REQUIRE (std::is_sorted (events.begin(), events.end(), [] (auto& a, auto& b) { return a.sample < b.sample; }));
+    REQUIRE (events.back().sample > 0.4 * HomerProcessor::espeakSampleRate);
+
+    // the espeak thread blocking in wavegen counts its samples the same as pulling them
+    auto realtimeEvents = renderEvents (false);
+    REQUIRE (realtimeEvents.size() == events.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+        REQUIRE (realtimeEvents[i].type == events[i].type);
+        REQUIRE (realtimeEvents[i].sample == events[i].sample);
+        REQUIRE (realtimeEvents[i].phoneme == events[i].phoneme);
+    }
+}
+
+TEST_CASE("Voice event queue", "[events]")
+{
+    // it holds all of capacity, and after that the new events are dropped and counted, not the old ones
+    VoiceEventQueue queue;
+    for (auto i = 0; i < VoiceEventQueue::capacity; ++i) {
+        VoiceEvent event;
+        event.sample = i;
+        REQUIRE (queue.push (event));
+    }
+    REQUIRE (queue.getNumReady() == VoiceEventQueue::capacity);
+    VoiceEvent extra;
+    extra.sample = VoiceEventQueue::capacity;
+    REQUIRE (!queue.push (extra));
+    REQUIRE (!queue.push (extra));
+    REQUIRE (queue.getNumDropped() == 2);
+
+    std::vector<juce::int64> samples;
+    queue.popAll ([&samples] (const VoiceEvent& event) { samples.push_back (event.sample); });
+    REQUIRE (samples.size() == VoiceEventQueue::capacity);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        REQUIRE (samples[i] == static_cast<juce::int64> (i));
+    }
+
+    // and once it's been emptied there's room again, across the wrap
+    REQUIRE (queue.push (extra));
+    REQUIRE (queue.getNumReady() == 1);
+    REQUIRE (queue.getNumDropped() == 2);
+}
+
+TEST_CASE("Voice MIDI", "[voicemidi]")
+{
+    auto bufsiz = 480;
+    HomerState hs;
+    HomerProcessor hp(hs);
+    hp.setOffline (true);
+    hp.prepareToPlay (48000, bufsiz);
+    hs.setLyric (0, "Hello Homer");
+    VoiceMidi voiceMidi;
+    juce::MidiBuffer midi;
+    std::vector<std::pair<int, juce::MidiMessage>> messages;
+    auto buffer = juce::AudioBuffer<float> (1, bufsiz);
+    int numPhonemes = 0;
+    for (auto i = 0; i < 400; ++i) {
+        buffer.clear();
+        hp.processBlock (buffer, 0, bufsiz, i == 0);
+        for (auto& event : hp.getEvents()) {
+            numPhonemes += event.type == VoiceEvent::Type::phoneme && event.phonemeClass != VoiceEvent::PhonemeClass::silent;
+        }
+        midi.clear();
+        voiceMidi.addEvents (hp.getEvents(), midi);
+        for (const auto metadata : midi) {
+            REQUIRE (metadata.samplePosition >= 0);
+            REQUIRE (metadata.samplePosition < bufsiz);
+            messages.emplace_back (i * bufsiz + metadata.samplePosition, metadata.getMessage());
+        }
+    }
+    hp.releaseResources();
+
+    // a note for each word and each sounding phoneme, all let go of by the end of the sentence
+    auto numNoteOns = std::count_if (messages.begin(), messages.end(), [] (auto& m) { return m.second.isNoteOn(); });
+    auto numWords = std::count_if (messages.begin(), messages.end(), [] (auto& m) {
+        return m.second.isNoteOn() && m.second.getNoteNumber() == VoiceMidi::wordNote;
+    });
+    REQUIRE (numWords == 2);
+    REQUIRE (numNoteOns == numWords + numPhonemes);
+    REQUIRE (std::count_if (messages.begin(), messages.end(), [] (auto& m) { return m.second.isNoteOff(); }) == numNoteOns);
+    REQUIRE (std::is_sorted (messages.begin(), messages.end(), [] (auto& a, auto& b) { return a.first < b.first; }));
+
+    // the first phoneme, an h, starts a fricative a few milliseconds in, after the resampler's latency
+    auto firstPhoneme = std::find_if (messages.begin(), messages.end(), [] (auto& m) {
+        return m.second.isNoteOn() && m.second.getNoteNumber() != VoiceMidi::wordNote;
+    });
+    REQUIRE (firstPhoneme->second.getNoteNumber() == VoiceMidi::phonemeNoteBase + 3);
+    REQUIRE (firstPhoneme->first > 0);
+    REQUIRE (firstPhoneme->first < 48000 / 50);
+}
+
+TEST_CASE("Voice MIDI in the host's buffer", "[voicemidi]")
+{
+    // the way a host drives it, one buffer handed in every block with whatever was played in it
+    auto bufsiz = 480;
+    PluginProcessor plugin;
+    plugin.prepareToPlay (48000, bufsiz);
+    plugin.homerState.setLyric (0, "Hello Homer");
+    auto buffer = juce::AudioBuffer<float> (2, bufsiz);
+    juce::MidiBuffer midi;
+    midi.addEvent (juce::MidiMessage::noteOn (1, 60, static_cast<juce::uint8> (100)), 0);
+
+    // the first block makes the buffer room for anything a block can send, and it never grows after
+    int numBytesAllocated = 0;
+    int numNoteOns = 0;
+    for (auto i = 0; i < 400; ++i) {
+        buffer.clear();
+        plugin.processBlock (buffer, midi);
+        if (i == 0) {
+            numBytesAllocated = midi.data.getNumAllocated();
+            REQUIRE (numBytesAllocated >= VoiceMidi::maxBytesPerBlock);
+        }
+        REQUIRE (midi.data.getNumAllocated() == numBytesAllocated);
+        for (const auto metadata : midi) {
+            numNoteOns += metadata.getMessage().isNoteOn();
+        }
+    }
+    REQUIRE (numNoteOns > 2);
+}
+
+TEST_CASE("Synthesis trace", "[trace]")
+{
+    auto bufsiz = 512;
+    for (auto offline : { true, false }) {
+        // gone again however the section ends, failed REQUIREs included
+        juce::TemporaryFile temporaryFile (".trace");
+        auto file = temporaryFile.getFile();
+        {
+            HomerState hs;
+            HomerProcessor hp(hs);
+            REQUIRE (hp.startTrace (file));
+            hp.setOffline (offline);
+            hp.prepareToPlay (48000, bufsiz);
+            hs.setLyric (0, "Hello Homer");
+            auto buffer = juce::AudioBuffer<float> (1, bufsiz);
+            for (auto i = 0; i < 400; ++i) {
+                buffer.clear();
+                hp.processBlock (buffer, 0, bufsiz, i == 0);
+            }
+            hp.releaseResources();
+        }
+
+        // the writer has written out everything it collected by the time it's gone
+        juce::MemoryBlock data;
+        REQUIRE (file.loadFileAsData (data));
+        REQUIRE (data.getSize() > 3 * sizeof (juce::uint32));
+        auto* header = static_cast<const juce::uint32*> (data.getData());
+        REQUIRE (header[0] == TraceWriter::magic);
+        REQUIRE (header[1] == TraceWriter::version);
+        REQUIRE (header[2] == sizeof (espeak_TRACE_RECORD));
+        std::vector<espeak_TRACE_RECORD> records ((data.getSize() - 3 * sizeof (juce::uint32)) / sizeof (espeak_TRACE_RECORD));
+        std::memcpy (records.data(), header + 3, records.size() * sizeof (espeak_TRACE_RECORD));
+
+        // one note, which the spare notes set up offline never got to start
+        REQUIRE (records.front().type == espeakTRACE_START);
+        REQUIRE (records.front().u.start.samplerate == HomerProcessor::espeakSampleRate);
+        auto isType = [] (int type) { return [type] (const espeak_TRACE_RECORD& record) { return record.type == type; }; };
+        REQUIRE (std::count_if (records.begin(), records.end(), isType (espeakTRACE_START)) == 1);
+
+        std::vector<espeak_TRACE_RECORD> frames;
+        std::copy_if (records.begin(), records.end(), std::back_inserter (frames), isType (espeakTRACE_FRAME));
+        REQUIRE (frames.size() > 100);
+        REQUIRE (std::is_sorted (frames.begin(), frames.end(), [] (auto& a, auto& b) { return a.sample < b.sample; }));
+        REQUIRE (frames.back().sample < 0.25 * 400 * bufsiz);
+        for (auto& frame : frames) {
+            REQUIRE (frame.u.frame.pitch > 0);
+            REQUIRE (frame.u.frame.n_peaks <= espeakTRACE_PEAKS);
+        }
+        // the phoneme events say which phoneme the frames are part of, whether the note generated its
+        // phonemes, which traces them too, or replayed the commands recorded when the line was translated
+        std::set<std::string> phonemes;
+        for (auto& frame : frames) {
+            phonemes.insert (std::string (frame.phoneme, strnlen (frame.phoneme, sizeof (frame.phoneme))));
+        }
+        REQUIRE (phonemes.size() > 4);
+        REQUIRE (std::string (frames.back().phoneme, strnlen (frames.back().phoneme, sizeof (frames.back().phoneme))) == "3");
+    }
+}
+
+TEST_CASE("Stage timings", "[timings]")
+{
+    StageTimings timings;
+    for (juce::uint64 cycles = 1; cycles <= 1000; ++cycles) {
+        timings.add (StageTimings::Stage::generate, cycles);
+    }
+    auto h = timings.getHistogram (StageTimings::Stage::generate);
+    REQUIRE (h.count == 1000);
+    REQUIRE (h.maxCycles == 1000);
+    REQUIRE (h.getMeanCycles() == 500.5);
+    // 500 takes 9 bits, so the median is put at the top of the 256 to 511 bucket
+    REQUIRE (h.getPercentileCycles (0.5) == 511);
+    REQUIRE (h.getPercentileCycles (1.0) == 1000);
+    timings.reset();
+    REQUIRE (timings.getHistogram (StageTimings::Stage::generate).count == 0);
+
+    auto bufsiz = 512;
+    for (auto offline : { true, false }) {
+        HomerState hs;
+        HomerProcessor hp(hs);
+        hp.setOffline (offline);
+        hp.prepareToPlay (48000, bufsiz);
+        hs.setLyric (0, "Hello Homer");
+        auto buffer = juce::AudioBuffer<float> (1, bufsiz);
+        for (auto i = 0; i < 400; ++i) {
+            buffer.clear();
+            hp.processBlock (buffer, 0, bufsiz, i == 0);
+        }
+        hp.releaseResources();
+        hs.phonemeCache.waitForTranslation (0, hs.phonemeCache.getVersion (0), 2000);
+
+        auto count = [&hs] (StageTimings::Stage stage) { return hs.stageTimings.getHistogram (stage).count; };
+        REQUIRE (count (StageTimings::Stage::translate) > 0);
+        REQUIRE (count (StageTimings::Stage::generate) > 0);
+        // every block the note sang in made samples, and at 48k every one was resampled
+        REQUIRE (count (StageTimings::Stage::wavegen) > 50);
+        REQUIRE (count (StageTimings::Stage::resample) > 50);
+        REQUIRE (count (StageTimings::Stage::resample) <= 400);
+        REQUIRE ((count (StageTimings::Stage::handoff) > 0) == !offline);
+        REQUIRE (hs.stageTimings.toString().contains ("wavegen"));
+    }
+}
+
+TEST_CASE("Render job", "[renderjob]")
+{
+    RenderJob job;
+    job.lyrics[0] = "Hello Homer";
+    job.notes.addEvent (juce::MidiMessage::noteOn (1, 60, 0.8f).withTimeStamp (0.1));
+    job.notes.addEvent (juce::MidiMessage::noteOff (1, 60).withTimeStamp (1.1));
+    job.notes.updateMatchedPairs();
+    job.tailSeconds = 0.5;
+
+    auto dir = juce::File::createTempFile ("renderjob");
+    dir.createDirectory();
+    auto csv = dir.getChildFile ("bends.csv");
+    csv.replaceWithText ("time,parameter,value\n0,pitchbend,0\n1,pitchbend,0.5\n");
+    REQUIRE (job.loadAutomationFile (csv).wasOk());
+    REQUIRE (job.automation["pitchbend"].size() == 2);
+    auto json = dir.getChildFile ("bends.json");
+    json.replaceWithText (R"({"vibrato": [[1, 0.5], [0, 0]], "cvblend": 0.25})");
+    REQUIRE (job.loadAutomationFile (json).wasOk());
+    REQUIRE (job.automation["vibrato"].front().time == 0);
+    REQUIRE (job.automation["cvblend"].size() == 1);
+
+    juce::AudioBuffer<float> audio;
+    REQUIRE (job.render (audio).wasOk());
+    REQUIRE (audio.getNumSamples() == static_cast<int> (std::ceil (1.6 * job.sampleRate)));
+    REQUIRE (audio.getMagnitude (0, 0, audio.getNumSamples()) > 0);
+
+    auto wav = dir.getChildFile ("take.wav");
+    REQUIRE (RenderJob::writeWav (audio, job.sampleRate, wav, 24).wasOk());
+    REQUIRE (wav.getSize() > audio.getNumSamples() * 2 * 3);
+
+    // a warm plugin, like homer-renderd's, streams the same job block by block, even after singing another
+    PluginProcessor plugin;
+    RenderJob other;
+    other.lyrics[0] = "Goodbye Homer";
+    other.voices[0] = plugin.homerState.voiceNames[0];
+    REQUIRE (other.loadNotes (juce::JSON::parse ("[[0, 0.5, 64, 100]]")).wasOk());
+    REQUIRE (other.render (plugin, [] (const juce::AudioBuffer<float>&) { return true; }).wasOk());
+    int numStreamed = 0;
+    float peak = 0;
+    REQUIRE (job.render (plugin, [&] (const juce::AudioBuffer<float>& block) {
+        numStreamed += block.getNumSamples();
+        peak = std::max (peak, block.getMagnitude (0, 0, block.getNumSamples()));
+        return true;
+    }).wasOk());
+    REQUIRE (numStreamed == audio.getNumSamples());
+    REQUIRE (peak > 0);
+    REQUIRE (job.render (plugin, [] (const juce::AudioBuffer<float>&) { return false; }).failed());
+
+    job.automation["nosuchparameter"].push_back ({ 0, 1 });
+    REQUIRE (job.render (audio).failed());
+    dir.deleteRecursively();
+}
+
+TEST_CASE("Plugin state", "[state]")
+{
+    PluginProcessor saved;
+    auto& hs = saved.homerState;
+    *hs.languageSelectors[2] = 12;
+    hs.setLyric (0, "Hello Homer");
+    hs.setLyric (2, "Goodbye Homer");
+    *hs.vibrato = 0.5f;
+    *hs.engine = 2;
+    juce::MemoryBlock state;
+    saved.getStateInformation (state);
+    REQUIRE (state.getSize() < 1024);
+
+    PluginProcessor loaded;
+    auto& ls = loaded.homerState;
+    loaded.setStateInformation (state.getData(), static_cast<int> (state.getSize()));
+    for (int line = 0; line < HomerState::numLyricLines; ++line) {
+        REQUIRE (ls.getLyric (line) == hs.getLyric (line));
+    }
+    REQUIRE (ls.languageSelectors[2]->getIndex() == 12);
+    REQUIRE (ls.vibrato->get() == 0.5f);
+    REQUIRE (ls.engine->getIndex() == 2);
+    for (int i = 0; i < loaded.getParameters().size(); ++i) {
+        REQUIRE (loaded.getParameters()[i]->getValue() == saved.getParameters()[i]->getValue());
+    }
+
+    // loading it again changes nothing, and a state with one line edited only changes that line
+    std::array<int, HomerState::numLyricLines> versions;
+    for (int line = 0; line < HomerState::numLyricLines; ++line) {
+        versions[static_cast<size_t> (line)] = ls.phonemeCache.getVersion (line);
+    }
+    loaded.setStateInformation (state.getData(), static_cast<int> (state.getSize()));
+    hs.setLyric (2, "Hello again");
+    saved.getStateInformation (state);
+    loaded.setStateInformation (state.getData(), static_cast<int> (state.getSize()));
+    for (int line = 0; line < HomerState::numLyricLines; ++line) {
+        REQUIRE ((ls.phonemeCache.getVersion (line) != versions[static_cast<size_t> (line)]) == (line == 2));
+    }
+    REQUIRE (ls.getLyric (2) == "Hello again");
+
+    // anything else is left alone
+    REQUIRE (!ls.loadState ("not a state", 11));
+    state.setSize (state.getSize() / 2);
+    REQUIRE (!ls.loadState (state.getData(), state.getSize()));
+    REQUIRE (ls.getLyric (2) == "Hello again");
+}
+
+TEST_CASE("Deterministic renders", "[deterministic]")
+{
+    // stuck phonemes and klatt's noise both come from the random numbers
+    auto renderNotes = [] (bool offline, const std::vector<int>& blockSizes, juce::uint32 seed) {
+        HomerState hs;
+        hs.deterministic = true;
+        hs.sessionSeed = seed;
+        *hs.phonemeStickParam = 0.4f;
+        *hs.engine = 1;
+        HomerProcessor hp(hs);
+        hp.setOffline (offline);
+        hp.prepareToPlay (48000, 1024);
+        hs.setLyric (0, "She sells seashells by the seashore");
+        hs.setLyric (1, "Hello Homer");
+
+        // two notes, the second on the other line, each starting at the top of a block
+        std::vector<float> samples;
+        for (auto note = 0; note < 2; ++note) {
+            *hs.lyricSelector = note + 1;
+            while (!hp.isReadyForNote()) {
+                juce::Thread::sleep (1);
+            }
+            auto noteStart = samples.size();
+            for (size_t i = 0; samples.size() < noteStart + 96000; ++i) {
+                auto blockSize = std::min (blockSizes[i % blockSizes.size()], static_cast<int> (noteStart + 96000 - samples.size()));
+                auto buffer = juce::AudioBuffer<float> (1, blockSize);
+                buffer.clear();
+                hp.processBlock (buffer, 0, static_cast<unsigned int> (blockSize), i == 0);
+                samples.insert (samples.end(), buffer.getReadPointer (0), buffer.getReadPointer (0) + blockSize);
+            }
+        }
+        hp.releaseResources();
+        return samples;
+    };
+
+    // the same samples whatever the block sizes, and whether espeak runs on this thread or its own
+    auto reference = renderNotes (true, { 512 }, 1234);
+    REQUIRE (std::any_of (reference.begin(), reference.end(), [] (float sample) { return sample != 0; }));
+    REQUIRE (renderNotes (true, { 512 }, 1234) == reference);
+    REQUIRE (renderNotes (true, { 32, 1000, 7, 333 }, 1234) == reference);
+    REQUIRE (renderNotes (false, { 256 }, 1234) == reference);
+    REQUIRE (renderNotes (false, { 64, 517 }, 1234) == reference);
+    REQUIRE (renderNotes (true, { 512 }, 4321) != reference);
+
+    // a real time note played while its line is still being translated isn't dropped, it sings late
+    {
+        HomerState hs;
+        hs.deterministic = true;
+        HomerProcessor hp(hs);
+        hp.prepareToPlay (48000, 512);
+        hs.setLyric (0, "She sells seashells by the seashore");
+        REQUIRE (renderUntilSilence (hp, 512, 48000.0) > 0.4);
+        REQUIRE (hp.getNumLateNotes() <= 1);
+        hp.releaseResources();
+    }
+
+    // the seeding is saved with the session
+    PluginProcessor saved;
+    saved.homerState.deterministic = true;
+    saved.homerState.sessionSeed = 4321;
+    juce::MemoryBlock state;
+    saved.getStateInformation (state);
+    PluginProcessor loaded;
+    loaded.setStateInformation (state.getData(), static_cast<int> (state.getSize()));
+    REQUIRE (loaded.homerState.deterministic.load());
+    REQUIRE (loaded.homerState.sessionSeed.load() == 4321u);
+}
+
 TEST_CASE ("Can Homers Agree on anything?", "[tworuns]")
 {
     std::vector<std::unique_ptr<HomerState>> hs;
@@ -474,8 +1255,8 @@ TEST_CASE ("Can Homers Agree on anything?", "[tworuns]")
     }
 
 
-    hs[0]->lyrics[0] = "I am purple homer!";
-    hs[1]->lyrics[0] = "I am purple homer!";
+    hs[0]->setLyric (0, "I am purple homer!");
+    hs[1]->setLyric (0, "I am purple homer!");
 
     auto buffer = juce::AudioBuffer<float> ();
     buffer.setSize (1, bufsiz);
@@ -530,7 +1311,7 @@ TEST_CASE ("Three homers at once", "[three homers at once]")
     }
 
     for (auto& states : hs) {
-        states->lyrics[0] = "I am purple homer!";
+        states->setLyric (0, "I am purple homer!");
     }
 
     auto buffer = juce::AudioBuffer<float> ();
@@ -566,9 +1347,9 @@ TEST_CASE ("Homer but there's another homer at the same time saying something el
     }
 
 
-    hs[0]->lyrics[0] = "I am purple homer!";
-    hs[1]->lyrics[0] = "yellow homer is my name.";
-    hs[2]->lyrics[0] = "I am purple homer!";
+    hs[0]->setLyric (0, "I am purple homer!");
+    hs[1]->setLyric (0, "yellow homer is my name.");
+    hs[2]->setLyric (0, "I am purple homer!");
 
     auto buffer = juce::AudioBuffer<float> ();
     buffer.setSize (1, bufsiz);
@@ -0,0 +1,145 @@
+// homer-render: bounces takes to WAV without a host, as many at once as there are cores.
+//
+//   homer-render --midi take.mid --lyric "first line" [--lyric "second line" ...]
+//                [--voice "English (America)" ...] [--automation bends.csv|bends.json]
+//                [--rate 48000] [--block 512] [--tail 2] [--seed 1234] [--bits 24] --output take.wav
+//   homer-render --jobs jobs.json [--threads 8] [--bits 24]
+//   homer-render --list-voices
+//
+// A jobs file is an array of objects with the keys lyrics, voices, midi, automation
+// (a file or an inline object), sampleRate, blockSize, tail, seed and output, with paths
+// relative to the jobs file. A seed makes the take come out the same every time.
+
+#include "render/RenderJob.h"
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include <iostream>
+
+static void printUsage()
+{
+    std::cerr << "usage: homer-render --midi FILE --lyric TEXT [--lyric TEXT ...] [--voice NAME ...]\n"
+                 "                    [--automation FILE] [--rate HZ] [--block SAMPLES] [--tail SECONDS]\n"
+                 "                    [--seed N] [--bits 16|24|32] --output FILE\n"
+                 "       homer-render --jobs FILE [--threads N] [--bits 16|24|32]\n"
+                 "       homer-render --list-voices\n";
+}
+
+int main (int argc, char* argv[])
+{
+    // the plugin's parameters and threads expect JUCE to be up, like in the Tests target
+    juce::ScopedJuceInitialiser_GUI gui;
+
+    RenderJob job;
+    juce::File jobsFile;
+    int numThreads = juce::SystemStats::getNumCpus();
+    int bitsPerSample = 24;
+    int numLyrics = 0, numVoices = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        juce::String option (argv[i]);
+        if (option == "--list-voices") {
+            HomerState hs;
+            for (auto& name : hs.voiceNames) {
+                std::cout << name << "\n";
+            }
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+        juce::String value (argv[++i]);
+        auto result = juce::Result::ok();
+
+        if (option == "--lyric" && numLyrics < HomerState::numLyricLines) {
+            job.lyrics[static_cast<size_t> (numLyrics++)] = value;
+        } else if (option == "--voice" && numVoices < HomerState::numLyricLines) {
+            job.voices[static_cast<size_t> (numVoices++)] = value;
+        } else if (option == "--midi") {
+            result = job.loadMidiFile (juce::File::getCurrentWorkingDirectory().getChildFile (value));
+        } else if (option == "--automation") {
+            result = job.loadAutomationFile (juce::File::getCurrentWorkingDirectory().getChildFile (value));
+        } else if (option == "--rate") {
+            job.sampleRate = value.getDoubleValue();
+        } else if (option == "--block") {
+            job.blockSize = value.getIntValue();
+        } else if (option == "--tail") {
+            job.tailSeconds = value.getDoubleValue();
+        } else if (option == "--seed") {
+            job.seed = static_cast<juce::uint32> (value.getLargeIntValue());
+        } else if (option == "--output") {
+            job.outputFile = juce::File::getCurrentWorkingDirectory().getChildFile (value);
+        } else if (option == "--jobs") {
+            jobsFile = juce::File::getCurrentWorkingDirectory().getChildFile (value);
+        } else if (option == "--threads") {
+            numThreads = std::max (1, value.getIntValue());
+        } else if (option == "--bits") {
+            bitsPerSample = value.getIntValue();
+        } else {
+            printUsage();
+            return 1;
+        }
+
+        if (result.failed()) {
+            std::cerr << result.getErrorMessage() << "\n";
+            return 1;
+        }
+    }
+
+    std::vector<RenderJob> jobs;
+    if (jobsFile != juce::File()) {
+        juce::var json;
+        auto parsed = juce::JSON::parse (jobsFile.loadFileAsString(), json);
+        if (parsed.failed() || !json.isArray()) {
+            std::cerr << jobsFile.getFullPathName() << " should be a JSON array of jobs " << parsed.getErrorMessage() << "\n";
+            return 1;
+        }
+        jobs.resize (static_cast<size_t> (json.size()));
+        for (int i = 0; i < json.size(); ++i) {
+            auto result = RenderJob::fromJson (json[i], jobsFile.getParentDirectory(), jobs[static_cast<size_t> (i)]);
+            if (result.failed()) {
+                std::cerr << "job " << i << ": " << result.getErrorMessage() << "\n";
+                return 1;
+            }
+        }
+    } else {
+        jobs.push_back (std::move (job));
+    }
+
+    for (auto& j : jobs) {
+        if (j.outputFile == juce::File()) {
+            printUsage();
+            return 1;
+        }
+    }
+
+    // every job bounces its own plugin, so they only share espeak's voice list and the pool that sets up notes
+    juce::ThreadPool pool (std::min (numThreads, static_cast<int> (jobs.size())));
+    juce::CriticalSection printLock;
+    std::atomic<int> numFailed { 0 };
+    for (auto& j : jobs) {
+        pool.addJob ([&j, &printLock, &numFailed, bitsPerSample] {
+            auto start = juce::Time::getMillisecondCounterHiRes();
+            juce::AudioBuffer<float> audio;
+            auto result = j.render (audio);
+            if (result.wasOk()) {
+                result = RenderJob::writeWav (audio, j.sampleRate, j.outputFile, bitsPerSample);
+            }
+            auto seconds = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+
+            const juce::ScopedLock sl (printLock);
+            if (result.failed()) {
+                std::cerr << j.outputFile.getFullPathName() << ": " << result.getErrorMessage() << "\n";
+                ++numFailed;
+            } else {
+                std::cout << j.outputFile.getFullPathName() << ": " << audio.getNumSamples() / j.sampleRate
+                          << "s in " << seconds << "s\n";
+            }
+        });
+    }
+    while (pool.getNumJobs() > 0) {
+        juce::Thread::sleep (10);
+    }
+
+    return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,216 @@
+// homer-render-client: sends jobs to homer-renderd and writes what comes back to WAV, to try the daemon
+// out and to see how it holds up with lots of clients at once.
+//
+//   homer-render-client --socket /tmp/homer.sock --text "Hello Homer" [--voice "English (America)"]
+//                       [--notes 0:1:60:100,1:1:64:100] [--automation bends.json] [--rate 48000]
+//                       [--seed 1234] [--output take.wav] [--clients N]
+//
+// --notes is start:duration:note:velocity in seconds, and --clients sends the same job from that many
+// connections at once, writing take-1.wav, take-2.wav and so on.
+
+#include "render/RenderJob.h"
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include <iostream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+static bool readFully (int fd, void* data, size_t size)
+{
+    auto* bytes = static_cast<char*> (data);
+    while (size > 0) {
+        auto n = ::recv (fd, bytes, size, 0);
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<size_t> (n);
+    }
+    return true;
+}
+
+static bool writeFully (int fd, const void* data, size_t size)
+{
+    auto* bytes = static_cast<const char*> (data);
+    while (size > 0) {
+        auto n = ::send (fd, bytes, size, 0);
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<size_t> (n);
+    }
+    return true;
+}
+
+struct Take
+{
+    juce::Result result = juce::Result::ok();
+    juce::AudioBuffer<float> audio;
+    double sampleRate = 0;
+    double secondsToHeader = 0;
+    double secondsToLastSample = 0;
+};
+
+static Take requestTake (const juce::String& socketPath, const std::string& job)
+{
+    Take take;
+    auto start = juce::Time::getMillisecondCounterHiRes();
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    socketPath.copyToUTF8 (address.sun_path, sizeof (address.sun_path));
+    auto fd = ::socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect (fd, reinterpret_cast<sockaddr*> (&address), sizeof (address)) != 0) {
+        take.result = juce::Result::fail ("can't connect to " + socketPath);
+        if (fd >= 0) {
+            ::close (fd);
+        }
+        return take;
+    }
+
+    auto size = juce::ByteOrder::swapIfBigEndian (static_cast<juce::uint32> (job.size()));
+    juce::uint32 headerSize = 0;
+    if (!writeFully (fd, &size, sizeof (size)) || !writeFully (fd, job.data(), job.size())
+        || !readFully (fd, &headerSize, sizeof (headerSize))) {
+        take.result = juce::Result::fail ("the daemon hung up");
+        ::close (fd);
+        return take;
+    }
+
+    juce::MemoryBlock headerText (juce::ByteOrder::swapIfBigEndian (headerSize));
+    juce::var header;
+    if (!readFully (fd, headerText.getData(), headerText.getSize())
+        || juce::JSON::parse (headerText.toString(), header).failed()) {
+        take.result = juce::Result::fail ("the daemon sent a broken header");
+        ::close (fd);
+        return take;
+    }
+    take.secondsToHeader = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+    if (!static_cast<bool> (header["ok"])) {
+        take.result = juce::Result::fail (header["error"].toString());
+        ::close (fd);
+        return take;
+    }
+
+    take.sampleRate = header["sampleRate"];
+    int numChannels = header["channels"];
+    int numSamples = header["samples"];
+    take.audio.setSize (numChannels, numSamples);
+
+    std::vector<float> interleaved (static_cast<size_t> (numChannels) * 4096);
+    for (int position = 0; position < numSamples;) {
+        auto numFrames = std::min (4096, numSamples - position);
+        if (!readFully (fd, interleaved.data(), static_cast<size_t> (numFrames * numChannels) * sizeof (float))) {
+            take.result = juce::Result::fail ("the daemon stopped after " + juce::String (position) + " samples");
+            break;
+        }
+        for (int i = 0; i < numFrames; ++i) {
+            for (int channel = 0; channel < numChannels; ++channel) {
+                juce::uint32 bits;
+                std::memcpy (&bits, &interleaved[static_cast<size_t> (i * numChannels + channel)], sizeof (bits));
+                bits = juce::ByteOrder::swapIfBigEndian (bits);
+                std::memcpy (take.audio.getWritePointer (channel, position + i), &bits, sizeof (bits));
+            }
+        }
+        position += numFrames;
+    }
+    take.secondsToLastSample = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+    ::close (fd);
+    return take;
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI gui;
+
+    juce::String socketPath, text = "Hello Homer", voice, notes = "0:1:60:100", automation, seed;
+    double sampleRate = 48000;
+    auto output = juce::File::getCurrentWorkingDirectory().getChildFile ("take.wav");
+    int numClients = 1;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        juce::String option (argv[i]), value (argv[i + 1]);
+        if (option == "--socket") {
+            socketPath = value;
+        } else if (option == "--text") {
+            text = value;
+        } else if (option == "--voice") {
+            voice = value;
+        } else if (option == "--notes") {
+            notes = value;
+        } else if (option == "--automation") {
+            automation = juce::File::getCurrentWorkingDirectory().getChildFile (value).getFullPathName();
+        } else if (option == "--rate") {
+            sampleRate = value.getDoubleValue();
+        } else if (option == "--seed") {
+            seed = value;
+        } else if (option == "--output") {
+            output = juce::File::getCurrentWorkingDirectory().getChildFile (value);
+        } else if (option == "--clients") {
+            numClients = std::max (1, value.getIntValue());
+        } else {
+            std::cerr << "unknown option " << option << "\n";
+            return 1;
+        }
+    }
+    if (socketPath.isEmpty() || argc % 2 == 0) {
+        std::cerr << "usage: homer-render-client --socket PATH [--text TEXT] [--voice NAME] [--notes start:duration:note:velocity,...]\n"
+                     "                           [--automation FILE] [--rate HZ] [--seed N] [--output FILE] [--clients N]\n";
+        return 1;
+    }
+
+    auto job = std::make_unique<juce::DynamicObject>();
+    job->setProperty ("lyrics", juce::Array<juce::var> { text });
+    if (voice.isNotEmpty()) {
+        job->setProperty ("voices", juce::Array<juce::var> { voice });
+    }
+    juce::Array<juce::var> noteList;
+    for (auto& note : juce::StringArray::fromTokens (notes, ",", "")) {
+        auto fields = juce::StringArray::fromTokens (note, ":", "");
+        if (fields.size() != 4) {
+            std::cerr << note << " should be start:duration:note:velocity\n";
+            return 1;
+        }
+        noteList.add (juce::Array<juce::var> { fields[0].getDoubleValue(), fields[1].getDoubleValue(),
+                                               fields[2].getIntValue(), fields[3].getIntValue() });
+    }
+    job->setProperty ("notes", noteList);
+    if (automation.isNotEmpty()) {
+        // the daemon runs on this machine, so it can read the file itself
+        job->setProperty ("automation", automation);
+    }
+    job->setProperty ("sampleRate", sampleRate);
+    if (seed.isNotEmpty()) {
+        job->setProperty ("seed", seed.getLargeIntValue());
+    }
+    auto jobText = juce::JSON::toString (job.release(), true).toStdString();
+
+    std::vector<Take> takes (static_cast<size_t> (numClients));
+    std::vector<std::thread> clients;
+    for (auto& take : takes) {
+        clients.emplace_back ([&take, &socketPath, &jobText] { take = requestTake (socketPath, jobText); });
+    }
+    for (auto& client : clients) {
+        client.join();
+    }
+
+    int numFailed = 0;
+    for (size_t i = 0; i < takes.size(); ++i) {
+        auto& take = takes[i];
+        auto file = numClients == 1 ? output
+                                    : output.getSiblingFile (output.getFileNameWithoutExtension() + "-" + juce::String (i + 1) + output.getFileExtension());
+        if (take.result.wasOk()) {
+            take.result = RenderJob::writeWav (take.audio, take.sampleRate, file, 32);
+        }
+        if (take.result.failed()) {
+            std::cerr << "client " << i + 1 << ": " << take.result.getErrorMessage() << "\n";
+            ++numFailed;
+            continue;
+        }
+        std::cout << file.getFullPathName() << ": " << take.audio.getNumSamples() / take.sampleRate << "s, first samples after "
+                  << take.secondsToHeader << "s, done after " << take.secondsToLastSample << "s\n";
+    }
+    return numFailed > 0 ? 1 : 0;
+}
@@ -0,0 +1,314 @@
+// homer-renderd: a long running renderer for the asset pipeline. It keeps plugins that have already
+// sung in a voice warm between jobs, so a job doesn't pay for starting a process, listing the voices
+// and setting up espeak before its first sample.
+//
+//   homer-renderd --socket /tmp/homer.sock [--workers N] [--queue N] [--warm VOICE ...]
+//
+// Each connection is one job:
+//   client -> daemon: a little endian uint32 length, then that many bytes of a JSON job, with the same
+//                     keys as a homer-render jobs file, notes as [start, duration, note, velocity] arrays
+//   daemon -> client: a little endian uint32 length, then that many bytes of a JSON header,
+//                     {"ok": true, "sampleRate": 48000, "channels": 2, "samples": N} or {"ok": false, "error": "..."},
+//                     then when it's ok, N frames of interleaved little endian float32, block by block as they render
+//
+// The queue is bounded: once --workers jobs are rendering and --queue more are waiting, the daemon stops
+// accepting, so new clients wait in connect(). A client that reads slowly holds up its own worker, and one
+// that hangs up stops its render.
+
+#include "render/RenderJob.h"
+#include "PluginProcessor.h"
+
+#include <juce_gui_basics/juce_gui_basics.h>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static std::atomic<bool> shouldExit { false };
+
+static bool readFully (int fd, void* data, size_t size)
+{
+    auto* bytes = static_cast<char*> (data);
+    while (size > 0) {
+        auto n = ::recv (fd, bytes, size, 0);
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<size_t> (n);
+    }
+    return true;
+}
+
+static bool writeFully (int fd, const void* data, size_t size)
+{
+    auto* bytes = static_cast<const char*> (data);
+    while (size > 0) {
+        auto n = ::send (fd, bytes, size, 0);
+        if (n <= 0) {
+            return false;
+        }
+        bytes += n;
+        size -= static_cast<size_t> (n);
+    }
+    return true;
+}
+
+static bool writeMessage (int fd, const juce::var& json)
+{
+    auto text = juce::JSON::toString (json, true).toStdString();
+    auto size = juce::ByteOrder::swapIfBigEndian (static_cast<juce::uint32> (text.size()));
+    return writeFully (fd, &size, sizeof (size)) && writeFully (fd, text.data(), text.size());
+}
+
+static void writeError (int fd, const juce::String& error)
+{
+    auto header = std::make_unique<juce::DynamicObject>();
+    header->setProperty ("ok", false);
+    header->setProperty ("error", error);
+    writeMessage (fd, header.release());
+}
+
+// idle plugins by the voices they were last set up with. Only the lyric lines' voices matter, the
+// parameters and lyrics are put back by RenderJob::render
+class WarmPlugins
+{
+public:
+    explicit WarmPlugins (int maxIdle) : maxIdle (maxIdle) {}
+
+    static juce::String getKey (const RenderJob& job)
+    {
+        return juce::StringArray (job.voices.data(), static_cast<int> (job.voices.size())).joinIntoString ("|");
+    }
+
+    std::unique_ptr<PluginProcessor> acquire (const juce::String& key)
+    {
+        {
+            const juce::ScopedLock sl (lock);
+            for (auto it = idle.rbegin(); it != idle.rend(); ++it) {
+                if (it->first == key) {
+                    auto plugin = std::move (it->second);
+                    idle.erase (std::next (it).base());
+                    return plugin;
+                }
+            }
+        }
+        return std::make_unique<PluginProcessor>();
+    }
+
+    void release (const juce::String& key, std::unique_ptr<PluginProcessor> plugin)
+    {
+        std::unique_ptr<PluginProcessor> evicted;
+        const juce::ScopedLock sl (lock);
+        idle.emplace_back (key, std::move (plugin));
+        if (static_cast<int> (idle.size()) > maxIdle) {
+            // the least recently used, destroyed outside the lock
+            evicted = std::move (idle.front().second);
+            idle.erase (idle.begin());
+        }
+    }
+
+private:
+    const int maxIdle;
+    juce::CriticalSection lock;
+    std::vector<std::pair<juce::String, std::unique_ptr<PluginProcessor>>> idle;
+};
+
+static void renderForClient (int fd, const RenderJob& job, WarmPlugins& warmPlugins)
+{
+    auto key = WarmPlugins::getKey (job);
+    auto plugin = warmPlugins.acquire (key);
+    auto numChannels = plugin->getTotalNumOutputChannels();
+
+    // the header goes out with the first block, so a job that can't start can still say why
+    bool headerSent = false;
+    std::vector<float> interleaved;
+    auto result = job.render (*plugin, [&] (const juce::AudioBuffer<float>& block) {
+        if (!headerSent) {
+            auto header = std::make_unique<juce::DynamicObject>();
+            header->setProperty ("ok", true);
+            header->setProperty ("sampleRate", job.sampleRate);
+            header->setProperty ("channels", numChannels);
+            header->setProperty ("samples", job.getNumSamples());
+            headerSent = true;
+            if (!writeMessage (fd, header.release())) {
+                return false;
+            }
+        }
+
+        interleaved.resize (static_cast<size_t> (block.getNumSamples() * numChannels));
+        for (int channel = 0; channel < numChannels; ++channel) {
+            auto* samples = block.getReadPointer (std::min (channel, block.getNumChannels() - 1));
+            for (int i = 0; i < block.getNumSamples(); ++i) {
+                interleaved[static_cast<size_t> (i * numChannels + channel)] = samples[i];
+            }
+        }
+        // little endian on the wire
+        for (auto& sample : interleaved) {
+            juce::uint32 bits;
+            std::memcpy (&bits, &sample, sizeof (bits));
+            bits = juce::ByteOrder::swapIfBigEndian (bits);
+            std::memcpy (&sample, &bits, sizeof (bits));
+        }
+        return !shouldExit && writeFully (fd, interleaved.data(), interleaved.size() * sizeof (float));
+    });
+
+    if (result.failed()) {
+        if (!headerSent) {
+            writeError (fd, result.getErrorMessage());
+        }
+        std::cerr << "job failed: " << result.getErrorMessage() << "\n";
+    }
+    warmPlugins.release (key, std::move (plugin));
+}
+
+static juce::Result readJob (int fd, RenderJob& job)
+{
+    juce::uint32 size;
+    if (!readFully (fd, &size, sizeof (size))) {
+        return juce::Result::fail ("no job was sent");
+    }
+    size = juce::ByteOrder::swapIfBigEndian (size);
+    if (size > (1u << 24)) {
+        return juce::Result::fail ("the job is too big");
+    }
+
+    juce::MemoryBlock text (size);
+    if (!readFully (fd, text.getData(), size)) {
+        return juce::Result::fail ("the job was cut short");
+    }
+
+    juce::var json;
+    auto parsed = juce::JSON::parse (text.toString(), json);
+    if (parsed.failed()) {
+        return parsed;
+    }
+    return RenderJob::fromJson (json, juce::File::getCurrentWorkingDirectory(), job);
+}
+
+static void printUsage()
+{
+    std::cerr << "usage: homer-renderd --socket PATH [--workers N] [--queue N] [--warm VOICE ...]\n";
+}
+
+int main (int argc, char* argv[])
+{
+    juce::ScopedJuceInitialiser_GUI gui;
+
+    juce::String socketPath;
+    int numWorkers = juce::SystemStats::getNumCpus();
+    int queueSize = 2 * numWorkers;
+    juce::StringArray warmVoices;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        juce::String option (argv[i]), value (argv[i + 1]);
+        if (option == "--socket") {
+            socketPath = value;
+        } else if (option == "--workers") {
+            numWorkers = std::max (1, value.getIntValue());
+        } else if (option == "--queue") {
+            queueSize = std::max (0, value.getIntValue());
+        } else if (option == "--warm") {
+            warmVoices.add (value);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (socketPath.isEmpty() || argc % 2 == 0) {
+        printUsage();
+        return 1;
+    }
+
+    sockaddr_un address {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.getNumBytesAsUTF8() >= sizeof (address.sun_path)) {
+        std::cerr << socketPath << " is too long for a socket path\n";
+        return 1;
+    }
+    std::strcpy (address.sun_path, socketPath.toRawUTF8());
+
+    auto listener = ::socket (AF_UNIX, SOCK_STREAM, 0);
+    ::unlink (address.sun_path);
+    if (listener < 0 || ::bind (listener, reinterpret_cast<sockaddr*> (&address), sizeof (address)) != 0
+        || ::listen (listener, 64) != 0) {
+        std::cerr << "can't listen on " << socketPath << ": " << std::strerror (errno) << "\n";
+        return 1;
+    }
+
+    std::signal (SIGPIPE, SIG_IGN);
+    std::signal (SIGINT, [] (int) { shouldExit = true; });
+    std::signal (SIGTERM, [] (int) { shouldExit = true; });
+
+    // a couple of spares per worker, so a voice change doesn't throw out every other voice's plugins
+    WarmPlugins warmPlugins (2 * numWorkers);
+
+    // one short note per worker in each voice, so the first jobs find them warm
+    for (auto& voice : warmVoices) {
+        RenderJob job;
+        job.voices[0] = voice;
+        job.lyrics[0] = "a";
+        job.tailSeconds = 0;
+        juce::ignoreUnused (job.loadNotes (juce::JSON::parse ("[[0, 0.1, 60, 100]]")));
+        auto key = WarmPlugins::getKey (job);
+        std::vector<std::unique_ptr<PluginProcessor>> plugins;
+        for (int i = 0; i < numWorkers; ++i) {
+            plugins.push_back (warmPlugins.acquire (key));
+            auto result = job.render (*plugins.back(), [] (const juce::AudioBuffer<float>&) { return true; });
+            if (result.failed()) {
+                std::cerr << "can't warm up " << voice << ": " << result.getErrorMessage() << "\n";
+                return 1;
+            }
+        }
+        for (auto& plugin : plugins) {
+            warmPlugins.release (key, std::move (plugin));
+        }
+    }
+
+    juce::ThreadPool workers (numWorkers);
+    juce::WaitableEvent jobFinished;
+    std::cout << "listening on " << socketPath << " with " << numWorkers << " workers" << std::endl;
+
+    while (!shouldExit) {
+        // backpressure: stop accepting until there's room in the queue
+        if (workers.getNumJobs() >= numWorkers + queueSize) {
+            jobFinished.wait (100);
+            continue;
+        }
+
+        pollfd pfd { listener, POLLIN, 0 };
+        if (::poll (&pfd, 1, 100) <= 0) {
+            continue;
+        }
+        auto fd = ::accept (listener, nullptr, nullptr);
+        if (fd < 0) {
+            continue;
+        }
+
+        // a client that connects and never sends its job shouldn't hold up the others
+        timeval timeout { 5, 0 };
+        ::setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+
+        auto job = std::make_shared<RenderJob>();
+        auto result = readJob (fd, *job);
+        if (result.failed()) {
+            writeError (fd, result.getErrorMessage());
+            ::close (fd);
+            continue;
+        }
+
+        workers.addJob ([fd, job, &warmPlugins, &jobFinished] {
+            renderForClient (fd, *job, warmPlugins);
+            ::close (fd);
+            jobFinished.signal();
+        });
+    }
+
+    ::close (listener);
+    ::unlink (address.sun_path);
+    workers.removeAllJobs (false, 60000);
+    return 0;
+}